@@ -0,0 +1,75 @@
+#include "AllocationCounter.h"
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// plain counters, nothing here may allocate (or need constructing)
+thread_local uint64_t allocationCount = 0;
+thread_local uint64_t allocationBytes = 0;
+
+void* allocate(size_t size) {
+    ++allocationCount;
+    allocationBytes += size;
+    return malloc(size ? size : 1);
+}
+
+void* allocateAligned(size_t size, size_t alignment) {
+    ++allocationCount;
+    allocationBytes += size;
+    // aligned_alloc wants the size to be a multiple of the alignment
+    size_t rounded = (size + alignment - 1) / alignment * alignment;
+    return aligned_alloc(alignment, rounded ? rounded : alignment);
+}
+
+} // namespace
+
+void AllocationCounter::restart() {
+    startCount = allocationCount;
+    startBytes = allocationBytes;
+}
+
+uint64_t AllocationCounter::allocations() const { return allocationCount - startCount; }
+uint64_t AllocationCounter::bytes() const { return allocationBytes - startBytes; }
+
+
+// the replacements...
+
+void* operator new(size_t size) {
+    if (void* p = allocate(size)) return p;
+    throw bad_alloc();
+}
+void* operator new[](size_t size) {
+    if (void* p = allocate(size)) return p;
+    throw bad_alloc();
+}
+void* operator new(size_t size, const nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](size_t size, const nothrow_t&) noexcept { return allocate(size); }
+
+void* operator new(size_t size, align_val_t alignment) {
+    if (void* p = allocateAligned(size, static_cast<size_t>(alignment))) return p;
+    throw bad_alloc();
+}
+void* operator new[](size_t size, align_val_t alignment) {
+    if (void* p = allocateAligned(size, static_cast<size_t>(alignment))) return p;
+    throw bad_alloc();
+}
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return allocateAligned(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return allocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { free(p); }
+void operator delete(void* p, align_val_t) noexcept { free(p); }
+void operator delete[](void* p, align_val_t) noexcept { free(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { free(p); }
+void operator delete[](void* p, size_t, align_val_t) noexcept { free(p); }
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept { free(p); }
@@ -0,0 +1,29 @@
+// bench/AllocationCounter.h
+// counts heap allocations: linking AllocationCounter.cpp replaces the global
+// operator new/delete (every form) with ones that count per thread before
+// going to malloc. Tests and Bench link it, Main doesn't
+//
+//   AllocationCounter count;
+//   g.shortestTime(a, b);
+//   count.allocations(); // news on this thread since count was made
+//
+// only this thread's allocations are seen, so a pool thread building the
+// routing index in the background doesn't show up in a query's count
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+class AllocationCounter {
+public:
+    AllocationCounter() { restart(); }
+    void restart();
+
+    uint64_t allocations() const; // operator new calls on this thread since restart
+    uint64_t bytes() const;       // bytes they asked for
+
+private:
+    uint64_t startCount = 0;
+    uint64_t startBytes = 0;
+};
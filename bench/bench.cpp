@@ -0,0 +1,227 @@
+// bench/bench.cpp
+// the Bench target: how fast are the Graph operations and the command loop
+// on campuses from 10^3 to 10^6 locations (made by CampusGenerator)
+//
+// Bench [--max-locations=N] [--students=N] [--min-time=SECONDS]
+//       [--filter=TEXT] [--seed=N] [--keep-files]
+//
+// every benchmark runs its body over and over (a different query each time,
+// picked up front from the same seed) until it has taken --min-time, and
+// prints the time per call and the heap allocations per call (counted by
+// AllocationCounter's operator new). the default stops at 10^5 locations, pass
+// --max-locations=1000000 for the big one. build it Release, the numbers
+// of a debug build mean nothing
+#include "../src/CampusGenerator.h"
+#include "../src/Commands.h"
+#include "../src/Graph.h"
+#include "../src/GraphStore.h"
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Options {
+    size_t maxLocations = 100000;
+    size_t students = 0; // 0: one per 4 locations
+    double minTime = 0.2;
+    string filter;
+    uint64_t seed = 1;
+    bool keepFiles = false;
+};
+
+Options options;
+volatile long long sink = 0; // so the answers aren't thrown away
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+bool wanted(const string& name) {
+    return options.filter.empty() || name.find(options.filter) != string::npos;
+}
+
+// ops: how many operations one iteration is (the command loop runs a whole script)
+void report(const string& name, size_t locations, size_t iterations, double seconds, uint64_t allocations,
+            size_t ops = 1) {
+    double calls = static_cast<double>(iterations * ops);
+    printf("%-28s %10zu %12zu %14.1f ns/op %12.2f allocs/op\n", name.c_str(), locations, iterations * ops,
+           seconds * 1e9 / calls, static_cast<double>(allocations) / calls);
+    fflush(stdout);
+}
+
+// runs body(0), body(1), ... in growing rounds until a round takes minTime
+void measure(const string& name, size_t locations, const function<void(size_t)>& body) {
+    if (!wanted(name)) return;
+    size_t iterations = 1;
+    for (;;) {
+        AllocationCounter counted;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) body(i);
+        double took = secondsSince(start);
+        if (took >= options.minTime || iterations >= (size_t(1) << 30)) {
+            report(name, locations, iterations, took, counted.allocations());
+            return;
+        }
+        iterations *= took < options.minTime / 10 ? 10 : 2;
+    }
+}
+
+// for the ones that change what they run on: setup() before every call, untimed
+void measureEach(const string& name, size_t locations, const function<void()>& setup,
+                 const function<void()>& body, size_t ops = 1) {
+    if (!wanted(name)) return;
+    double total = 0;
+    size_t iterations = 0;
+    uint64_t allocations = 0;
+    while (total < options.minTime || iterations == 0) {
+        setup();
+        AllocationCounter counted;
+        auto start = chrono::steady_clock::now();
+        body();
+        total += secondsSince(start);
+        allocations += counted.allocations();
+        ++iterations;
+    }
+    report(name, locations, iterations, total, allocations, ops);
+}
+
+void benchCampus(size_t n) {
+    CampusSpec spec;
+    spec.locations = n;
+    spec.students = options.students ? options.students : n / 4;
+    spec.seed = options.seed;
+    auto start = chrono::steady_clock::now();
+    Campus campus = generateCampus(spec);
+    double generated = secondsSince(start);
+    if (wanted("generateCampus")) report("generateCampus", n, 1, generated, 0);
+
+    Graph g;
+    campus.loadInto(g);
+
+    // the queries, picked up front
+    mt19937_64 rng(options.seed ^ n);
+    const size_t QUERIES = 1024;
+    vector<pair<int,int>> pairs(QUERIES), edges(QUERIES);
+    vector<vector<int>> zones(QUERIES);
+    vector<vector<ClassInfo>> days(QUERIES);
+    for (size_t q = 0; q < QUERIES; ++q) {
+        pairs[q] = {static_cast<int>(1 + rng() % n), static_cast<int>(1 + rng() % n)};
+        const CampusEdge& e = campus.edges[rng() % campus.edges.size()];
+        edges[q] = {e.u, e.v};
+        for (int k = 0; k < 4; ++k) {
+            const CampusClass& c = campus.classes[rng() % campus.classes.size()];
+            zones[q].push_back(c.info.locationId);
+            days[q].push_back(c.info);
+        }
+        sort(days[q].begin(), days[q].end(),
+             [](const ClassInfo& a, const ClassInfo& b) { return a.startTime < b.startTime; });
+    }
+    vector<int> residences(QUERIES);
+    for (size_t q = 0; q < QUERIES; ++q) residences[q] = static_cast<int>(1 + rng() % n);
+
+    PathResult path; // reused, like a caller that keeps its result around
+    measure("dijkstra", n, [&](size_t i) {
+        g.dijkstra(pairs[i % QUERIES].first, pairs[i % QUERIES].second, path);
+        sink = sink + path.totalCost;
+    });
+    g.enableRoutingIndex();
+    g.prepareRoutingIndex();
+    g.waitForRoutingIndex();
+    measure("shortestTime", n, [&](size_t i) {
+        sink = sink + g.shortestTime(pairs[i % QUERIES].first, pairs[i % QUERIES].second);
+    });
+    measure("isConnected", n, [&](size_t i) {
+        sink = sink + g.isConnected(pairs[i % QUERIES].first, pairs[i % QUERIES].second);
+    });
+    measure("computeStudentZoneCost", n, [&](size_t i) {
+        sink = sink + g.computeStudentZoneCost(residences[i % QUERIES], zones[i % QUERIES]);
+    });
+    measure("verifySchedule", n, [&](size_t i) {
+        sink = sink + static_cast<long long>(g.verifySchedule(days[i % QUERIES]).size());
+    });
+    measure("toggleEdgesClosure", n, [&](size_t i) {
+        sink = sink + g.toggleEdgesClosure({edges[i % QUERIES]});
+    });
+    measure("checkEdgeStatus", n, [&](size_t i) {
+        sink = sink + static_cast<long long>(g.checkEdgeStatus(edges[i % QUERIES].first, edges[i % QUERIES].second).size());
+    });
+
+    // the writers of a GraphStore: every update copies the published graph,
+    // so these show what a change copies (the closed bits; the slab chunk,
+    // index page and name block of one student), not just what it does
+    {
+        GraphStore store(g);
+        measure("GraphStore toggle", n, [&](size_t i) {
+            sink = sink + store.update([&](Graph& next) { return next.toggleEdgesClosure({edges[i % QUERIES]}); });
+        });
+        if (!campus.students.empty()) {
+            // a ufid under 10^7, which the campus never uses, added on even calls and removed on odd ones
+            const CampusStudent& model = campus.students.front();
+            measure("GraphStore add/removeStudent", n, [&](size_t i) {
+                sink = sink + store.update([&](Graph& next) {
+                    return i % 2 ? next.removeStudent(UFIDKey("00000001"))
+                                 : next.addStudent(model.name, UFIDKey("00000001"), model.classes, model.residence);
+                });
+            });
+        }
+    }
+
+    // the loaders, from files like data/
+    string dir = "bench_campus_" + to_string(n);
+    filesystem::create_directories(dir);
+    if (!campus.writeCSVs(dir)) {
+        fprintf(stderr, "can't write %s\n", dir.c_str());
+    } else {
+        unique_ptr<Graph> fresh;
+        measureEach("loadEdgesCSV", n, [&]() { fresh = make_unique<Graph>(); },
+                    [&]() { sink = sink + fresh->loadEdgesCSV(dir + "/edges.csv"); });
+        measureEach("loadClassesCSV", n, [&]() { fresh = make_unique<Graph>(); },
+                    [&]() { sink = sink + fresh->loadClassesCSV(dir + "/classes.csv"); });
+    }
+    if (!options.keepFiles) filesystem::remove_all(dir);
+
+    // the command loop, a script against a copy of the loaded graph (time per
+    // command). the prints search the whole campus, so big ones get short scripts
+    size_t commands = min<size_t>(20000, max<size_t>(200, 20000000 / n));
+    vector<string> script = generateCommands(campus, commands, options.seed);
+    unique_ptr<Graph> copy;
+    measureEach("commandLoop", n, [&]() { copy = make_unique<Graph>(g); },
+                [&]() {
+                    OutputBuffer out(nullptr, 0);
+                    for (const string& line : script) runCommand(*copy, line, out);
+                    sink = sink + static_cast<long long>(out.take().size());
+                },
+                script.size());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--max-locations=", 0) == 0) options.maxLocations = strtoull(arg.c_str() + 16, nullptr, 10);
+        else if (arg.rfind("--students=", 0) == 0) options.students = strtoull(arg.c_str() + 11, nullptr, 10);
+        else if (arg.rfind("--min-time=", 0) == 0) options.minTime = atof(arg.c_str() + 11);
+        else if (arg.rfind("--filter=", 0) == 0) options.filter = arg.substr(9);
+        else if (arg.rfind("--seed=", 0) == 0) options.seed = strtoull(arg.c_str() + 7, nullptr, 10);
+        else if (arg == "--keep-files") options.keepFiles = true;
+        else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+    printf("%-28s %10s %12s %17s %22s\n", "benchmark", "locations", "iterations", "time", "heap");
+    for (size_t n = 1000; n <= options.maxLocations; n *= 10) benchCampus(n);
+    return 0;
+}
@@ -0,0 +1,148 @@
+// bench/replay.cpp
+// the Replay tool: runs a trace recorded with `Main --record=FILE` again
+// and says how fast every kind of command went
+//
+// Replay TRACE [--pace=max|recorded|N] [--speed=X] [--data=DIR]
+//              [--snapshot=FILE] [--registry=direct] [--output=FILE]
+//
+//   --pace=max        one command after the other, as fast as it goes (default)
+//   --pace=recorded   every command at the time it came in (--speed=2 twice as fast)
+//   --pace=N          N commands a second, evenly spaced
+//   --data=DIR        where edges.csv / classes.csv are (default data)
+//   --snapshot=FILE   start from a snapshot instead of the CSVs
+//   --output=FILE     keep what the commands print (to diff against Main's output)
+//
+// the graph starts from the same files Main did (the trace remembers their
+// fingerprints and we warn if they changed), and the commands run in the
+// same order on one thread, so the output is exactly Main's
+// the latency of a command runs from when it was due (its recorded or
+// paced time) to when it finished, so time spent waiting behind a slow
+// command counts too; at --pace=max it's just the time the command took
+#include "../src/CommandTrace.h"
+#include "../src/Commands.h"
+#include "../src/Graph.h"
+#include "../src/Snapshot.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static const chrono::microseconds SPIN(200);
+
+namespace {
+
+double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t k = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[min(k, sorted.size() - 1)];
+}
+
+void printRow(const char* name, vector<double>& micros, double seconds) {
+    sort(micros.begin(), micros.end());
+    printf("%-20s %9zu %11.0f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, micros.size(),
+           static_cast<double>(micros.size()) / seconds, percentile(micros, 0.5), percentile(micros, 0.9),
+           percentile(micros, 0.99), percentile(micros, 0.999), micros.empty() ? 0.0 : micros.back());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    string tracePath, dataDir = "data", snapshotPath, outputPath, pace = "max";
+    double speed = 1.0;
+    RegistryMode mode = RegistryMode::Hashed;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--pace=", 0) == 0) pace = arg.substr(7);
+        else if (arg.rfind("--speed=", 0) == 0) speed = atof(arg.c_str() + 8);
+        else if (arg.rfind("--data=", 0) == 0) dataDir = arg.substr(7);
+        else if (arg.rfind("--snapshot=", 0) == 0) snapshotPath = arg.substr(11);
+        else if (arg.rfind("--output=", 0) == 0) outputPath = arg.substr(9);
+        else if (arg == "--registry=direct") mode = RegistryMode::DirectAddress;
+        else if (arg.rfind("--", 0) != 0 && tracePath.empty()) tracePath = arg;
+        else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+    double rate = pace == "max" || pace == "recorded" ? 0 : atof(pace.c_str());
+    if (tracePath.empty() || speed <= 0 || (pace != "max" && pace != "recorded" && rate <= 0)) {
+        fprintf(stderr, "usage: Replay TRACE [--pace=max|recorded|N] [--speed=X] [--data=DIR] "
+                        "[--snapshot=FILE] [--registry=direct] [--output=FILE]\n");
+        return 2;
+    }
+
+    TraceReader trace;
+    string error;
+    if (!trace.open(tracePath, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    Graph g(mode);
+    if (!snapshotPath.empty()) {
+        if (!g.loadSnapshot(snapshotPath)) {
+            fprintf(stderr, "can't load snapshot %s\n", snapshotPath.c_str());
+            return 1;
+        }
+    } else {
+        string edges = dataDir + "/edges.csv", classes = dataDir + "/classes.csv";
+        const TraceHeader& head = trace.header();
+        if ((head.edgesFingerprint && head.edgesFingerprint != fingerprintFile(edges)) ||
+            (head.classesFingerprint && head.classesFingerprint != fingerprintFile(classes)))
+            fprintf(stderr, "warning: %s/ is not the data the trace was recorded on\n", dataDir.c_str());
+        g.loadEdgesCSV(edges);
+        g.loadClassesCSV(classes);
+    }
+
+    FILE* sink = outputPath.empty() ? nullptr : fopen(outputPath.c_str(), "wb");
+    if (!outputPath.empty() && !sink) {
+        fprintf(stderr, "can't write %s\n", outputPath.c_str());
+        return 1;
+    }
+    OutputBuffer out(sink); // without a file it just keeps the text, dropped below
+
+    vector<double> micros[COMMAND_KINDS];
+    vector<double> all;
+    TraceRecord record;
+    size_t index = 0;
+    Clock::time_point start = Clock::now();
+    while (trace.next(record)) {
+        Clock::time_point due = start;
+        if (pace == "recorded") due += chrono::nanoseconds(static_cast<long long>(static_cast<double>(record.at) / speed));
+        else if (rate > 0) due += chrono::nanoseconds(static_cast<long long>(static_cast<double>(index) * 1e9 / rate));
+        Clock::time_point now = Clock::now();
+        if (pace == "max") {
+            due = now;
+        } else if (due > now) {
+            // sleeping wakes up late, so sleep to just before and spin the rest
+            if (due - now > SPIN) this_thread::sleep_until(due - SPIN);
+            while (Clock::now() < due) {}
+        }
+
+        runCommand(g, record.line, out);
+        if (!sink) out.take();
+        double took = chrono::duration<double, micro>(Clock::now() - due).count();
+        micros[static_cast<size_t>(commandKindOfLine(record.line))].push_back(took);
+        all.push_back(took);
+        ++index;
+    }
+    double seconds = max(1e-9, chrono::duration<double>(Clock::now() - start).count());
+    out.flush();
+    if (sink) fclose(sink);
+    if (trace.corrupt()) fprintf(stderr, "warning: the trace ends in a broken record, replayed what came before\n");
+
+    printf("replayed %zu commands in %.3f s (%.0f commands/s), pace %s\n", index, seconds,
+           static_cast<double>(index) / seconds, pace.c_str());
+    printf("%-20s %9s %11s %10s %10s %10s %10s %10s\n", "command", "count", "per second", "p50 us", "p90 us",
+           "p99 us", "p99.9 us", "max us");
+    for (size_t k = 0; k < COMMAND_KINDS; ++k)
+        if (!micros[k].empty()) printRow(commandName(static_cast<CommandKind>(k)), micros[k], seconds);
+    printRow("all", all, seconds);
+    return 0;
+}
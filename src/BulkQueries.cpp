@@ -0,0 +1,228 @@
+// BulkQueries.cpp
+// the nightly reports over every student: shortest times, zone costs and
+// schedule checks for the whole registry in one call
+//
+// the open edges are copied into a CSR once per report (the same one the
+// routing index builds from), the students are cut into tasks of TASK_SIZE
+// and spread over the work-stealing pool, and every worker runs its
+// searches in its own DijkstraWorkspace (flat arrays, reset by bumping an
+// epoch, so nothing is allocated per search)
+//
+// the answers are exactly the per-student ones: the search visits nodes in
+// the same order as Graph::dijkstra (same heap order, same edge order), so
+// even the paths a zone is built from come out the same
+#include "Graph.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <exception>
+#include <limits>
+
+using namespace std;
+
+static const size_t TASK_SIZE = 64;
+
+namespace {
+
+class DijkstraWorkspace {
+public:
+    static constexpr uint32_t NONE = numeric_limits<uint32_t>::max();
+
+    // settles nodes from source until target is taken off the heap
+    // (NONE: until everything reachable is settled)
+    void run(const RoutingTopology& topo, uint32_t source, uint32_t target = NONE) {
+        size_t n = topo.ids.size();
+        if (stamp.size() != n) {
+            stamp.assign(n, 0);
+            dist.resize(n);
+            parent.resize(n);
+            epoch = 0;
+        }
+        if (++epoch == 0) { // wrapped, old stamps could look current
+            fill(stamp.begin(), stamp.end(), 0);
+            epoch = 1;
+        }
+        heap.clear();
+        touch(source, 0, NONE);
+        heap.emplace_back(0, source);
+        auto later = greater<pair<int, uint32_t>>();
+        while (!heap.empty()) {
+            pop_heap(heap.begin(), heap.end(), later);
+            auto [dcur, node] = heap.back();
+            heap.pop_back();
+            if (dcur > dist[node]) continue;
+            if (node == target) break;
+            for (uint32_t k = topo.offsets[node]; k < topo.offsets[node + 1]; ++k) {
+                uint32_t next = topo.targets[k];
+                long long cand = (long long)dcur + topo.weights[k];
+                if (cand < distanceOrInf(next)) {
+                    touch(next, static_cast<int>(cand), node);
+                    heap.emplace_back(static_cast<int>(cand), next);
+                    push_heap(heap.begin(), heap.end(), later);
+                }
+            }
+        }
+    }
+
+    // -1 if the last run never got there
+    int distance(uint32_t slot) const { return stamp[slot] == epoch ? dist[slot] : -1; }
+    uint32_t parentOf(uint32_t slot) const { return stamp[slot] == epoch ? parent[slot] : NONE; }
+
+    // a zone's vertices and subgraph, kept between students too
+    vector<int> vertices;
+    vector<EdgeInfo> edges;
+
+private:
+    int distanceOrInf(uint32_t slot) const {
+        return stamp[slot] == epoch ? dist[slot] : numeric_limits<int>::max();
+    }
+    void touch(uint32_t slot, int d, uint32_t from) {
+        stamp[slot] = epoch;
+        dist[slot] = d;
+        parent[slot] = from;
+    }
+
+    vector<uint32_t> stamp;
+    vector<int> dist;
+    vector<uint32_t> parent;
+    vector<pair<int, uint32_t>> heap;
+    uint32_t epoch = 0;
+};
+
+// node id -> CSR slot, NONE if the id isn't a node
+uint32_t slotOf(const RoutingTopology& topo, int id) {
+    auto it = lower_bound(topo.ids.begin(), topo.ids.end(), id);
+    if (it == topo.ids.end() || *it != id) return DijkstraWorkspace::NONE;
+    return static_cast<uint32_t>(it - topo.ids.begin());
+}
+
+// verifySchedule's HH:MM parsing (stoi), false where it would throw
+bool clockMinutes(const string& s, int& minutes) {
+    try {
+        minutes = stoi(s.substr(0, 2)) * 60 + stoi(s.substr(3, 2));
+        return true;
+    } catch (const exception&) {
+        return false;
+    }
+}
+
+// runs body(student, workspace) for every student on the pool,
+// one workspace per worker
+template <class Body>
+void forEachStudent(ThreadPool* given, const vector<const Student*>& students, Body body) {
+    ThreadPool& pool = given ? *given : ThreadPool::shared();
+    vector<DijkstraWorkspace> workspaces(pool.concurrency());
+    size_t tasks = (students.size() + TASK_SIZE - 1) / TASK_SIZE;
+    pool.parallelForWorkers(tasks, [&](size_t task, size_t worker) {
+        size_t end = min(students.size(), (task + 1) * TASK_SIZE);
+        for (size_t i = task * TASK_SIZE; i < end; ++i) body(i, workspaces[worker]);
+    });
+}
+
+} // namespace
+
+vector<const Student*> Graph::studentsByUFID() const {
+    vector<const Student*> list;
+    list.reserve(registry->students.size());
+    registry->students.forEach([&](SlabHandle, const Student& s) { list.push_back(&s); });
+    sort(list.begin(), list.end(), [](const Student* a, const Student* b) {
+        return a->getUFID().value < b->getUFID().value;
+    });
+    return list;
+}
+
+// printShortestEdges for everyone: one search from each residence covers
+// all of that student's classes
+
+vector<StudentTimes> Graph::shortestTimesForAllStudents(ThreadPool* pool) const {
+    vector<const Student*> students = studentsByUFID();
+    RoutingTopology topo = routingTopology();
+    vector<StudentTimes> report(students.size());
+    forEachStudent(pool, students, [&](size_t i, DijkstraWorkspace& ws) {
+        const Student& s = *students[i];
+        uint32_t from = slotOf(topo, s.getResidence());
+        if (from != DijkstraWorkspace::NONE) ws.run(topo, from);
+        ClassSpan span = s.getClasses();
+        ClassId ids[Student::MAX_CLASSES];
+        size_t count = copy(span.begin(), span.end(), ids) - ids;
+        sort(ids, ids + count); // packed ids sort like the codes
+        StudentTimes& row = report[i];
+        row.ufid = s.getUFID();
+        for (ClassId id : Span<ClassId>(ids, count)) {
+            int loc = getClassLocationById(id);
+            uint32_t to = loc == -1 ? DijkstraWorkspace::NONE : slotOf(topo, loc);
+            int t = from == DijkstraWorkspace::NONE || to == DijkstraWorkspace::NONE ? -1 : ws.distance(to);
+            row.times.emplace_back(formatClassCode(id), t);
+        }
+    });
+    return report;
+}
+
+// printStudentZone for everyone: the residence plus every node on the
+// shortest paths to the classes, then the MST of that, like computeStudentZoneCost
+
+vector<StudentZoneCost> Graph::zoneCostForAllStudents(ThreadPool* pool) const {
+    vector<const Student*> students = studentsByUFID();
+    RoutingTopology topo = routingTopology();
+    vector<StudentZoneCost> report(students.size());
+    forEachStudent(pool, students, [&](size_t i, DijkstraWorkspace& ws) {
+        const Student& s = *students[i];
+        int residence = s.getResidence();
+        vector<int>& vertices = ws.vertices;
+        vertices.assign(1, residence);
+        uint32_t from = slotOf(topo, residence);
+        if (from != DijkstraWorkspace::NONE) {
+            ws.run(topo, from);
+            for (ClassId id : s.getClasses()) {
+                int loc = getClassLocationById(id);
+                if (loc == -1) continue;
+                uint32_t to = slotOf(topo, loc);
+                if (to == DijkstraWorkspace::NONE || ws.distance(to) == -1) continue;
+                for (uint32_t v = to; v != DijkstraWorkspace::NONE; v = ws.parentOf(v)) vertices.push_back(topo.ids[v]);
+            }
+        }
+        sort(vertices.begin(), vertices.end());
+        vertices.erase(unique(vertices.begin(), vertices.end()), vertices.end());
+        inducedSubgraphEdges(vertices, ws.edges);
+        report[i].ufid = s.getUFID();
+        report[i].cost = computeMSTCost(vertices, ws.edges);
+    });
+    return report;
+}
+
+// verifySchedule for everyone, the classes in start time order
+// (a class with a time that doesn't parse can't be made)
+
+vector<StudentSchedule> Graph::verifyAllSchedules(ThreadPool* pool) const {
+    vector<const Student*> students = studentsByUFID();
+    RoutingTopology topo = routingTopology();
+    vector<StudentSchedule> report(students.size());
+    forEachStudent(pool, students, [&](size_t i, DijkstraWorkspace& ws) {
+        const Student& s = *students[i];
+        vector<pair<ClassId, const ClassInfo*>> day;
+        for (ClassId id : s.getClasses()) {
+            auto it = classes->classInfoMap.find(id);
+            if (it != classes->classInfoMap.end()) day.emplace_back(id, &it->second);
+        }
+        sort(day.begin(), day.end(), [](const auto& a, const auto& b) {
+            return a.second->startTime != b.second->startTime ? a.second->startTime < b.second->startTime
+                                                              : a.first < b.first;
+        });
+        StudentSchedule& row = report[i];
+        row.ufid = s.getUFID();
+        for (size_t k = 0; k + 1 < day.size(); ++k) {
+            const ClassInfo& a = *day[k].second;
+            const ClassInfo& b = *day[k + 1].second;
+            uint32_t from = slotOf(topo, a.locationId), to = slotOf(topo, b.locationId);
+            int cost = -1;
+            if (from != DijkstraWorkspace::NONE && to != DijkstraWorkspace::NONE) {
+                ws.run(topo, from, to);
+                cost = ws.distance(to);
+            }
+            int end, start;
+            bool ok = cost != -1 && clockMinutes(a.endTime, end) && clockMinutes(b.startTime, start) &&
+                      start - end >= cost;
+            row.verdicts.push_back(ok ? "Can make it!" : "Cannot make it!");
+        }
+    });
+    return report;
+}
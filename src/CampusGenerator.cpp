@@ -0,0 +1,236 @@
+#include "CampusGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+// the random bits...
+// mt19937_64 itself is the same everywhere, only the distributions aren't
+
+namespace {
+
+struct Dice {
+    explicit Dice(uint64_t seed) : rng(seed) {}
+    size_t below(size_t n) { return n == 0 ? 0 : static_cast<size_t>(rng() % n); }
+    double unit() { return static_cast<double>(rng() >> 11) * (1.0 / 9007199254740992.0); }
+    bool chance(double p) { return unit() < p; }
+    mt19937_64 rng;
+};
+
+// the periods of the day: 07:25, 08:30, ... (50 minutes each)
+const int PERIODS = 12;
+
+string clockText(int minutes) {
+    char text[32];
+    snprintf(text, sizeof(text), "%02d:%02d", minutes / 60, minutes % 60);
+    return text;
+}
+
+// "Abc" style words from a number, names may only have letters and spaces
+string word(size_t n) {
+    string w;
+    do {
+        w.push_back(static_cast<char>('a' + n % 26));
+        n /= 26;
+    } while (n > 0);
+    w[0] = static_cast<char>(w[0] - 'a' + 'A');
+    return w;
+}
+
+string ufidOf(size_t i) {
+    // 7919 is prime and doesn't divide 9 * 10^7, so every i < 9 * 10^7 gets its own
+    return formatUFID(static_cast<uint32_t>(10000000 + (uint64_t(i) * 7919) % 90000000));
+}
+
+// the i-th class code, AAA.. ZZZ with a 4 digit number, all different
+string classCodeOf(size_t i) {
+    const size_t prefixes = 26 * 26 * 26;
+    size_t letters = i % prefixes;
+    size_t digits = 1000 + (i / prefixes + letters * 131) % 9000;
+    return formatClassCode(static_cast<ClassId>(letters * 10000 + digits));
+}
+
+CampusStudent makeStudent(const Campus& campus, size_t i, Dice& dice) {
+    static const int CLASS_COUNTS[] = {1, 2, 3, 3, 4, 4, 4, 5, 5, 6};
+    CampusStudent s;
+    s.name = "Student " + word(i);
+    s.ufid = ufidOf(i);
+    // residence halls are every 10th location
+    size_t halls = (campus.locations.size() + 9) / 10;
+    s.residence = campus.locations[dice.below(halls) * 10].id;
+    size_t want = min<size_t>(CLASS_COUNTS[dice.below(10)], campus.classes.size());
+    while (s.classes.size() < want) {
+        const string& code = campus.classes[dice.below(campus.classes.size())].code;
+        if (find(s.classes.begin(), s.classes.end(), code) == s.classes.end()) s.classes.push_back(code);
+    }
+    return s;
+}
+
+string insertLine(const CampusStudent& s) {
+    string line = "insert \"" + s.name + "\" " + s.ufid + " " + to_string(s.residence) + " " +
+                  to_string(s.classes.size());
+    for (const string& code : s.classes) line += " " + code;
+    return line;
+}
+
+} // namespace
+
+// the walkways...
+// location k sits in cell (k % side, k / side) of a square, jittered inside
+// its cell. it is joined to one of its already placed neighbours (left, up,
+// up-left, up-right), which makes a random spanning tree (plenty of dead
+// ends, like the real one), and sometimes to more of them (the crossings)
+// a walkway takes its length in minutes plus a geometric extra for stairs,
+// lights, crowds...
+
+Campus generateCampus(const CampusSpec& spec) {
+    Campus campus;
+    Dice dice(spec.seed);
+    size_t n = max<size_t>(spec.locations, 1);
+    size_t side = static_cast<size_t>(ceil(sqrt(static_cast<double>(n))));
+
+    vector<pair<double, double>> at(n);
+    campus.locations.reserve(n);
+    for (size_t k = 0; k < n; ++k) {
+        double x = static_cast<double>(k % side) + 0.15 + 0.7 * dice.unit();
+        double y = static_cast<double>(k / side) + 0.15 + 0.7 * dice.unit();
+        at[k] = {x, y};
+        campus.locations.push_back({static_cast<int>(k + 1), "Hall " + word(k), 29.6300 + y * 0.0004,
+                                    -82.3700 + x * 0.0004});
+    }
+
+    auto minutes = [&](size_t a, size_t b) {
+        double dx = at[a].first - at[b].first, dy = at[a].second - at[b].second;
+        int m = max(1, static_cast<int>(sqrt(dx * dx + dy * dy) * 1.2));
+        while (m < 20 && dice.chance(0.45)) ++m;
+        return m;
+    };
+
+    campus.edges.reserve(n + n / 2);
+    for (size_t k = 1; k < n; ++k) {
+        size_t col = k % side;
+        size_t near[4];
+        size_t count = 0;
+        if (col > 0) near[count++] = k - 1;
+        if (k >= side) {
+            near[count++] = k - side;
+            if (col > 0) near[count++] = k - side - 1;
+            if (col + 1 < side) near[count++] = k - side + 1;
+        }
+        // the first row has only its left neighbour, so there's always one
+        size_t first = dice.below(count);
+        swap(near[0], near[first]);
+        size_t joined = 1;
+        while (joined < count && dice.chance(spec.extraEdges)) {
+            swap(near[joined], near[joined + dice.below(count - joined)]);
+            ++joined;
+        }
+        for (size_t j = 0; j < joined; ++j)
+            campus.edges.push_back({static_cast<int>(near[j] + 1), static_cast<int>(k + 1), minutes(near[j], k)});
+    }
+
+    size_t classCount = spec.classes ? spec.classes : min<size_t>(20000, max<size_t>(1, n / 2));
+    campus.classes.reserve(classCount);
+    for (size_t i = 0; i < classCount; ++i) {
+        CampusClass c;
+        c.code = classCodeOf(i);
+        c.info.locationId = campus.locations[dice.below(n)].id;
+        int start = 7 * 60 + 25 + 65 * static_cast<int>(dice.below(PERIODS));
+        c.info.startTime = clockText(start);
+        c.info.endTime = clockText(start + 50);
+        campus.classes.push_back(std::move(c));
+    }
+
+    campus.students.reserve(spec.students);
+    for (size_t i = 0; i < spec.students; ++i) campus.students.push_back(makeStudent(campus, i, dice));
+    return campus;
+}
+
+bool Campus::writeCSVs(const string& dir) const {
+    string base = dir.empty() || dir.back() == '/' ? dir : dir + "/";
+    ofstream loc(base + "locations.csv"), edge(base + "edges.csv"), cls(base + "classes.csv");
+    if (!loc || !edge || !cls) return false;
+    char number[32];
+    loc << "LocationID,Name,Latitude,Longitude\n";
+    for (const CampusLocation& l : locations) {
+        snprintf(number, sizeof(number), "%.8f,%.8f", l.latitude, l.longitude);
+        loc << l.id << ',' << l.name << ',' << number << '\n';
+    }
+    edge << "LocationID_1,LocationID_2,Name_1,Name_2,Time\n";
+    for (const CampusEdge& e : edges)
+        edge << e.u << ',' << e.v << ',' << locations[e.u - 1].name << ',' << locations[e.v - 1].name << ','
+             << e.minutes << '\n';
+    cls << "ClassCode,LocationID,Start Time (HH:MM),End Time (HH:MM)\n";
+    for (const CampusClass& c : classes)
+        cls << c.code << ',' << c.info.locationId << ',' << c.info.startTime << ',' << c.info.endTime << '\n';
+    return static_cast<bool>(loc.flush()) && static_cast<bool>(edge.flush()) && static_cast<bool>(cls.flush());
+}
+
+void Campus::loadInto(Graph& g) const {
+    for (const CampusEdge& e : edges) g.addEdge(e.u, e.v, e.minutes);
+    for (const CampusClass& c : classes) g.setClassInfo(c.code, c.info);
+    for (const CampusStudent& s : students) g.addStudent(s.name, UFIDKey(s.ufid), s.classes, s.residence);
+}
+
+string Campus::insertCommand(size_t i) const {
+    return insertLine(students[i]);
+}
+
+// the command mix, in percent of the lines
+
+vector<string> generateCommands(const Campus& campus, size_t count, uint64_t seed) {
+    Dice dice(seed);
+    vector<string> lines;
+    lines.reserve(count);
+    vector<string> present;
+    for (const CampusStudent& s : campus.students) present.push_back(s.ufid);
+    size_t nextNew = campus.students.size(); // new students continue the registry's numbering
+    size_t n = campus.locations.size();
+    auto anyLocation = [&]() { return to_string(1 + dice.below(n + n / 20)); }; // a few don't exist
+    auto anyClass = [&]() { return campus.classes[dice.below(campus.classes.size())].code; };
+    auto anyStudent = [&]() { // now and then one that isn't there
+        return present.empty() || dice.chance(0.05) ? ufidOf(nextNew + 1) : present[dice.below(present.size())];
+    };
+    auto anyEdge = [&]() {
+        const CampusEdge& e = campus.edges[dice.below(campus.edges.size())];
+        return to_string(e.u) + " " + to_string(e.v);
+    };
+
+    while (lines.size() < count) {
+        size_t roll = dice.below(100);
+        if (roll < 30) {
+            bool real = !campus.edges.empty() && dice.chance(0.7);
+            lines.push_back("checkEdgeStatus " + (real ? anyEdge() : anyLocation() + " " + anyLocation()));
+        } else if (roll < 50) {
+            lines.push_back("isConnected " + anyLocation() + " " + anyLocation());
+        } else if (roll < 65) {
+            lines.push_back("printShortestEdges " + anyStudent());
+        } else if (roll < 75) {
+            lines.push_back("printStudentZone " + anyStudent());
+        } else if (roll < 83) {
+            CampusStudent s = makeStudent(campus, nextNew++, dice);
+            lines.push_back(insertLine(s));
+            present.push_back(s.ufid);
+        } else if (roll < 88) {
+            if (present.empty()) continue;
+            size_t pick = dice.below(present.size());
+            lines.push_back("remove " + present[pick]);
+            swap(present[pick], present.back());
+            present.pop_back();
+        } else if (roll < 92) {
+            lines.push_back("dropClass " + anyStudent() + " " + anyClass());
+        } else if (roll < 96) {
+            lines.push_back("replaceClass " + anyStudent() + " " + anyClass() + " " + anyClass());
+        } else if (roll < 99) {
+            if (campus.edges.empty()) continue;
+            size_t k = 1 + dice.below(3);
+            string line = "toggleEdgesClosure " + to_string(k);
+            for (size_t j = 0; j < k; ++j) line += " " + anyEdge();
+            lines.push_back(line);
+        } else {
+            lines.push_back("removeClass " + anyClass());
+        }
+    }
+    return lines;
+}
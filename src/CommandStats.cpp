@@ -0,0 +1,200 @@
+#include "CommandStats.h"
+#include <cstdio>
+
+// the buckets...
+// below EXACT a value is its own bucket; above, the top 6 bits of the value
+// (a leading 1 and 5 more) pick one of PER_OCTAVE buckets in its power of two
+
+size_t LatencyHistogram::bucketOf(uint64_t nanos) {
+    if (nanos < EXACT) return static_cast<size_t>(nanos);
+    int top = 63 - __builtin_clzll(nanos);
+    if (top > TOP_BIT) return BUCKETS - 1;
+    size_t sub = static_cast<size_t>(nanos >> (top - 5)) - PER_OCTAVE;
+    return EXACT + static_cast<size_t>(top - 6) * PER_OCTAVE + sub;
+}
+
+uint64_t LatencyHistogram::lowestOf(size_t bucket) {
+    if (bucket < EXACT) return bucket;
+    size_t k = bucket - EXACT;
+    int top = static_cast<int>(k / PER_OCTAVE) + 6;
+    return static_cast<uint64_t>(k % PER_OCTAVE + PER_OCTAVE) << (top - 5);
+}
+
+uint64_t LatencyHistogram::middleOf(size_t bucket) {
+    if (bucket < EXACT) return bucket;
+    int top = static_cast<int>((bucket - EXACT) / PER_OCTAVE) + 6;
+    return lowestOf(bucket) + (uint64_t(1) << (top - 5)) / 2;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    if (total == 0) return 0;
+    // the smallest value with at least q of all the values at or below it
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total));
+    if (rank < 1) rank = 1;
+    if (rank > total) rank = total;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < BUCKETS; ++b) {
+        seen += counts[b];
+        if (seen >= rank) return middleOf(b);
+    }
+    return maximum();
+}
+
+uint64_t LatencyHistogram::maximum() const {
+    for (size_t b = BUCKETS; b-- > 0;)
+        if (counts[b]) return middleOf(b);
+    return 0;
+}
+
+
+// the per-thread blocks...
+
+CommandStats& CommandStats::global() {
+    static CommandStats stats;
+    return stats;
+}
+
+// every CommandStats gets its own number, so a thread's cached block can't
+// be mistaken for one of a newer CommandStats at the same address
+static atomic<uint64_t> nextStatsId{1};
+
+CommandStats::CommandStats() : id(nextStatsId.fetch_add(1)) {}
+
+CommandStats::Block& CommandStats::local() {
+    // every thread remembers its block in each CommandStats it recorded into
+    // (a handful at most, so a list beats a map), switching back and forth
+    // between two finds the old block again instead of making a new one;
+    // ids are never reused, so a dead instance's entry is just never matched
+    thread_local vector<pair<uint64_t, Block*>> mine;
+    for (auto& [owner, block] : mine)
+        if (owner == id) return *block;
+    lock_guard<mutex> guard(lock);
+    blocks.push_back(make_unique<Block>());
+    mine.emplace_back(id, blocks.back().get());
+    return *blocks.back();
+}
+
+// only this thread writes its block, so a load and a store do (no locked add)
+static void bump(atomic<uint64_t>& counter) {
+    counter.store(counter.load(memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+void CommandStats::record(CommandKind kind, uint64_t nanos, bool failed) {
+    if (!enabled()) return;
+    size_t k = static_cast<size_t>(kind);
+    if (k >= COMMAND_KINDS) k = static_cast<size_t>(CommandKind::Unknown);
+    Block& b = local();
+    bump(b.calls[k]);
+    if (failed) bump(b.errors[k]);
+    bump(b.buckets[k][LatencyHistogram::bucketOf(nanos)]);
+}
+
+vector<CommandSummary> CommandStats::merged() const {
+    vector<CommandSummary> all(COMMAND_KINDS);
+    lock_guard<mutex> guard(lock);
+    for (const auto& b : blocks) {
+        for (size_t k = 0; k < COMMAND_KINDS; ++k) {
+            all[k].calls += b->calls[k].load(memory_order_relaxed);
+            all[k].errors += b->errors[k].load(memory_order_relaxed);
+            for (size_t i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+                uint64_t n = b->buckets[k][i].load(memory_order_relaxed);
+                if (n) all[k].latency.add(i, n);
+            }
+        }
+    }
+    return all;
+}
+
+void CommandStats::reset() {
+    lock_guard<mutex> guard(lock);
+    for (const auto& b : blocks) {
+        for (size_t k = 0; k < COMMAND_KINDS; ++k) {
+            b->calls[k].store(0, memory_order_relaxed);
+            b->errors[k].store(0, memory_order_relaxed);
+            for (auto& n : b->buckets[k]) n.store(0, memory_order_relaxed);
+        }
+    }
+    perfTotals.reset();
+}
+
+// the counters, averaged per measurement, one row per kind that has any
+template <typename Name>
+static void putPerfTable(const char* title, const PerfTotals& perf, Name name, OutputBuffer& out) {
+    if (perf.empty()) return;
+    char row[160];
+    snprintf(row, sizeof(row), "%-20s %10s %8s %12s %12s %6s %12s %12s\n", title, "measured", "scaled",
+             "cycles", "instructions", "IPC", "cache miss", "branch miss");
+    out.put(row);
+    for (size_t k = 0; k < perf.rows(); ++k) {
+        PerfSample s = perf.total(k);
+        if (s.count == 0) continue;
+        double n = static_cast<double>(s.count);
+        auto each = [n](uint64_t total) { return static_cast<double>(total) / n; };
+        double ipc = s.cycles ? static_cast<double>(s.instructions) / static_cast<double>(s.cycles) : 0.0;
+        snprintf(row, sizeof(row), "%-20s %10llu %8llu %12.0f %12.0f %6.2f %12.1f %12.1f\n", name(k),
+                 static_cast<unsigned long long>(s.count), static_cast<unsigned long long>(s.scaled),
+                 each(s.cycles), each(s.instructions), ipc, each(s.cacheMisses), each(s.branchMisses));
+        out.put(row);
+    }
+}
+
+void CommandStats::print(OutputBuffer& out) const {
+    char row[160];
+    snprintf(row, sizeof(row), "%-20s %10s %8s %10s %10s %10s %10s\n", "command", "calls", "errors", "p50 us",
+             "p99 us", "p99.9 us", "max us");
+    out.put(row);
+    vector<CommandSummary> all = merged();
+    auto micros = [](uint64_t nanos) { return static_cast<double>(nanos) / 1000.0; };
+    for (size_t k = 0; k < COMMAND_KINDS; ++k) {
+        const CommandSummary& s = all[k];
+        if (s.calls == 0) continue;
+        snprintf(row, sizeof(row), "%-20s %10llu %8llu %10.1f %10.1f %10.1f %10.1f\n",
+                 commandName(static_cast<CommandKind>(k)), static_cast<unsigned long long>(s.calls),
+                 static_cast<unsigned long long>(s.errors), micros(s.latency.percentile(0.5)),
+                 micros(s.latency.percentile(0.99)), micros(s.latency.percentile(0.999)),
+                 micros(s.latency.maximum()));
+        out.put(row);
+    }
+    putPerfTable("counters", perfTotals, [](size_t k) { return commandName(static_cast<CommandKind>(k)); }, out);
+}
+
+void printSearchTotals(const SearchTotals& totals, OutputBuffer& out) {
+    char row[160];
+    bool header = false;
+    for (size_t k = 0; k < SEARCH_KINDS; ++k) {
+        SearchKind kind = static_cast<SearchKind>(k);
+        SearchStats s = totals.total(kind);
+        if (s.searches == 0) continue;
+        if (!header) {
+            snprintf(row, sizeof(row), "%-20s %10s %10s %10s %10s %10s %10s %10s\n", "search", "count",
+                     "settled", "relaxed", "pushes", "pops", "stale", "avg us");
+            out.put(row);
+            header = true;
+        }
+        double n = static_cast<double>(s.searches);
+        auto each = [n](uint64_t total) { return static_cast<double>(total) / n; };
+        snprintf(row, sizeof(row), "%-20s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", searchName(kind),
+                 static_cast<unsigned long long>(s.searches), each(s.nodesSettled), each(s.edgesRelaxed),
+                 each(s.heapPushes), each(s.heapPops), each(s.stalePops), each(s.nanos) / 1000.0);
+        out.put(row);
+    }
+    putPerfTable("search counters", totals.perf(), [](size_t k) { return searchName(static_cast<SearchKind>(k)); },
+                 out);
+}
+
+void putSearchWork(SearchKind kind, const SearchStats& s, string_view indent, OutputBuffer& out) {
+    char row[200];
+    snprintf(row, sizeof(row), "%s: %llu searches, %llu settled, %llu relaxed, %llu pushes, %llu pops, %llu stale, %.1f us\n",
+             searchName(kind), static_cast<unsigned long long>(s.searches),
+             static_cast<unsigned long long>(s.nodesSettled), static_cast<unsigned long long>(s.edgesRelaxed),
+             static_cast<unsigned long long>(s.heapPushes), static_cast<unsigned long long>(s.heapPops),
+             static_cast<unsigned long long>(s.stalePops), static_cast<double>(s.nanos) / 1000.0);
+    out.put(indent);
+    out.put(row);
+    if (s.subgraphNodes) {
+        snprintf(row, sizeof(row), "subgraph: %llu locations, %llu edges\n",
+                 static_cast<unsigned long long>(s.subgraphNodes), static_cast<unsigned long long>(s.subgraphEdges));
+        out.put(indent);
+        out.put(row);
+    }
+}
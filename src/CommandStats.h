@@ -0,0 +1,134 @@
+// CommandStats.h
+// how many commands of every kind ran, how many said "unsuccessful", and
+// how long they took (the `stats` command, and `Main --stats` at exit)
+//
+// every thread that runs commands gets its own block of counters the first
+// time it records one, so recording is a couple of plain stores to memory
+// nobody else writes (no locks, no shared cache lines). printing adds up
+// all the blocks, a block outlives its thread so nothing is lost
+//
+// the times go into a log-linear histogram like HdrHistogram: exact below
+// 64 ns, then 32 buckets per power of two (within ~3%), up to ~2 hours
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Commands.h"
+#include "PerfCounters.h"
+#include "SearchStats.h"
+#include "SlowQueryLog.h"
+
+using namespace std;
+
+// one histogram's buckets, plain numbers (what the merge hands out)
+class LatencyHistogram {
+public:
+    static constexpr size_t EXACT = 64;
+    static constexpr size_t PER_OCTAVE = 32;
+    static constexpr int TOP_BIT = 42; // values from 2^43 ns up share the last bucket
+    static constexpr size_t BUCKETS = EXACT + (TOP_BIT - 5) * PER_OCTAVE;
+
+    static size_t bucketOf(uint64_t nanos);
+    static uint64_t lowestOf(size_t bucket);  // smallest value in the bucket
+    static uint64_t middleOf(size_t bucket);  // what we report for it
+
+    void add(size_t bucket, uint64_t count) { counts[bucket] += count; total += count; }
+    uint64_t count() const { return total; }
+    // q in [0, 1], 0 if empty
+    uint64_t percentile(double q) const;
+    uint64_t maximum() const;
+
+private:
+    uint64_t counts[BUCKETS] = {};
+    uint64_t total = 0;
+};
+
+struct CommandSummary {
+    uint64_t calls = 0;
+    uint64_t errors = 0;
+    LatencyHistogram latency;
+};
+
+class CommandStats {
+public:
+    CommandStats();
+    CommandStats(const CommandStats&) = delete;
+    CommandStats& operator=(const CommandStats&) = delete;
+    static CommandStats& global();
+
+    // off until enabled (Main turns it on), recording while off does nothing
+    void enable(bool on = true) { switchedOn.store(on, memory_order_relaxed); }
+    bool enabled() const { return switchedOn.load(memory_order_relaxed); }
+
+    void record(CommandKind kind, uint64_t nanos, bool failed);
+
+    // everything so far, added up over the threads
+    vector<CommandSummary> merged() const;
+
+    // hardware counters per command kind (PerfCounters.h, only with --perf)
+    PerfTotals& perf() { return perfTotals; }
+    const PerfTotals& perf() const { return perfTotals; }
+
+    // the table the `stats` command prints: calls, errors and p50/p99/p99.9
+    // (and max) in microseconds for every kind that ran at least once, and
+    // the counters per call when they were measured
+    void print(OutputBuffer& out) const;
+
+    // back to zero (a thread recording right now may keep a few counts)
+    void reset();
+
+private:
+    struct Block {
+        atomic<uint64_t> calls[COMMAND_KINDS] = {};
+        atomic<uint64_t> errors[COMMAND_KINDS] = {};
+        atomic<uint64_t> buckets[COMMAND_KINDS][LatencyHistogram::BUCKETS] = {};
+    };
+    Block& local();
+
+    const uint64_t id;
+    atomic<bool> switchedOn{false};
+    mutable mutex lock; // guards blocks (the list, not the counts)
+    vector<unique_ptr<Block>> blocks;
+    PerfTotals perfTotals{COMMAND_KINDS};
+};
+
+// the search side (SearchStats.h): per kind of search, how many ran and what
+// one took on average (nodes settled, edges relaxed, heap pushes/pops, stale
+// pops, microseconds) and the counters per search if they were measured,
+// nothing if no search was counted
+void printSearchTotals(const SearchTotals& totals, OutputBuffer& out);
+
+// what one command's searches of a kind did, on one line after indent (and
+// a zone's subgraph on the next), for the slow query log and explain
+void putSearchWork(SearchKind kind, const SearchStats& s, string_view indent, OutputBuffer& out);
+
+// times one command: started when it's made, recorded by finish(), which
+// also hands back the time for the slow query log (0 when nobody wanted it:
+// with the stats and the slow log off the clock is never read, same for the counters)
+class CommandTimer {
+public:
+    explicit CommandTimer(CommandStats& stats = CommandStats::global())
+        : stats(stats), on(stats.enabled()), timed(on || SlowQueryLog::global().enabled()),
+          counters(stats.perf()) {
+        if (timed) start = chrono::steady_clock::now();
+    }
+    uint64_t finish(CommandKind kind, bool ok) {
+        counters.finish(static_cast<size_t>(kind));
+        if (!timed) return 0;
+        auto took = static_cast<uint64_t>(
+            chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+        if (on) stats.record(kind, took, !ok);
+        return took;
+    }
+
+private:
+    CommandStats& stats;
+    bool on;
+    bool timed;
+    chrono::steady_clock::time_point start;
+    PerfScope counters;
+};
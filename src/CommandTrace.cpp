@@ -0,0 +1,108 @@
+#include "CommandTrace.h"
+#include <cstring>
+
+static const size_t FLUSH_AT = size_t(1) << 20;
+
+static void putVarint(string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// writing...
+
+bool TraceWriter::open(const string& path, string& error, uint64_t edgesFingerprint, uint64_t classesFingerprint) {
+    close();
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        error = "can't write " + path;
+        return false;
+    }
+    TraceHeader head{};
+    memcpy(head.magic, TRACE_MAGIC, sizeof(head.magic));
+    head.version = TRACE_VERSION;
+    head.startedAt = static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count());
+    head.edgesFingerprint = edgesFingerprint;
+    head.classesFingerprint = classesFingerprint;
+    buffer.assign(reinterpret_cast<const char*>(&head), sizeof(head));
+    start = chrono::steady_clock::now();
+    last = 0;
+    records = 0;
+    return true;
+}
+
+void TraceWriter::record(string_view line) {
+    lock_guard<mutex> guard(lock);
+    if (!file) return;
+    uint64_t now = static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    if (now < last) now = last;
+    putVarint(buffer, now - last);
+    putVarint(buffer, line.size());
+    buffer.append(line.data(), line.size());
+    last = now;
+    ++records;
+    if (buffer.size() >= FLUSH_AT) flushLocked();
+}
+
+void TraceWriter::flushLocked() {
+    if (file && !buffer.empty()) fwrite(buffer.data(), 1, buffer.size(), file);
+    buffer.clear();
+}
+
+void TraceWriter::close() {
+    lock_guard<mutex> guard(lock);
+    if (!file) return;
+    flushLocked();
+    fclose(file);
+    file = nullptr;
+}
+
+// reading...
+
+bool TraceReader::open(const string& path, string& error) {
+    if (!file.open(path)) {
+        error = "can't read " + path;
+        return false;
+    }
+    bytes = file.contents();
+    if (bytes.size() < sizeof(TraceHeader)) {
+        error = path + " is not a trace";
+        return false;
+    }
+    memcpy(&head, bytes.data(), sizeof(head));
+    if (memcmp(head.magic, TRACE_MAGIC, sizeof(head.magic)) != 0 || head.version != TRACE_VERSION) {
+        error = path + " is not a trace (or another version)";
+        return false;
+    }
+    rewind();
+    return true;
+}
+
+bool TraceReader::varint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= bytes.size()) return false;
+        uint8_t b = static_cast<uint8_t>(bytes[pos++]);
+        value |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+bool TraceReader::next(TraceRecord& record) {
+    if (broken || pos >= bytes.size()) return false;
+    uint64_t delta, length;
+    if (!varint(delta) || !varint(length) || length > bytes.size() - pos) {
+        broken = true;
+        return false;
+    }
+    at += delta;
+    record.at = at;
+    record.line = bytes.substr(pos, static_cast<size_t>(length));
+    pos += static_cast<size_t>(length);
+    return true;
+}
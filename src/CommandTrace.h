@@ -0,0 +1,86 @@
+// CommandTrace.h
+// recording the commands main.cpp gets (--record=FILE) and reading them
+// back (the Replay tool, bench/replay.cpp)
+//
+// file = TraceHeader, then one record per command line:
+//   varint  nanoseconds since the previous record (the first: since the start)
+//   varint  length of the line
+//   bytes   the line, as it came in (no newline)
+// varints are LEB128 (7 bits per byte, low bits first), so a line a few
+// microseconds after the last one costs 2-3 bytes on top of its text
+// the header keeps the fingerprints of the CSVs the graph started from,
+// so a replay can tell whether it starts from the same campus
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "CsvReader.h"
+
+using namespace std;
+
+constexpr char TRACE_MAGIC[8] = {'C','A','M','P','T','R','C','1'};
+constexpr uint32_t TRACE_VERSION = 1;
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t startedAt;          // wall clock, ns since 1970, just for people
+    uint64_t edgesFingerprint;   // fingerprintFile of the edges.csv (0: unknown)
+    uint64_t classesFingerprint; // same for classes.csv
+};
+
+// TraceWriter appends records, from any number of threads (the server loops
+// share one), the time is taken under the lock so it never goes backwards
+// written in big blocks, the rest goes out on close
+class TraceWriter {
+public:
+    TraceWriter() = default;
+    ~TraceWriter() { close(); }
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    bool open(const string& path, string& error, uint64_t edgesFingerprint = 0, uint64_t classesFingerprint = 0);
+    void record(string_view line);
+    void close();
+    size_t recordCount() const { return records; }
+
+private:
+    void flushLocked();
+    mutex lock;
+    FILE* file = nullptr;
+    string buffer;
+    chrono::steady_clock::time_point start;
+    uint64_t last = 0; // ns since start of the previous record
+    size_t records = 0;
+};
+
+struct TraceRecord {
+    uint64_t at = 0;    // ns since the trace started
+    string_view line;   // points into the mapped trace
+};
+
+// TraceReader walks a trace (mapped, nothing is copied)
+class TraceReader {
+public:
+    bool open(const string& path, string& error);
+    const TraceHeader& header() const { return head; }
+
+    // false at the end, or at a record that runs past the end (then corrupt())
+    bool next(TraceRecord& record);
+    bool corrupt() const { return broken; }
+    void rewind() { pos = sizeof(TraceHeader); at = 0; broken = false; }
+
+private:
+    bool varint(uint64_t& value);
+    MappedFile file;
+    string_view bytes;
+    TraceHeader head{};
+    size_t pos = 0;
+    uint64_t at = 0;
+    bool broken = false;
+};
@@ -0,0 +1,686 @@
+#include "Commands.h"
+#include "CommandStats.h"
+#include "SlowQueryLog.h"
+#include "TimedRegions.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define COMMANDS_HAS_READ 1
+#endif
+
+// the command words, grouped by length, so a lookup is one switch and
+// at most two compares
+
+CommandKind commandKindOf(string_view w) {
+    switch (w.size()) {
+    case 5:
+        if (w == "stats") return CommandKind::Stats;
+        break;
+    case 7:
+        if (w == "slowlog") return CommandKind::SlowLog;
+        if (w == "explain") return CommandKind::Explain;
+        break;
+    case 6:
+        if (w == "insert") return CommandKind::Insert;
+        if (w == "remove") return CommandKind::Remove;
+        break;
+    case 9:
+        if (w == "dropClass") return CommandKind::DropClass;
+        break;
+    case 11:
+        if (w == "removeClass") return CommandKind::RemoveClass;
+        if (w == "isConnected") return CommandKind::IsConnected;
+        break;
+    case 12:
+        if (w == "replaceClass") return CommandKind::ReplaceClass;
+        break;
+    case 15:
+        if (w == "checkEdgeStatus") return CommandKind::CheckEdgeStatus;
+        break;
+    case 16:
+        if (w == "printStudentZone") return CommandKind::PrintStudentZone;
+        break;
+    case 18:
+        if (w == "toggleEdgesClosure") return CommandKind::ToggleEdgesClosure;
+        if (w == "printShortestEdges") return CommandKind::PrintShortestEdges;
+        break;
+    }
+    return CommandKind::Unknown;
+}
+
+// the tokenizer...
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+void CommandTokenizer::skipSpace() {
+    size_t i = 0;
+    while (i < rest.size() && isSpace(rest[i])) ++i;
+    rest.remove_prefix(i);
+}
+
+bool CommandTokenizer::word(string_view& out) {
+    out = string_view();
+    if (failed) return false;
+    skipSpace();
+    size_t i = 0;
+    while (i < rest.size() && !isSpace(rest[i])) ++i;
+    if (i == 0) return !(failed = true);
+    out = rest.substr(0, i);
+    rest.remove_prefix(i);
+    return true;
+}
+
+string_view CommandTokenizer::remaining() {
+    skipSpace();
+    return rest;
+}
+
+bool CommandTokenizer::integer(int& n) {
+    n = 0;
+    if (failed) return false;
+    skipSpace();
+    // from_chars doesn't take a '+', the stream does
+    size_t start = !rest.empty() && rest[0] == '+' ? 1 : 0;
+    if (start && (rest.size() < 2 || rest[1] == '-')) return !(failed = true);
+    auto [end, ec] = from_chars(rest.data() + start, rest.data() + rest.size(), n);
+    if (ec == errc::invalid_argument) return !(failed = true);
+    if (ec == errc::result_out_of_range) {
+        n = rest[start] == '-' ? INT_MIN : INT_MAX; // what the stream leaves there
+        return !(failed = true);
+    }
+    rest.remove_prefix(static_cast<size_t>(end - rest.data()));
+    return true;
+}
+
+bool CommandTokenizer::name(string_view& out) {
+    out = string_view();
+    if (failed) return false;
+    skipSpace();
+    if (rest.empty() || rest[0] != '"') return word(out);
+    // everything up to the closing quote (or the end of the line)
+    size_t close = rest.find('"', 1);
+    out = rest.substr(1, close == string_view::npos ? string_view::npos : close - 1);
+    rest.remove_prefix(close == string_view::npos ? rest.size() : close + 1);
+    return true;
+}
+
+
+// output...
+
+OutputBuffer::OutputBuffer(FILE* out, size_t capacity) : out(out), capacity(capacity) {
+    buffer.reserve(capacity + 256);
+}
+
+void OutputBuffer::putInt(long long value) {
+    char digits[24];
+    auto result = to_chars(digits, digits + sizeof(digits), value);
+    put(string_view(digits, static_cast<size_t>(result.ptr - digits)));
+}
+
+void OutputBuffer::flush() {
+    if (!out || buffer.empty()) return;
+    fwrite(buffer.data(), 1, buffer.size(), out);
+    fflush(out);
+    buffer.clear();
+}
+
+
+// input...
+
+InputReader::InputReader(FILE* in, size_t blockSize) : in(in), blockSize(blockSize) {}
+
+// drops the lines already handed out, then appends one block
+// (read() returns whatever is there, fread would wait for a full block)
+bool InputReader::fill() {
+    if (eof) return false;
+    buffer.erase(0, pos);
+    pos = 0;
+    size_t old = buffer.size();
+    buffer.resize(old + blockSize);
+#ifdef COMMANDS_HAS_READ
+    ssize_t got = ::read(fileno(in), &buffer[old], blockSize);
+    if (got < 0) got = 0;
+#else
+    size_t got = fread(&buffer[old], 1, blockSize, in);
+#endif
+    buffer.resize(old + static_cast<size_t>(got));
+    if (got == 0) eof = true;
+    return got > 0;
+}
+
+bool InputReader::lineReady() const {
+    return eof || memchr(buffer.data() + pos, '\n', buffer.size() - pos) != nullptr;
+}
+
+// the line is only good until the next call
+bool InputReader::next(string_view& line) {
+    size_t nl;
+    while ((nl = buffer.find('\n', pos)) == string::npos) {
+        if (!fill()) break;
+    }
+    if (nl == string::npos) {
+        if (pos >= buffer.size()) return false;
+        nl = buffer.size(); // last line without a newline
+    }
+    line = string_view(buffer).substr(pos, nl - pos);
+    pos = min(nl + 1, buffer.size());
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    return true;
+}
+
+int readCommandCount(InputReader& input) {
+    string_view line;
+    while (input.next(line)) {
+        string_view probe;
+        if (!CommandTokenizer(line).word(probe)) continue; // blank line, keep looking
+        int n;
+        return CommandTokenizer(line).integer(n) ? n : 0;
+    }
+    return 0;
+}
+
+
+// the commands themselves...
+// same output as the old if/else chain in main.cpp, word for word
+
+// these return whether the command worked, false is what stats counts as an error
+
+static bool putResult(OutputBuffer& out, bool ok) {
+    out.put(ok ? "successful\n" : "unsuccessful\n");
+    return ok;
+}
+
+bool isMutation(CommandKind kind) {
+    switch (kind) {
+    case CommandKind::Insert:
+    case CommandKind::Remove:
+    case CommandKind::DropClass:
+    case CommandKind::ReplaceClass:
+    case CommandKind::RemoveClass:
+    case CommandKind::ToggleEdgesClosure:
+        return true;
+    default:
+        return false;
+    }
+}
+
+const char* commandName(CommandKind kind) {
+    static const char* const NAMES[COMMAND_KINDS] = {
+        "insert", "remove", "dropClass", "replaceClass", "removeClass", "toggleEdgesClosure",
+        "checkEdgeStatus", "isConnected", "printShortestEdges", "printStudentZone", "stats", "slowlog",
+        "explain", "unknown",
+    };
+    size_t k = static_cast<size_t>(kind);
+    return k < COMMAND_KINDS ? NAMES[k] : "unknown";
+}
+
+CommandKind commandKindOfLine(string_view line) {
+    string_view cmd;
+    CommandTokenizer(line).word(cmd);
+    return commandKindOf(cmd);
+}
+
+// explain runs the command it wraps, so "explain insert ..." is a mutation too
+static CommandKind wrappedKind(string_view line) {
+    CommandTokenizer tok(line);
+    string_view cmd;
+    tok.word(cmd);
+    CommandKind kind = commandKindOf(cmd);
+    if (kind == CommandKind::Explain) { // one level only, "explain explain" fails
+        tok.word(cmd);
+        kind = commandKindOf(cmd);
+    }
+    return kind;
+}
+
+static bool changesGraph(string_view line) { return isMutation(wrappedKind(line)); }
+
+// stats and slowlog don't change the graph, but what they print is made of
+// the commands before them, so those have to have run (and been counted) first
+static bool readsHistory(string_view line) {
+    CommandKind kind = wrappedKind(line);
+    return kind == CommandKind::Stats || kind == CommandKind::SlowLog;
+}
+
+// the read-only commands only ever see a const Graph, so the compiler
+// checks that nothing here changes it (that's what lets them run in parallel)
+
+static bool runQueryKind(const Graph& g, CommandKind kind, CommandTokenizer& tok, OutputBuffer& out) {
+    switch (kind) {
+    case CommandKind::CheckEdgeStatus: {
+        int a, b;
+        tok.integer(a);
+        tok.integer(b);
+        out.put(g.checkEdgeStatus(a, b));
+        out.put('\n');
+        return true;
+    }
+    case CommandKind::IsConnected: {
+        int a, b;
+        tok.integer(a);
+        tok.integer(b);
+        return putResult(out, g.isConnected(a, b));
+    }
+    case CommandKind::PrintShortestEdges: {
+        string_view text;
+        tok.word(text);
+        putShortestEdges(g, UFIDKey(text), out);
+        return true;
+    }
+    case CommandKind::PrintStudentZone: {
+        string_view text;
+        tok.word(text);
+        putStudentZone(g, UFIDKey(text), out);
+        return true;
+    }
+    case CommandKind::Stats:
+        CommandStats::global().print(out);
+        printSearchTotals(SearchTotals::global(), out);
+        return true;
+    case CommandKind::SlowLog:
+        SlowQueryLog::global().print(out);
+        return true;
+    default: // Unknown, or a mutation that was sent here by mistake
+        return putResult(out, false);
+    }
+}
+
+// the two multi-line answers, shared with the binary channel (ShmChannel.cpp)
+
+void putShortestEdges(const Graph& g, UFIDKey ufid, OutputBuffer& out) {
+    // packed class ids sort the same as the codes, so no strings needed
+    int residence = g.getStudentResidence(ufid);
+    ClassSpan span = g.getStudentClassIds(ufid);
+    ClassId ids[Student::MAX_CLASSES];
+    size_t count = min(span.size(), size_t(Student::MAX_CLASSES));
+    copy(span.begin(), span.begin() + count, ids);
+    sort(ids, ids + count);
+    out.put("Name: ");
+    out.put(g.getStudentNameView(ufid));
+    out.put('\n');
+    for (size_t i = 0; i < count; ++i) {
+        int loc = g.getClassLocationById(ids[i]);
+        int t = loc == -1 ? -1 : g.shortestTime(residence, loc);
+        out.put(formatClassCode(ids[i]));
+        out.put(" | Total Time: ");
+        out.putInt(t);
+        out.put('\n');
+    }
+}
+
+void putStudentZone(const Graph& g, UFIDKey ufid, OutputBuffer& out) {
+    int residence = g.getStudentResidence(ufid);
+    int locs[Student::MAX_CLASSES];
+    size_t count = 0;
+    for (ClassId id : g.getStudentClassIds(ufid)) {
+        int loc = g.getClassLocationById(id);
+        if (loc != -1 && count < Student::MAX_CLASSES) locs[count++] = loc;
+    }
+    int cost = g.computeStudentZoneCost(residence, locs, count);
+    out.put("Student Zone Cost For ");
+    out.put(g.getStudentNameView(ufid));
+    out.put(": ");
+    out.putInt(cost);
+    out.put('\n');
+}
+
+// explain <command>...
+// (explaining an explain is unsuccessful, the nesting would have no end)
+// runs the command as usual, then tells how it was answered: the routing
+// index's state, the searches it ran (which engine, how much work), a zone's
+// induced subgraph, and the time spent in each timed region inside it
+
+#ifdef CAMPUS_TIMED_REGIONS
+namespace {
+struct ExplainPhase {
+    string stack; // "printStudentZone;dijkstra", the names from the outermost down
+    const char* name;
+    uint32_t depth;
+    uint64_t count = 0;
+    uint64_t nanos = 0;
+};
+} // namespace
+
+// the regions in the order they were entered, the same stacks added up
+static vector<ExplainPhase> explainPhases(vector<RegionEvent> events) {
+    sort(events.begin(), events.end(), [](const RegionEvent& a, const RegionEvent& b) {
+        return a.start != b.start ? a.start < b.start : a.depth < b.depth;
+    });
+    vector<ExplainPhase> phases;
+    vector<string> open; // the stack down to the current event
+    for (const RegionEvent& e : events) {
+        open.resize(e.depth + 1);
+        open[e.depth] = e.depth ? open[e.depth - 1] + ';' + e.name : string(e.name);
+        auto it = find_if(phases.begin(), phases.end(), [&](const ExplainPhase& p) { return p.stack == open[e.depth]; });
+        if (it == phases.end()) {
+            phases.push_back({open[e.depth], e.name, e.depth});
+            it = phases.end() - 1;
+        }
+        ++it->count;
+        it->nanos += e.duration;
+    }
+    return phases;
+}
+#endif
+
+static const char* routingState(bool enabled, bool readyBefore, bool readyAfter) {
+    if (!enabled) return "off, cost queries use dijkstra";
+    if (readyBefore) return readyAfter ? "hit" : "hit, out of date after the command";
+    if (readyAfter) return "miss, ready by the end of the command";
+    return "miss, being built, cost queries use dijkstra";
+}
+
+template <class Run>
+static bool explainLine(const Graph& g, string_view inner, OutputBuffer& out, Run run) {
+    bool readyBefore = g.routingIndexReady();
+    CommandKind kind = CommandKind::Unknown;
+    bool ok;
+    uint64_t took;
+    SearchCapture searches;
+    vector<RegionEvent> events;
+    {
+        RegionListener regions;
+        auto start = chrono::steady_clock::now();
+        ok = run(kind);
+        took = static_cast<uint64_t>(
+            chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+        events = move(regions.events);
+    }
+
+    char row[160];
+    out.put("explain ");
+    out.put(inner);
+    snprintf(row, sizeof(row), "\n  %s: %s, %.1f us\n", commandName(kind), ok ? "successful" : "unsuccessful",
+             static_cast<double>(took) / 1000.0);
+    out.put(row);
+    out.put("  routing index: ");
+    out.put(routingState(g.routingIndexEnabled(), readyBefore, g.routingIndexReady()));
+    out.put("\n  engine:");
+    bool any = false;
+    for (size_t k = 0; k < SEARCH_KINDS; ++k) {
+        if (!searches.kinds[k].searches) continue;
+        out.put(any ? ", " : " ");
+        out.put(searchName(static_cast<SearchKind>(k)));
+        any = true;
+    }
+    out.put(any ? "\n" : " none\n");
+    for (size_t k = 0; k < SEARCH_KINDS; ++k)
+        if (searches.kinds[k].searches) putSearchWork(static_cast<SearchKind>(k), searches.kinds[k], "    ", out);
+#ifdef CAMPUS_TIMED_REGIONS
+    out.put("  phases:\n");
+    for (const ExplainPhase& p : explainPhases(move(events))) {
+        out.put(string(4 + 2 * p.depth, ' '));
+        out.put(p.name);
+        if (p.count > 1) {
+            snprintf(row, sizeof(row), " x%llu", static_cast<unsigned long long>(p.count));
+            out.put(row);
+        }
+        snprintf(row, sizeof(row), " %.1f us\n", static_cast<double>(p.nanos) / 1000.0);
+        out.put(row);
+    }
+#else
+    out.put("  phases: not timed (built without CAMPUS_TIMED_REGIONS)\n");
+#endif
+    return ok;
+}
+
+// the line's kind comes back in `kind` (Unknown for an empty line)
+
+static bool queryLine(const Graph& g, string_view line, OutputBuffer& out, CommandKind& kind) {
+    kind = CommandKind::Unknown;
+    if (line.empty()) return putResult(out, false);
+    CommandTokenizer tok(line);
+    string_view cmd;
+    tok.word(cmd);
+    kind = commandKindOf(cmd);
+    if (kind == CommandKind::Explain) {
+        string_view inner = tok.remaining();
+        if (commandKindOfLine(inner) == CommandKind::Explain) return putResult(out, false);
+        return explainLine(g, inner, out, [&](CommandKind& k) { return queryLine(g, inner, out, k); });
+    }
+    TIMED_REGION(commandName(kind)); // the dispatch, the regions below nest in it
+    return runQueryKind(g, kind, tok, out);
+}
+
+static bool commandLine(Graph& g, string_view line, OutputBuffer& out, CommandKind& kind) {
+    kind = CommandKind::Unknown;
+    if (line.empty()) return putResult(out, false);
+    CommandTokenizer tok(line);
+    string_view cmd;
+    tok.word(cmd);
+    kind = commandKindOf(cmd);
+    if (kind == CommandKind::Explain) {
+        string_view inner = tok.remaining();
+        if (commandKindOfLine(inner) == CommandKind::Explain) return putResult(out, false);
+        return explainLine(g, inner, out, [&](CommandKind& k) { return commandLine(g, inner, out, k); });
+    }
+    TIMED_REGION(commandName(kind));
+
+    switch (kind) {
+    case CommandKind::Insert: {
+        // ufid is kept as text so the leading zeros survive
+        string_view name, ufid;
+        int residence, n;
+        tok.name(name);
+        if (!tok.word(ufid) || !tok.integer(residence) || !tok.integer(n)) {
+            return putResult(out, false);
+        }
+        // a student has 1 to 6 classes, anything else can't succeed
+        if (n < 1 || n > Student::MAX_CLASSES) return putResult(out, false);
+        string_view classes[Student::MAX_CLASSES];
+        int got = 0;
+        while (got < n && tok.word(classes[got])) ++got;
+        if (got != n) return putResult(out, false);
+        return putResult(out, g.addStudent(name, UFIDKey(ufid), classes, got, residence));
+    }
+    case CommandKind::Remove: {
+        string_view ufid;
+        tok.word(ufid);
+        return putResult(out, g.removeStudent(UFIDKey(ufid)));
+    }
+    case CommandKind::DropClass: {
+        string_view ufid, classCode;
+        tok.word(ufid);
+        tok.word(classCode);
+        return putResult(out, g.dropClass(UFIDKey(ufid), classCode));
+    }
+    case CommandKind::ReplaceClass: {
+        string_view ufid, oldC, newC;
+        tok.word(ufid);
+        tok.word(oldC);
+        tok.word(newC);
+        return putResult(out, g.replaceClass(UFIDKey(ufid), oldC, newC));
+    }
+    case CommandKind::RemoveClass: {
+        string_view classCode;
+        tok.word(classCode);
+        out.putInt(g.removeClass(classCode));
+        out.put('\n');
+        return true;
+    }
+    case CommandKind::ToggleEdgesClosure: {
+        // count is only the client's word for it, we stop at the end of the
+        // pairs that are really on the line (the one that runs out goes in
+        // the way the stream would have left it, the ones after it were
+        // 0 0, a self loop, which a toggle leaves alone anyway)
+        int count;
+        tok.integer(count);
+        vector<pair<int,int>> pairs;
+        for (int k = 0; k < count; ++k) {
+            int a, b;
+            bool read = tok.integer(a);
+            read = tok.integer(b) && read;
+            pairs.emplace_back(a, b);
+            if (!read) break;
+        }
+        return putResult(out, g.toggleEdgesClosure(pairs));
+    }
+    default:
+        return runQueryKind(g, kind, tok, out);
+    }
+}
+
+// every public entry point times the line once (CommandTimer, CommandStats.h),
+// so a command is counted once whichever way it came in, and hands it to the
+// slow query log with the searches it ran (SlowQueryLog.h)
+
+void runQuery(const Graph& g, string_view line, OutputBuffer& out) {
+    CommandTimer timer;
+    SearchCapture searches;
+    CommandKind kind;
+    bool ok = queryLine(g, line, out, kind);
+    SlowQueryLog::global().note(g, line, kind, ok, timer.finish(kind, ok), searches);
+}
+
+void runCommand(Graph& g, string_view line, OutputBuffer& out) {
+    CommandTimer timer;
+    SearchCapture searches;
+    CommandKind kind;
+    bool ok = commandLine(g, line, out, kind);
+    SlowQueryLog::global().note(g, line, kind, ok, timer.finish(kind, ok), searches);
+}
+
+// against a GraphStore a mutation runs inside update (on a fresh copy,
+// published when it's done), a query on whatever version the reader has
+// (a mutation's time includes the copy, that's what the client waits for)
+
+static bool storeLine(GraphStore& store, GraphStore::Reader& reader, string_view line, OutputBuffer& out,
+                      CommandKind& kind) {
+    kind = CommandKind::Unknown;
+    bool ok = false;
+    if (changesGraph(line))
+        store.update([&](Graph& g) { ok = commandLine(g, line, out, kind); });
+    else
+        ok = queryLine(reader.get(), line, out, kind);
+    return ok;
+}
+
+void runCommand(GraphStore& store, GraphStore::Reader& reader, string_view line, OutputBuffer& out) {
+    CommandTimer timer;
+    SearchCapture searches;
+    CommandKind kind;
+    bool ok = storeLine(store, reader, line, out, kind);
+    SlowQueryLog::global().note(reader.get(), line, kind, ok, timer.finish(kind, ok), searches);
+}
+
+bool runUntimed(GraphStore& store, GraphStore::Reader& reader, string_view line, OutputBuffer& out) {
+    CommandKind kind;
+    return storeLine(store, reader, line, out, kind);
+}
+
+
+// reports... (the Graph does the work in parallel, we just print)
+
+bool printReport(const Graph& g, string_view kind, OutputBuffer& out) {
+    if (kind == "times") {
+        for (const StudentTimes& row : g.shortestTimesForAllStudents()) {
+            out.put("Name: ");
+            out.put(g.getStudentNameView(row.ufid));
+            out.put('\n');
+            for (const auto& [code, t] : row.times) {
+                out.put(code);
+                out.put(" | Total Time: ");
+                out.putInt(t);
+                out.put('\n');
+            }
+        }
+    } else if (kind == "zones") {
+        for (const StudentZoneCost& row : g.zoneCostForAllStudents()) {
+            out.put("Student Zone Cost For ");
+            out.put(g.getStudentNameView(row.ufid));
+            out.put(": ");
+            out.putInt(row.cost);
+            out.put('\n');
+        }
+    } else if (kind == "schedules") {
+        for (const StudentSchedule& row : g.verifyAllSchedules()) {
+            out.put("Name: ");
+            out.put(g.getStudentNameView(row.ufid));
+            out.put('\n');
+            for (const string& verdict : row.verdicts) {
+                out.put(verdict);
+                out.put('\n');
+            }
+        }
+    } else if (kind == "memory") {
+        MemoryUsage m = g.memoryUsage();
+        auto line = [&](const char* name, size_t value) {
+            out.put(name);
+            out.put(": ");
+            out.putInt(static_cast<long long>(value));
+            out.put('\n');
+        };
+        line("nodes", m.nodes);
+        line("edges", m.edges);
+        line("classes", m.classes);
+        line("students", m.students);
+        line("adjacency bytes", m.adjacency);
+        line("class map bytes", m.classMaps);
+        line("student record bytes", m.studentRecords);
+        line("student index bytes", m.studentIndex);
+        line("student name bytes", m.studentNames);
+        line("routing index bytes", m.routingIndex);
+        line("total bytes", m.total());
+        if (m.students)
+            line("bytes per student", (m.studentRecords + m.studentIndex + m.studentNames) / m.students);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+// batches...
+// lines are copied into one arena until a mutation (or the limit) comes,
+// then the pending run is cut into pieces, every piece writes into its own
+// buffer on the pool, and the buffers go out in order
+
+BatchRunner::BatchRunner(Graph& g, OutputBuffer& out, ThreadPool& pool, size_t maxPending)
+    : g(g), out(out), pool(pool), maxPending(maxPending) {}
+
+void BatchRunner::add(string_view line) {
+    if (changesGraph(line)) {
+        drain();
+        runCommand(g, line, out);
+        return;
+    }
+    if (readsHistory(line)) {
+        drain();
+        runQuery(g, line, out);
+        return;
+    }
+    pending.emplace_back(arena.size(), line.size());
+    arena.append(line.data(), line.size());
+    if (pending.size() >= maxPending) drain();
+}
+
+void BatchRunner::drain() {
+    if (pending.empty()) return;
+    auto lineAt = [&](size_t i) { return string_view(arena).substr(pending[i].first, pending[i].second); };
+    const Graph& reader = g;
+
+    // a short run isn't worth waking the workers for
+    if (pending.size() < MIN_PARALLEL || pool.concurrency() == 1) {
+        for (size_t i = 0; i < pending.size(); ++i) runQuery(reader, lineAt(i), out);
+    } else {
+        size_t pieces = min(pending.size(), pool.concurrency() * 4);
+        vector<string> results(pieces);
+        pool.parallelFor(pieces, [&](size_t p) {
+            size_t begin = pending.size() * p / pieces, end = pending.size() * (p + 1) / pieces;
+            OutputBuffer local(nullptr, 0);
+            for (size_t i = begin; i < end; ++i) runQuery(reader, lineAt(i), local);
+            results[p] = local.take();
+        });
+        for (const string& r : results) out.put(r);
+    }
+    pending.clear();
+    arena.clear();
+}
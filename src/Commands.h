@@ -0,0 +1,180 @@
+// Commands.h
+// the command loop of main.cpp, made fast enough to replay big traces
+//
+// input is read in big blocks and handed out as string_view lines,
+// a line is tokenized in place (no stringstream, no strings), the command
+// word is dispatched with a switch on its length, and everything printed
+// goes into one big output buffer (numbers through to_chars)
+//
+// the parsing rules are the ones the old `ss >> x` loop had:
+// words are split on whitespace, a number is an optional sign and digits
+// and stops at the first non-digit, and a failed read leaves 0 behind
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "Graph.h"
+#include "GraphStore.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+enum class CommandKind : uint8_t {
+    Insert,
+    Remove,
+    DropClass,
+    ReplaceClass,
+    RemoveClass,
+    ToggleEdgesClosure,
+    CheckEdgeStatus,
+    IsConnected,
+    PrintShortestEdges,
+    PrintStudentZone,
+    Stats,
+    SlowLog,
+    Explain,
+    Unknown,
+};
+
+// the command word -> kind, Unknown if it isn't one of ours
+// commandKindOfLine does the same for a whole line
+// isMutation: the commands that change the graph, everything else only reads
+CommandKind commandKindOf(string_view word);
+CommandKind commandKindOfLine(string_view line);
+bool isMutation(CommandKind kind);
+
+// the command word of a kind ("unknown" for Unknown), for reports
+// COMMAND_KINDS is how many kinds there are, Unknown included
+constexpr size_t COMMAND_KINDS = static_cast<size_t>(CommandKind::Unknown) + 1;
+const char* commandName(CommandKind kind);
+
+// CommandTokenizer walks one line, every token is a view into the line
+class CommandTokenizer {
+public:
+    explicit CommandTokenizer(string_view line) : rest(line) {}
+
+    // next whitespace separated word, false (and empty) at the end
+    bool word(string_view& out);
+
+    // like `ss >> n`: optional sign then digits, the rest stays for the next read
+    // on failure n is 0 and every later read fails too (the stream's failbit)
+    bool integer(int& n);
+
+    // insert's name: "quoted text" (up to the next quote) or a single word
+    bool name(string_view& out);
+
+    // whatever is left of the line, leading space skipped (explain's command)
+    string_view remaining();
+
+private:
+    void skipSpace();
+    string_view rest;
+    bool failed = false;
+};
+
+// OutputBuffer collects the output and writes it in big blocks
+// (and once more when it goes away)
+// with out == nullptr it just keeps everything, take() hands it over
+class OutputBuffer {
+public:
+    explicit OutputBuffer(FILE* out, size_t capacity = size_t(1) << 20);
+    ~OutputBuffer() { flush(); }
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void put(string_view text) {
+        buffer.append(text.data(), text.size());
+        if (out && buffer.size() >= capacity) flush();
+    }
+    void put(char c) {
+        buffer.push_back(c);
+        if (out && buffer.size() >= capacity) flush();
+    }
+    void putInt(long long value);
+    void flush();
+    string take() { string text; text.swap(buffer); return text; }
+    // appends everything to dst and empties the buffer (keeping its memory)
+    void moveTo(string& dst) { dst += buffer; buffer.clear(); }
+
+private:
+    FILE* out;
+    size_t capacity;
+    string buffer;
+};
+
+// InputReader hands out the lines of a stream, reading it in big blocks
+// a block is whatever the stream has ready, so typing commands by hand
+// still works; lineReady says whether the next line is already here
+// (main flushes its output before we might block for more)
+class InputReader {
+public:
+    explicit InputReader(FILE* in, size_t blockSize = size_t(1) << 20);
+
+    bool next(string_view& line);
+    bool lineReady() const;
+
+private:
+    bool fill();
+    FILE* in;
+    size_t blockSize;
+    string buffer;
+    size_t pos = 0;
+    bool eof = false;
+};
+
+// reads the command count like `cin >> n` followed by getline:
+// blank lines are skipped, the rest of the count's line is dropped,
+// 0 if there is no number
+int readCommandCount(InputReader& input);
+
+// runs one line against the graph and writes its output
+// runQuery is the read-only half, a mutation sent there prints "unsuccessful"
+void runCommand(Graph& g, string_view line, OutputBuffer& out);
+void runQuery(const Graph& g, string_view line, OutputBuffer& out);
+
+// the same against a GraphStore (GraphStore.h): mutations publish a new
+// version, queries read the reader's version and never wait for a writer
+void runCommand(GraphStore& store, GraphStore::Reader& reader, string_view line, OutputBuffer& out);
+// and without the timing (stats, slow log) for a caller that times the
+// request itself (the binary channel), false if the command failed
+bool runUntimed(GraphStore& store, GraphStore::Reader& reader, string_view line, OutputBuffer& out);
+
+// printShortestEdges / printStudentZone for one student, exactly as printed
+void putShortestEdges(const Graph& g, UFIDKey ufid, OutputBuffer& out);
+void putStudentZone(const Graph& g, UFIDKey ufid, OutputBuffer& out);
+
+// the --report=KIND output of main.cpp, every student in UFID order
+// "times" prints what printShortestEdges would, "zones" what printStudentZone
+// would, "schedules" the verifySchedule verdicts under each name, "memory"
+// the Graph's memoryUsage (and the registry's bytes per student)
+// false (and nothing printed) for any other kind
+bool printReport(const Graph& g, string_view kind, OutputBuffer& out);
+
+// BatchRunner is the --batch mode of main.cpp
+// read-only commands are held back until the next mutation (or until
+// maxPending pile up), then that whole run is spread over the pool;
+// every piece writes to its own buffer and they are copied out in input
+// order, so the output is exactly what running them one by one gives
+// a mutation always runs alone, after everything before it, and so do
+// stats and slowlog (and explain around either), which report on those
+class BatchRunner {
+public:
+    static constexpr size_t MIN_PARALLEL = 32;
+
+    BatchRunner(Graph& g, OutputBuffer& out, ThreadPool& pool, size_t maxPending = size_t(1) << 16);
+    ~BatchRunner() { drain(); }
+
+    void add(string_view line); // the line is copied
+    void drain();               // run everything pending now
+
+private:
+    Graph& g;
+    OutputBuffer& out;
+    ThreadPool& pool;
+    size_t maxPending;
+    string arena;                          // the pending lines, back to back
+    vector<pair<size_t, size_t>> pending;  // (offset, length) into arena
+};
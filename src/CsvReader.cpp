@@ -0,0 +1,100 @@
+#include "CsvReader.h"
+#include <charconv>
+#include <fstream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CSV_READER_HAS_MMAP 1
+#endif
+
+MappedFile::~MappedFile() { close(); }
+
+// map the file, or read it into buffer when we can't
+// an empty file is fine, it's just zero lines
+bool MappedFile::open(const string& path) {
+    close();
+#ifdef CSV_READER_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0) {
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) { ::close(fd); length = 0; return false; }
+        madvise(p, length, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(p);
+        mapped = true;
+    }
+    ::close(fd); // the mapping stays valid after close
+#else
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) return false;
+    stringstream ss;
+    ss << file.rdbuf();
+    buffer = ss.str();
+    data = buffer.data();
+    length = buffer.size();
+#endif
+    opened = true;
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef CSV_READER_HAS_MMAP
+    if (mapped) munmap(const_cast<char*>(data), length);
+#endif
+    data = nullptr;
+    length = 0;
+    opened = false;
+    mapped = false;
+    buffer.clear();
+}
+
+size_t splitCsvFields(string_view line, string_view* fields, size_t maxFields, bool lastTakesRest) {
+    size_t count = 0;
+    while (count < maxFields) {
+        size_t comma = (lastTakesRest && count + 1 == maxFields) ? string_view::npos : line.find(',');
+        fields[count++] = line.substr(0, comma);
+        if (comma == string_view::npos) break;
+        line.remove_prefix(comma + 1);
+    }
+    return count;
+}
+
+string_view trimField(string_view field) {
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) field.remove_prefix(1);
+    while (!field.empty() && (field.back() == ' ' || field.back() == '\t')) field.remove_suffix(1);
+    return field;
+}
+
+bool parseIntField(string_view field, int& out) {
+    field = trimField(field);
+    if (!field.empty() && field.front() == '+') {
+        field.remove_prefix(1);
+        if (!field.empty() && field.front() == '-') return false;
+    }
+    if (field.empty()) return false;
+    auto res = from_chars(field.data(), field.data() + field.size(), out);
+    return res.ec == errc() && res.ptr == field.data() + field.size();
+}
+
+vector<string_view> splitLineChunks(string_view text, size_t chunks) {
+    vector<string_view> out;
+    if (chunks == 0) chunks = 1;
+    size_t target = text.size() / chunks + 1;
+    while (!text.empty()) {
+        size_t cut = text.size();
+        if (target < text.size()) {
+            size_t nl = text.find('\n', target);
+            if (nl != string_view::npos) cut = nl + 1;
+        }
+        out.push_back(text.substr(0, cut));
+        text.remove_prefix(cut);
+    }
+    return out;
+}
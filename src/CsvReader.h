@@ -0,0 +1,77 @@
+// CsvReader.h
+// fast helpers for the CSV loaders in Graph.cpp
+// the whole file is mapped into memory (mmap) and we walk it with string_views,
+// no getline / stringstream / stoi, and no exceptions on the way
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// MappedFile maps a file read-only for as long as it lives
+// on systems without mmap we just read the file into a buffer
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const string& path) { open(path); }
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const string& path);
+    void close();
+    bool isOpen() const { return opened; }
+    string_view contents() const { return string_view(data, length); }
+
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+    bool opened = false;
+    bool mapped = false;  // false -> data points into buffer
+    string buffer;
+};
+
+// one malformed row, line numbers start at 1 (the header is line 1)
+struct CsvError {
+    size_t line = 0;
+    string message;
+};
+
+// LineCursor hands out the lines of a buffer one at a time
+// trailing '\r' is dropped so Windows files work too
+class LineCursor {
+public:
+    explicit LineCursor(string_view text) : rest(text) {}
+
+    bool next(string_view& line) {
+        if (rest.empty()) return false;
+        size_t nl = rest.find('\n');
+        line = rest.substr(0, nl);
+        rest = nl == string_view::npos ? string_view() : rest.substr(nl + 1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        ++number;
+        return true;
+    }
+    size_t lineNumber() const { return number; }
+
+private:
+    string_view rest;
+    size_t number = 0;
+};
+
+// splits line on ',' into at most maxFields fields
+// when lastTakesRest is true the last field gets the rest of the line, commas and all
+// returns how many fields were found
+size_t splitCsvFields(string_view line, string_view* fields, size_t maxFields, bool lastTakesRest);
+
+// strips spaces/tabs at both ends
+string_view trimField(string_view field);
+
+// parses a whole (trimmed) field as an int, false if anything is left over
+bool parseIntField(string_view field, int& out);
+
+// cuts text into about `chunks` pieces, every cut is right after a '\n'
+// so each piece is whole lines (pieces can be empty for tiny inputs)
+vector<string_view> splitLineChunks(string_view text, size_t chunks);
@@ -0,0 +1,266 @@
+// FlatHashMap.h
+// a small open-addressing hash table in the "Swiss table" style
+// used for the student and class registries in Graph (keys are the packed ids)
+//
+// layout: one control byte per slot + one flat array of (key, value) slots
+// control byte = EMPTY, DELETED, or the low 7 bits of the hash (h2) when full
+// we probe 16 slots at a time: one SSE2 compare finds every slot in the group
+// whose h2 matches, so most lookups touch one group and one slot
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLAT_HASH_MAP_SSE2 1
+#endif
+
+using namespace std;
+
+// mixes a packed id into 64 bits, the ids are dense so we can't use them raw
+inline uint64_t mixHashKey(uint64_t x) {
+    x *= 0x9E3779B97F4A7C15ull;
+    return x ^ (x >> 29);
+}
+
+// Traits must provide:
+//   static uint64_t hash(Key)
+// and optionally, for lookups straight from input text:
+//   static Key fromText(string_view)   and   static constexpr Key INVALID
+template <typename Key, typename Value, typename Traits>
+class FlatHashMap {
+public:
+    using value_type = pair<Key, Value>;
+    static constexpr size_t GROUP_WIDTH = 16;
+
+private:
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+    static constexpr size_t NPOS = static_cast<size_t>(-1);
+
+    // one 16 wide group of control bytes
+    // every match returns a bitmask, bit i = slot i of the group
+    struct Group {
+#ifdef FLAT_HASH_MAP_SSE2
+        __m128i ctrl;
+        explicit Group(const int8_t* p) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+        uint32_t match(int8_t h2) const {
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+        }
+        uint32_t matchEmpty() const { return match(EMPTY); }
+        // EMPTY and DELETED are the only negative control bytes
+        uint32_t matchFree() const { return static_cast<uint32_t>(_mm_movemask_epi8(ctrl)); }
+#else
+        const int8_t* ctrl;
+        explicit Group(const int8_t* p) : ctrl(p) {}
+        uint32_t match(int8_t h2) const {
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP_WIDTH; ++i) if (ctrl[i] == h2) mask |= 1u << i;
+            return mask;
+        }
+        uint32_t matchEmpty() const { return match(EMPTY); }
+        uint32_t matchFree() const {
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP_WIDTH; ++i) if (ctrl[i] < 0) mask |= 1u << i;
+            return mask;
+        }
+#endif
+    };
+
+    static size_t lowestBit(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<size_t>(__builtin_ctz(mask));
+#else
+        size_t i = 0;
+        while (!(mask & 1u)) { mask >>= 1; ++i; }
+        return i;
+#endif
+    }
+
+public:
+    // iterators just walk the slot array and skip the non-full ones
+    template <bool IsConst>
+    class Iter {
+        using Map = typename conditional<IsConst, const FlatHashMap, FlatHashMap>::type;
+        using Ref = typename conditional<IsConst, const value_type&, value_type&>::type;
+        using Ptr = typename conditional<IsConst, const value_type*, value_type*>::type;
+    public:
+        Iter() = default;
+        Iter(Map* map, size_t index) : map(map), index(index) { skip(); }
+        template <bool C = IsConst, typename = typename enable_if<C>::type>
+        Iter(const Iter<false>& other) : map(other.map), index(other.index) {}
+
+        Ref operator*() const { return map->slots[index]; }
+        Ptr operator->() const { return &map->slots[index]; }
+        Iter& operator++() { ++index; skip(); return *this; }
+        bool operator==(const Iter& other) const { return index == other.index; }
+        bool operator!=(const Iter& other) const { return index != other.index; }
+
+    private:
+        friend class FlatHashMap;
+        template <bool> friend class Iter;
+        void skip() { while (index < map->ctrl.size() && map->ctrl[index] < 0) ++index; }
+        Map* map = nullptr;
+        size_t index = 0;
+    };
+
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    FlatHashMap() = default;
+
+    size_t size() const { return filled; }
+    bool empty() const { return filled == 0; }
+    size_t capacity() const { return ctrl.size(); }
+    // what the table itself holds on the heap (not what the values point to)
+    size_t memoryBytes() const { return ctrl.capacity() + slots.capacity() * sizeof(value_type); }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, ctrl.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, ctrl.size()); }
+
+    iterator find(Key key) {
+        size_t i = findIndex(key);
+        return i == NPOS ? end() : iterator(this, i);
+    }
+    const_iterator find(Key key) const {
+        size_t i = findIndex(key);
+        return i == NPOS ? end() : const_iterator(this, i);
+    }
+
+    // heterogeneous lookup: encode the text and probe, no string is built
+    template <typename T = Traits>
+    auto find(string_view text) -> decltype(T::fromText(text), iterator()) {
+        Key key = Traits::fromText(text);
+        return key == Traits::INVALID ? end() : find(key);
+    }
+    template <typename T = Traits>
+    auto find(string_view text) const -> decltype(T::fromText(text), const_iterator()) {
+        Key key = Traits::fromText(text);
+        return key == Traits::INVALID ? end() : find(key);
+    }
+
+    bool contains(Key key) const { return findIndex(key) != NPOS; }
+    size_t count(Key key) const { return contains(key) ? 1 : 0; }
+
+    // insert (key, value) unless key is already there
+    pair<iterator,bool> insert(Key key, Value value) {
+        size_t i = findIndex(key);
+        if (i != NPOS) return {iterator(this, i), false};
+        i = insertNew(key);
+        slots[i].second = std::move(value);
+        return {iterator(this, i), true};
+    }
+
+    Value& operator[](Key key) {
+        size_t i = findIndex(key);
+        if (i == NPOS) i = insertNew(key);
+        return slots[i].second;
+    }
+
+    size_t erase(Key key) {
+        size_t i = findIndex(key);
+        if (i == NPOS) return 0;
+        eraseIndex(i);
+        return 1;
+    }
+
+    // erasing leaves a tombstone, nothing moves, so other iterators stay valid
+    void erase(iterator it) { eraseIndex(it.index); }
+
+    void clear() {
+        ctrl.assign(ctrl.size(), EMPTY);
+        slots.assign(slots.size(), value_type());
+        filled = 0;
+        deleted = 0;
+    }
+
+    // make room for n entries without rehashing
+    void reserve(size_t n) {
+        size_t cap = GROUP_WIDTH;
+        while (cap * 7 / 8 < n) cap *= 2;
+        if (cap > ctrl.size()) rehash(cap);
+    }
+
+private:
+    vector<int8_t> ctrl;       // one control byte per slot
+    vector<value_type> slots;  // the entries themselves
+    size_t filled = 0;
+    size_t deleted = 0;
+
+    size_t groupMask() const { return ctrl.size() / GROUP_WIDTH - 1; }
+
+    // we walk groups in triangular steps (1, 2, 3, ...), which visits every
+    // group once because the group count is a power of two
+    size_t findIndex(Key key) const {
+        if (ctrl.empty()) return NPOS;
+        uint64_t h = Traits::hash(key);
+        int8_t h2 = static_cast<int8_t>(h & 0x7F);
+        size_t mask = groupMask();
+        size_t g = static_cast<size_t>(h >> 7) & mask;
+        for (size_t step = 1; step <= mask + 1; ++step) {
+            Group group(&ctrl[g * GROUP_WIDTH]);
+            for (uint32_t m = group.match(h2); m; m &= m - 1) {
+                size_t i = g * GROUP_WIDTH + lowestBit(m);
+                if (slots[i].first == key) return i;
+            }
+            if (group.matchEmpty()) return NPOS;
+            g = (g + step) & mask;
+        }
+        return NPOS;
+    }
+
+    size_t findFree(uint64_t h) const {
+        size_t mask = groupMask();
+        size_t g = static_cast<size_t>(h >> 7) & mask;
+        for (size_t step = 1;; ++step) {
+            uint32_t m = Group(&ctrl[g * GROUP_WIDTH]).matchFree();
+            if (m) return g * GROUP_WIDTH + lowestBit(m);
+            g = (g + step) & mask;
+        }
+    }
+
+    // key is known to be missing here
+    size_t insertNew(Key key) {
+        // keep at least 1/8 of the slots EMPTY so failed lookups stop early
+        if (ctrl.empty() || (filled + deleted + 1) > ctrl.size() * 7 / 8) {
+            size_t cap = ctrl.empty() ? GROUP_WIDTH : ctrl.size();
+            if ((filled + 1) * 2 > cap) cap *= 2; // otherwise it's just tombstones, rehash in place
+            rehash(cap);
+        }
+        uint64_t h = Traits::hash(key);
+        size_t i = findFree(h);
+        if (ctrl[i] == DELETED) --deleted;
+        ctrl[i] = static_cast<int8_t>(h & 0x7F);
+        slots[i].first = key;
+        ++filled;
+        return i;
+    }
+
+    void eraseIndex(size_t i) {
+        ctrl[i] = DELETED;
+        slots[i] = value_type(); // let go of anything the value owns
+        --filled;
+        ++deleted;
+    }
+
+    void rehash(size_t newCapacity) {
+        vector<int8_t> oldCtrl(newCapacity, EMPTY);
+        vector<value_type> oldSlots(newCapacity);
+        oldCtrl.swap(ctrl);
+        oldSlots.swap(slots);
+        deleted = 0;
+        for (size_t i = 0; i < oldCtrl.size(); ++i) {
+            if (oldCtrl[i] < 0) continue;
+            uint64_t h = Traits::hash(oldSlots[i].first);
+            size_t j = findFree(h);
+            ctrl[j] = static_cast<int8_t>(h & 0x7F);
+            slots[j] = std::move(oldSlots[i]);
+        }
+    }
+};
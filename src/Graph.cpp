@@ -1,56 +1,137 @@
 #include "Graph.h"
 #include "student.h"
-#include <fstream>
-#include <sstream>
+#include "CsvReader.h"
+#include "ThreadPool.h"
+#include "Snapshot.h"
+#include "TimedRegions.h"
 #include <queue>
 #include <limits>
 #include <algorithm>
 #include <iostream>
+#include <tuple>
 
 using namespace std;
 
 
+// parse the edge rows of one chunk into edges (no graph changes here)
+// error line numbers are relative to the chunk, the caller shifts them
+// returns how many lines the chunk had
+
+static size_t parseEdgeRows(string_view text, vector<EdgeInfo>& edges, vector<CsvError>& errors) {
+    LineCursor lines(text);
+    string_view line;
+    string_view fields[5];
+    while (lines.next(line)) {
+        if (line.empty()) continue;
+
+        // like the old getline version, time is everything after the 4th comma
+        if (splitCsvFields(line, fields, 5, true) < 5) {
+            errors.push_back({lines.lineNumber(), "expected 5 fields"});
+            continue;
+        }
+
+        // we just skip a row whose numbers don't parse...
+        int loc1, loc2, travelTime;
+        if (!parseIntField(fields[0], loc1) || !parseIntField(fields[1], loc2) ||
+            !parseIntField(fields[4], travelTime)) {
+            errors.push_back({lines.lineNumber(), "bad location id or travel time"});
+            continue;
+        }
+        edges.emplace_back(loc1, loc2, travelTime);
+    }
+    return lines.lineNumber();
+}
+
 // load edges from CSV file
-// each row = u,v, time
+// each row = u,v,name1,name2,time
 // build adjacency list
 // return false if file cannot be opened or read 
+// the file is mapped and parsed in place (CsvReader.h), a bad row is
+// skipped and remembered in loadErrors with its line number
+// a big file is cut into line aligned chunks that are parsed in parallel,
+// then addEdgesBulk builds the adjacency in one go
 
 bool Graph::loadEdgesCSV(const string& filepath) {
-    ifstream file(filepath);
-    if (!file.is_open()) return false;
+    TIMED_REGION("loadEdgesCSV");
+    loadErrors.clear();
+    MappedFile file;
+    if (!file.open(filepath)) return false;
+    writable(topology).edgesFingerprint = fingerprintBytes(file.contents());
+
+    // this is for debugging... skip the header maybe...
+    string_view body = file.contents();
+    size_t headerEnd = body.find('\n');
+    body.remove_prefix(headerEnd == string_view::npos ? body.size() : headerEnd + 1);
+
+    ThreadPool& pool = ThreadPool::shared();
+    size_t chunkCount = body.size() < parallelLoadThreshold ? 1 : pool.concurrency() * 4;
+    vector<string_view> chunks = splitLineChunks(body, chunkCount);
+
+    vector<vector<EdgeInfo>> edges(chunks.size());
+    vector<vector<CsvError>> errors(chunks.size());
+    vector<size_t> lineCounts(chunks.size());
+    pool.parallelFor(chunks.size(), [&](size_t c) {
+        lineCounts[c] = parseEdgeRows(chunks[c], edges[c], errors[c]);
+    });
+
+    // chunk c starts after the header and every line of the chunks before it
+    size_t firstLine = 1;
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        for (CsvError& err : errors[c]) {
+            err.line += firstLine;
+            loadErrors.push_back(std::move(err));
+        }
+        firstLine += lineCounts[c];
+    }
 
-    string line;
-    getline(file, line); // this is for debugging... skip the header maybe...
+    addEdgesBulk(edges);
+    return true;
+}
 
-    while (getline(file, line)) {
-        if (line.empty()) continue;
-        stringstream ss(line);
-        string loc1Str, loc2Str, name1, name2, travelTimeStr;
-
-        if (!getline(ss, loc1Str, ',')) continue;
-        if (!getline(ss, loc2Str, ',')) continue;
-        if (!getline(ss, name1, ',')) continue;
-        if (!getline(ss, name2, ',')) continue;
-       
-
-        if (!getline(ss, travelTimeStr)) continue;
-
-        // the try catch here is to avoid invalid stoi conversion...
-        // if any conversion fails, we just skip that line
-        try {
-            int loc1 = stoi(loc1Str);
-            int loc2 = stoi(loc2Str);
-            int travelTime = stoi(travelTimeStr);
-            if (adjList.find(loc1) == adjList.end()) adjList[loc1] = {};
-            if (adjList.find(loc2) == adjList.end()) adjList[loc2] = {};
-            addEdge(loc1, loc2, travelTime);
-        } catch (...) {
-            continue;
+// addEdgesBulk does what calling addEdge on every edge (in order) would do,
+// but like a counting sort: count each node's new degree, reserve exactly,
+// then fill. the fill is split by node, each thread owns the nodes that
+// hash to it and appends only to those, walking the edges in file order,
+// so every adjacency list comes out in the same order as with addEdge
+// (and every edge gets the link addEdge would have given it)
+
+void Graph::addEdgesBulk(const vector<vector<EdgeInfo>>& chunks) {
+    Topology& topo = writable(topology);
+    auto& adjList = topo.adjList;
+    unordered_map<int, size_t> degree;
+    vector<uint32_t> firstLink(chunks.size());
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        const auto& chunk = chunks[c];
+        firstLink[c] = static_cast<uint32_t>(topo.edgeCount / 2);
+        for (const auto& e : chunk) {
+            if (degree[e.startNodeId]++ == 0) adjList[e.startNodeId];
+            if (degree[e.endNodeId]++ == 0) adjList[e.endNodeId];
         }
+        topo.edgeCount += chunk.size() * 2;
+    }
+    for (const auto& kv : degree) {
+        vector<Edge>& list = adjList[kv.first];
+        list.reserve(list.size() + kv.second);
     }
 
-    file.close();
-    return true;
+    ThreadPool& pool = ThreadPool::shared();
+    size_t owners = degree.size() < 4096 ? 1 : pool.concurrency();
+    auto ownerOf = [owners](int node) {
+        return static_cast<size_t>((static_cast<uint32_t>(node) * 2654435761u) >> 8) % owners;
+    };
+    // only find() on adjList here, the map itself doesn't change
+    pool.parallelFor(owners, [&](size_t t) {
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            uint32_t link = firstLink[c];
+            for (const auto& e : chunks[c]) {
+                if (ownerOf(e.startNodeId) == t)
+                    adjList.find(e.startNodeId)->second.push_back(Edge(e.endNodeId, e.weight, link));
+                if (ownerOf(e.endNodeId) == t)
+                    adjList.find(e.endNodeId)->second.push_back(Edge(e.startNodeId, e.weight, link));
+                ++link;
+            }
+        }
+    });
 }
 
 
@@ -61,78 +142,104 @@ bool Graph::loadEdgesCSV(const string& filepath) {
 // because we need to store class info too
 
 bool Graph::loadClassesCSV(const string& filepath) {
-    ifstream file(filepath);
-    if (!file.is_open()) return false;
-
-    string line;
-    getline(file, line); // skip header line like the previous function
-    while (getline(file, line)) {
+    loadErrors.clear();
+    MappedFile file;
+    if (!file.open(filepath)) return false;
+    ClassTable& table = writable(classes);
+    table.classesFingerprint = fingerprintBytes(file.contents());
+
+    LineCursor lines(file.contents());
+    string_view line;
+    lines.next(line); // skip header line like the previous function
+
+    string_view fields[4];
+    while (lines.next(line)) {
         if (line.empty()) continue;
-        stringstream ss(line);
-        string classCode, locStr, startTime, endTime;
-
-        if (!getline(ss, classCode, ',')) continue;
-        if (!getline(ss, locStr, ',')) continue;
-        if (!getline(ss, startTime, ',')) continue;
-        if (!getline(ss, endTime, ',')) continue;
-
-        try {
-            int locationId = stoi(locStr);
-            classToLocation[classCode] = locationId;
-            ClassInfo info;
-            info.locationId = locationId;
-            info.startTime = startTime;
-            info.endTime = endTime;
-            classInfoMap[classCode] = info;
-            if (adjList.find(locationId) == adjList.end()) adjList[locationId] = {};
-        } catch (...) {
+        if (splitCsvFields(line, fields, 4, false) < 4) {
+            loadErrors.push_back({lines.lineNumber(), "expected 4 fields"});
             continue;
         }
-    }
 
-    file.close();
+        // class codes are stored packed, so a row with a bad code is skipped
+        ClassId id = encodeClassCode(fields[0]);
+        if (id == INVALID_CLASS_ID) {
+            loadErrors.push_back({lines.lineNumber(), "bad class code"});
+            continue;
+        }
+
+        int locationId;
+        if (!parseIntField(fields[1], locationId)) {
+            loadErrors.push_back({lines.lineNumber(), "bad location id"});
+            continue;
+        }
+        table.classToLocation[id] = locationId;
+        ClassInfo info;
+        info.locationId = locationId;
+        info.startTime = string(fields[2]);
+        info.endTime = string(fields[3]);
+        table.classInfoMap[id] = std::move(info);
+        if (topology->adjList.find(locationId) == topology->adjList.end()) writable(topology).adjList[locationId] = {};
+    }
     return true;
 }
 
 
 // again getclasslocation returns locationid for classcode
 // it here is -1 if DNE...
-int Graph::getClassLocation(const string& classCode) const {
-    auto it = classToLocation.find(classCode);
-    return it != classToLocation.end() ? it->second : -1;
+int Graph::getClassLocation(string_view classCode) const {
+    auto it = classes->classToLocation.find(classCode);
+    return it != classes->classToLocation.end() ? it->second : -1;
+}
+
+int Graph::getClassLocationById(ClassId id) const {
+    auto it = classes->classToLocation.find(id);
+    return it != classes->classToLocation.end() ? it->second : -1;
 }
 // getclassinfo returns stored classinfo for classcode
 
-ClassInfo Graph::getClassInfo(const string& classCode) const {
-    auto it = classInfoMap.find(classCode);
-    return it != classInfoMap.end() ? it->second : ClassInfo();
+ClassInfo Graph::getClassInfo(string_view classCode) const {
+    auto it = classes->classInfoMap.find(classCode);
+    return it != classes->classInfoMap.end() ? it->second : ClassInfo();
 }
 // the set function sets/updates classinfo for classcode
 // we've explained all these in the header file.
-void Graph::setClassInfo(const std::string& classCode, const ClassInfo& info) {
-    classInfoMap[classCode] = info;
-    classToLocation[classCode] = info.locationId;
+void Graph::setClassInfo(string_view classCode, const ClassInfo& info) {
+    ClassId id = encodeClassCode(classCode);
+    if (id == INVALID_CLASS_ID) return;
+    ClassTable& table = writable(classes);
+    table.classInfoMap[id] = info;
+    table.classToLocation[id] = info.locationId;
 }
 
 // insert edge into the adjacency list
 // we assume undirected graph here for travel time between two locations
 void Graph::addEdge(int loc1, int loc2, int travelTime) {
+    Topology& topo = writable(topology);
+    auto& adjList = topo.adjList;
     if (adjList.find(loc1) == adjList.end()) adjList[loc1] = {};
     if (adjList.find(loc2) == adjList.end()) adjList[loc2] = {};
-    adjList[loc1].push_back(Edge(loc2, travelTime, true));
-    adjList[loc2].push_back(Edge(loc1, travelTime, true));
+    uint32_t link = static_cast<uint32_t>(topo.edgeCount / 2);
+    adjList[loc1].push_back(Edge(loc2, travelTime, link));
+    adjList[loc2].push_back(Edge(loc1, travelTime, link));
+    topo.edgeCount += 2;
 }
 
 // toggle edges between open/closed
 // be careful.. we need to return false immediately if any edge DNE
+// (the closures are only made writable once there is something to flip,
+// the adjacency lists are never touched)
 bool Graph::toggleEdgesClosure(const vector<pair<int,int>>& edges) {
+    Closures* shut = nullptr;
     for (const auto& p : edges) {
         int u = p.first, v = p.second;
-        Edge* e1 = findEdge(u, v);
-        Edge* e2 = findEdge(v, u);
-        if (!e1 || !e2) return false; // fail immediately
-        e1->isOpen = !e1->isOpen;
-        e2->isOpen = !e2->isOpen;
+        const Edge* e1 = findEdgeConst(u, v);
+        if (!e1 || !findEdgeConst(v, u)) return false; // fail immediately
+        if (!shut) {
+            shut = &writable(closures);
+            ++shut->epoch;
+        }
+        // both directions share the link; a self loop was always flipped twice
+        if (u != v) shut->flip(e1->link);
     }
     return true;
 }
@@ -141,25 +248,122 @@ bool Graph::toggleEdgesClosure(const vector<pair<int,int>>& edges) {
 string Graph::checkEdgeStatus(int loc1, int loc2) const {
     const Edge* edge = findEdgeConst(loc1, loc2);
     if (!edge) return "DNE";
-    return edge->isOpen ? "open" : "closed";
+    return closures->isOpen(*edge) ? "open" : "closed";
+}
+
+// the searches' working memory...
+// every thread keeps one SearchScratch and reuses it: a node table (node id
+// -> slot, open addressing, emptied by bumping an epoch like the bulk
+// reports' DijkstraWorkspace) and the heap, queue, path and subgraph vectors.
+// once they've grown to the graph a search allocates nothing
+
+namespace {
+class NodeTable {
+public:
+    static constexpr uint32_t NONE = numeric_limits<uint32_t>::max();
+
+    // empty, with room for a search over `nodes` nodes (at most half full)
+    void start(size_t nodes) {
+        size_t want = 16;
+        while (want < nodes * 2) want <<= 1;
+        if (keys.size() < want) {
+            keys.resize(want);
+            dist.resize(want);
+            parent.resize(want);
+            stamp.assign(want, 0);
+            epoch = 0;
+        }
+        mask = keys.size() - 1;
+        if (++epoch == 0) { // wrapped, old stamps could look current
+            fill(stamp.begin(), stamp.end(), 0);
+            epoch = 1;
+        }
+    }
+
+    // the slot of id, NONE if the search hasn't touched it
+    uint32_t find(int id) const {
+        for (size_t h = hash(id);; h = (h + 1) & mask) {
+            if (stamp[h] != epoch) return NONE;
+            if (keys[h] == id) return static_cast<uint32_t>(h);
+        }
+    }
+    // the slot of id, a new one (dist INF, no parent) if it wasn't touched yet
+    uint32_t add(int id) {
+        size_t h = hash(id);
+        for (; stamp[h] == epoch; h = (h + 1) & mask)
+            if (keys[h] == id) return static_cast<uint32_t>(h);
+        stamp[h] = epoch;
+        keys[h] = id;
+        dist[h] = numeric_limits<int>::max();
+        parent[h] = NONE;
+        return static_cast<uint32_t>(h);
+    }
+
+    vector<int> keys;
+    vector<int> dist;
+    vector<uint32_t> parent;
+
+private:
+    size_t hash(int id) const { return (static_cast<uint32_t>(id) * 2654435761u) & mask; }
+    vector<uint32_t> stamp;
+    size_t mask = 0;
+    uint32_t epoch = 0;
+};
+
+struct SearchScratch {
+    NodeTable nodes;
+    vector<pair<int,int>> heap; // dijkstra's (cost, node)
+    vector<int> queue;          // isConnected's
+    vector<int> path, vertices; // a zone's
+    vector<EdgeInfo> edges;
+    // computeMSTCost's: the subgraph by vertex index, and Prim's state
+    vector<uint32_t> offsets, cursor;
+    vector<pair<uint32_t,int>> links;
+    vector<int> best;
+    vector<char> inTree;
+};
+
+SearchScratch& scratch() {
+    thread_local SearchScratch s;
+    return s;
 }
 
+// v's index in the sorted vertices, NONE if it isn't one
+uint32_t vertexIndex(const vector<int>& vertices, int v) {
+    auto it = lower_bound(vertices.begin(), vertices.end(), v);
+    return it != vertices.end() && *it == v ? static_cast<uint32_t>(it - vertices.begin()) : NodeTable::NONE;
+}
+} // namespace
+
 
 // we need to do a simple BFS to test connectivity using only open edges
-bool Graph::isConnected(int src, int dst) const {
+// (the queue is the "heap" in the stats, nothing is ever stale in a BFS)
+bool Graph::isConnected(int src, int dst, SearchStats* stats) const {
+    SearchScope scope(SearchKind::Connectivity, stats);
+    SearchStats& counts = scope.counts;
+    const auto& adjList = topology->adjList;
+    const Closures& shut = *closures;
     if (adjList.find(src) == adjList.end() || adjList.find(dst) == adjList.end()) return false;
-    unordered_set<int> visited;
-    queue<int> q;
-    q.push(src);
-    visited.insert(src);
-    while (!q.empty()) {
-        int cur = q.front(); q.pop();
+    SearchScratch& s = scratch();
+    NodeTable& visited = s.nodes;
+    visited.start(adjList.size());
+    vector<int>& q = s.queue;
+    q.clear();
+    q.push_back(src);
+    ++counts.heapPushes;
+    visited.add(src);
+    for (size_t head = 0; head < q.size(); ++head) {
+        int cur = q[head];
+        ++counts.heapPops;
+        ++counts.nodesSettled;
         if (cur == dst) return true;
         for (const auto& e : adjList.at(cur)) {
-            if (!e.isOpen) continue;
-            if (visited.find(e.destination) == visited.end()) {
-                visited.insert(e.destination);
-                q.push(e.destination);
+            if (!shut.isOpen(e)) continue;
+            ++counts.edgesRelaxed;
+            if (visited.find(e.destination) == NodeTable::NONE) {
+                visited.add(e.destination);
+                q.push_back(e.destination);
+                ++counts.heapPushes;
             }
         }
     }
@@ -168,54 +372,71 @@ bool Graph::isConnected(int src, int dst) const {
 
 // We love dijkstra...
 // if startnode or endnode DNE, return totalcost -1 /no path...
-// remember the step.. initialize infinity distance for every reachable node...
-// then use a min heap...
+// remember the step.. a node nobody reached yet is at infinity...
+// then use a min heap (cost, then node id, like a priority_queue of pairs)...
 // finally build the path and return the result...
 
-PathResult Graph::dijkstra(int src, int dst) const {
+PathResult Graph::dijkstra(int src, int dst, SearchStats* stats) const {
     PathResult result;
-    result.totalCost = -1;
-    if (adjList.find(src) == adjList.end()) return result;
-
-    const int INF = numeric_limits<int>::max();
-    unordered_map<int,int> dist;
-    unordered_map<int,int> parent;
-
-    for (const auto& kv : adjList) {
-        dist[kv.first] = INF;
-        for (const auto& e : kv.second) if (dist.find(e.destination) == dist.end()) dist[e.destination] = INF;
-    }
-
-    if (dist.find(dst) == dist.end()) return result;
+    dijkstra(src, dst, result, stats);
+    return result;
+}
 
-    dist[src] = 0;
-    priority_queue<pair<int,int>, vector<pair<int,int>>, greater<pair<int,int>>> pq;
-    pq.push({0, src});
+void Graph::dijkstra(int src, int dst, PathResult& result, SearchStats* stats) const {
+    SearchScope scope(SearchKind::Dijkstra, stats);
+    result.totalCost = dijkstraSearch(src, dst, scope.counts, &result.path);
+}
 
-    while (!pq.empty()) {
-        auto [dcur, node] = pq.top(); pq.pop();
-        if (dcur > dist[node]) continue;
-        if (node == dst) break;
+int Graph::dijkstraSearch(int src, int dst, SearchStats& counts, vector<int>* path) const {
+    TIMED_REGION("dijkstra");
+    const auto& adjList = topology->adjList;
+    const Closures& shut = *closures;
+    if (path) path->clear();
+    if (adjList.find(src) == adjList.end() || adjList.find(dst) == adjList.end()) return -1;
+
+    SearchScratch& s = scratch();
+    NodeTable& nodes = s.nodes;
+    nodes.start(adjList.size());
+    auto& heap = s.heap;
+    heap.clear();
+    auto later = greater<pair<int,int>>();
+    nodes.dist[nodes.add(src)] = 0;
+    heap.emplace_back(0, src);
+    ++counts.heapPushes;
+
+    uint32_t reached = NodeTable::NONE;
+    while (!heap.empty()) {
+        pop_heap(heap.begin(), heap.end(), later);
+        auto [dcur, node] = heap.back();
+        heap.pop_back();
+        ++counts.heapPops;
+        uint32_t at = nodes.find(node);
+        if (dcur > nodes.dist[at]) { ++counts.stalePops; continue; }
+        ++counts.nodesSettled;
+        if (node == dst) { reached = at; break; }
         for (const auto& e : adjList.at(node)) {
-            if (!e.isOpen) continue;
-            int nxt = e.destination;
+            if (!shut.isOpen(e)) continue;
+            ++counts.edgesRelaxed;
             long long cand = (long long)dcur + e.travelTime;
-            if (cand < dist[nxt]) {
-                dist[nxt] = static_cast<int>(cand);
-                parent[nxt] = node;
-                pq.push({dist[nxt], nxt});
+            uint32_t next = nodes.add(e.destination);
+            if (cand < nodes.dist[next]) {
+                nodes.dist[next] = static_cast<int>(cand);
+                nodes.parent[next] = at;
+                heap.emplace_back(static_cast<int>(cand), e.destination);
+                push_heap(heap.begin(), heap.end(), later);
+                ++counts.heapPushes;
             }
         }
     }
+    if (reached == NodeTable::NONE) return -1;
 
-    if (dist[dst] == INF) {
-        result.totalCost = -1;
-        return result;
+    // the path, walking the parents back from dst
+    if (path) {
+        TIMED_REGION("buildPath");
+        for (uint32_t v = reached; v != NodeTable::NONE; v = nodes.parent[v]) path->push_back(nodes.keys[v]);
+        reverse(path->begin(), path->end());
     }
-
-    result.totalCost = dist[dst];
-    result.path = buildPath(dst, parent);
-    return result;
+    return nodes.dist[reached];
 }
 
 // shortestPath simply calls dijkstra internally
@@ -223,24 +444,98 @@ PathResult Graph::shortestPath(int start, int end) {
     return dijkstra(start, end);
 }
 
-// buildpath constructs the path from source to target
-// Of course we are using it from dijkstra parent map...
-vector<int> Graph::buildPath(int target, const unordered_map<int,int>& parent) const {
-    vector<int> path;
-    int cur = target;
-    while (parent.find(cur) != parent.end()) {
-        path.push_back(cur);
-        cur = parent.at(cur);
-    }
-    path.push_back(cur);
-    reverse(path.begin(), path.end());
-    return path;
+// the cost-only queries go through here...
+// with a landmark index that fits the graph we run A* (same cost, far fewer
+// nodes), otherwise plain dijkstra while the index is (re)built in the background
+
+int Graph::shortestTime(int src, int dst, RoutingEngine* engine, SearchStats* stats) const {
+    shared_ptr<const LandmarkIndex> index = usableRoutingIndex();
+    if (engine) *engine = index ? RoutingEngine::Landmarks : RoutingEngine::Dijkstra;
+    SearchScope scope(index ? SearchKind::Landmarks : SearchKind::Dijkstra, stats);
+    if (index) return landmarkSearch(src, dst, *index, scope.counts);
+    return dijkstraSearch(src, dst, scope.counts);
 }
 
+// A* over the open edges, h(v) = landmark lower bound from v to dst
+// nodes the bounds say can't reach dst are never queued
+// the search's distances live in per-thread arrays indexed by the index's
+// slots and stamped with the search they belong to (like the bulk reports'
+// DijkstraWorkspace), so once they've grown a query allocates nothing
+
+namespace {
+struct LandmarkScratch {
+    using Entry = tuple<long long, int, int, int>; // (cost + bound, cost, node, slot)
+    vector<uint32_t> stamp;
+    vector<int> dist;
+    vector<Entry> heap;
+    uint32_t epoch = 0;
+
+    void start(size_t nodes) {
+        if (stamp.size() < nodes) {
+            stamp.resize(nodes, 0);
+            dist.resize(nodes);
+        }
+        if (++epoch == 0) { // wrapped, old stamps could look current
+            fill(stamp.begin(), stamp.end(), 0);
+            epoch = 1;
+        }
+        heap.clear();
+    }
+    bool seen(int slot) const { return stamp[slot] == epoch; }
+};
+} // namespace
+
+int Graph::landmarkSearch(int src, int dst, const LandmarkIndex& index, SearchStats& counts) const {
+    TIMED_REGION("landmarkSearch");
+    const auto& adjList = topology->adjList;
+    const Closures& shut = *closures;
+    if (adjList.find(src) == adjList.end() || adjList.find(dst) == adjList.end()) return -1;
+    int from = index.slotOf(src), target = index.slotOf(dst);
+    // the index fits the graph, so it knows every node; if not, no arrays
+    if (from < 0 || target < 0) return dijkstraSearch(src, dst, counts);
+
+    thread_local LandmarkScratch scratch;
+    scratch.start(index.nodeCount());
+    auto& heap = scratch.heap;
+    auto later = greater<LandmarkScratch::Entry>();
+    scratch.stamp[from] = scratch.epoch;
+    scratch.dist[from] = 0;
+    heap.emplace_back(index.lowerBound(from, target), 0, src, from);
+    ++counts.heapPushes;
+
+    while (!heap.empty()) {
+        pop_heap(heap.begin(), heap.end(), later);
+        auto [f, dcur, node, slot] = heap.back();
+        heap.pop_back();
+        ++counts.heapPops;
+        if (dcur > scratch.dist[slot]) { ++counts.stalePops; continue; }
+        ++counts.nodesSettled;
+        if (node == dst) return dcur;
+        for (const auto& e : adjList.at(node)) {
+            if (!shut.isOpen(e)) continue;
+            ++counts.edgesRelaxed;
+            long long cand = (long long)dcur + e.travelTime;
+            int next = index.slotOf(e.destination);
+            if (next < 0) return dijkstraSearch(src, dst, counts);
+            if (scratch.seen(next) && cand >= scratch.dist[next]) continue;
+            int h = index.lowerBound(next, target);
+            if (h == LandmarkIndex::DISCONNECTED) continue;
+            scratch.stamp[next] = scratch.epoch;
+            scratch.dist[next] = static_cast<int>(cand);
+            heap.emplace_back(cand + h, static_cast<int>(cand), e.destination, next);
+            push_heap(heap.begin(), heap.end(), later);
+            ++counts.heapPushes;
+        }
+    }
+    return -1;
+}
 
 //geneate all the edges in the induced subgraph
-vector<EdgeInfo> Graph::inducedSubgraphEdges(const unordered_set<int>& vertices) const {
-    vector<EdgeInfo> edges;
+void Graph::inducedSubgraphEdges(const vector<int>& vertices, vector<EdgeInfo>& edges) const {
+    TIMED_REGION("inducedSubgraphEdges");
+    const auto& adjList = topology->adjList;
+    const Closures& shut = *closures;
+    edges.clear();
     for (int u : vertices) {
         auto it = adjList.find(u);
         if (it == adjList.end()) continue;
@@ -249,51 +544,58 @@ vector<EdgeInfo> Graph::inducedSubgraphEdges(const unordered_set<int>& vertices)
 
             // Notice that we need to force u < v to avoid duplicates
             // because this graph is undirected...
-            if (vertices.find(v) != vertices.end() && u < v && e.isOpen) {
+            if (u < v && shut.isOpen(e) && vertexIndex(vertices, v) != NodeTable::NONE) {
                 edges.push_back(EdgeInfo(u, v, e.travelTime));
             }
         }
     }
-    return edges;
 }
 
 // Well heads or tail?
 // I decided to use Prim's algorithm to calculate....
 // the MST cost for this induced subgraph...
+// (the vertices by their index in the sorted list, so it's all flat arrays)
 
-int Graph::computeMSTCost(const unordered_set<int>& vertices, const vector<EdgeInfo>& edges) const {
+int Graph::computeMSTCost(const vector<int>& vertices, const vector<EdgeInfo>& edges) const {
+    TIMED_REGION("computeMSTCost");
     if (vertices.empty()) return 0;
-    unordered_map<int, vector<pair<int,int>>> g;
-    for (int v : vertices) g[v] = {};
+    SearchScratch& s = scratch();
+    size_t n = vertices.size();
+    auto& offsets = s.offsets;
+    auto& links = s.links;
+    offsets.assign(n + 1, 0);
     for (const auto& e : edges) {
-        g[e.startNodeId].push_back({e.endNodeId, e.weight});
-        g[e.endNodeId].push_back({e.startNodeId, e.weight});
+        ++offsets[vertexIndex(vertices, e.startNodeId) + 1];
+        ++offsets[vertexIndex(vertices, e.endNodeId) + 1];
+    }
+    for (size_t i = 0; i < n; ++i) offsets[i + 1] += offsets[i];
+    links.resize(offsets[n]);
+    auto& cursor = s.cursor;
+    cursor.assign(offsets.begin(), offsets.end() - 1);
+    for (const auto& e : edges) {
+        uint32_t a = vertexIndex(vertices, e.startNodeId), b = vertexIndex(vertices, e.endNodeId);
+        links[cursor[a]++] = {b, e.weight};
+        links[cursor[b]++] = {a, e.weight};
     }
 
-    unordered_set<int> inMST;
-    unordered_map<int,int> minEdge;
-
-    // initialize minEdge to infinity
-    for (auto &kv : g) minEdge[kv.first] = numeric_limits<int>::max();
-
-    int start = *vertices.begin();
-    minEdge[start] = 0;
+    // initialize best edge to infinity
+    auto& best = s.best;
+    auto& inTree = s.inTree;
+    best.assign(n, numeric_limits<int>::max());
+    inTree.assign(n, 0);
+    best[0] = 0;
     int total = 0;
 
-    while (inMST.size() < vertices.size()) {
-        int pick = -1;
-        int best = numeric_limits<int>::max();
-        for (auto &kv : minEdge) {
-            if (inMST.find(kv.first) == inMST.end() && kv.second < best) {
-                best = kv.second; pick = kv.first;
-            }
-        }
-        if (pick == -1) break;
-        inMST.insert(pick);
-        total += minEdge[pick];
-        for (auto &nei : g[pick]) {
-            int v = nei.first, w = nei.second;
-            if (inMST.find(v) == inMST.end() && w < minEdge[v]) minEdge[v] = w;
+    for (size_t added = 0; added < n; ++added) {
+        size_t pick = n;
+        for (size_t v = 0; v < n; ++v)
+            if (!inTree[v] && best[v] != numeric_limits<int>::max() && (pick == n || best[v] < best[pick])) pick = v;
+        if (pick == n) break;
+        inTree[pick] = 1;
+        total += best[pick];
+        for (uint32_t k = offsets[pick]; k < offsets[pick + 1]; ++k) {
+            auto [v, w] = links[k];
+            if (!inTree[v] && w < best[v]) best[v] = w;
         }
     }
     return total;
@@ -305,16 +607,26 @@ int Graph::computeMSTCost(const unordered_set<int>& vertices, const vector<EdgeI
 // then we call computeMSTCost to get the result
 // think about this as connecting all class locations and residence with minimum total travel time
 
-int Graph::computeStudentZoneCost(int residenceId, const vector<int>& classLocations) const {
-    unordered_set<int> vertices;
-    vertices.insert(residenceId);
-    for (int loc : classLocations) {
-        PathResult pr = dijkstra(residenceId, loc);
-        if (pr.totalCost == -1) continue;
-        for (int node : pr.path) vertices.insert(node);
+int Graph::computeStudentZoneCost(int residenceId, const vector<int>& classLocations, SearchStats* stats) const {
+    return computeStudentZoneCost(residenceId, classLocations.data(), classLocations.size(), stats);
+}
+
+int Graph::computeStudentZoneCost(int residenceId, const int* classLocations, size_t count, SearchStats* stats) const {
+    SearchScope scope(SearchKind::Zone, stats);
+    SearchScratch& s = scratch();
+    auto& vertices = s.vertices;
+    vertices.clear();
+    vertices.push_back(residenceId);
+    for (size_t i = 0; i < count; ++i) {
+        if (dijkstraSearch(residenceId, classLocations[i], scope.counts, &s.path) == -1) continue;
+        vertices.insert(vertices.end(), s.path.begin(), s.path.end());
     }
-    vector<EdgeInfo> edges = inducedSubgraphEdges(vertices);
-    return computeMSTCost(vertices, edges);
+    sort(vertices.begin(), vertices.end());
+    vertices.erase(unique(vertices.begin(), vertices.end()), vertices.end());
+    inducedSubgraphEdges(vertices, s.edges);
+    scope.counts.subgraphNodes = vertices.size();
+    scope.counts.subgraphEdges = s.edges.size();
+    return computeMSTCost(vertices, s.edges);
 }
 
 
@@ -322,110 +634,201 @@ int Graph::computeStudentZoneCost(int residenceId, const vector<int>& classLocat
 // we need to validate everything before adding a student...
 // including name, ufid, classes, residence...
 
-bool Graph::addStudent(const std::string& name, const string& ufid,const std::vector<std::string>& classes, int residence) {
+bool Graph::addStudent(const std::string& name, UFIDKey ufid,const std::vector<std::string>& classes, int residence) {
+    if (classes.size() < 1 || classes.size() > 6) return false;
+    string_view views[Student::MAX_CLASSES];
+    for (size_t i = 0; i < classes.size(); ++i) views[i] = classes[i];
+    return addStudent(string_view(name), ufid, views, classes.size(), residence);
+}
+
+bool Graph::addStudent(string_view name, UFIDKey ufid, const string_view* classes, size_t classCount, int residence) {
     // Validate UFID and name
     // make sure the leading 0 is handled correctly
-    string ufidStr = ufid;
+    // (UFIDKey already packed it, an invalid ufid comes in as INVALID_UFID)
 
-    if (!Student::isValidUFID(ufidStr)) return false;
+    if (!ufid.valid()) return false;
     if (!Student::isValidName(name)) return false;
+    if (name.size() > UINT16_MAX) return false;
 
     // Validate class count
-    if (classes.size() < 1 || classes.size() > 6) return false;
+    if (classCount < 1 || classCount > 6) return false;
 
     // Check UFID uniqueness
-    if (students.find(ufid) != students.end()) return false;
+    if (registry->studentIndex.find(ufid.value) != INVALID_HANDLE) return false;
 
     // Validate class format only (do NOT check existence in classToLocation here)
-    for (const auto& c : classes) {
-        if (!Student::isValidClassCode(c)) return false;
-        if (classToLocation.find(c) == classToLocation.end()) return false; 
+    ClassId ids[Student::MAX_CLASSES];
+    size_t idCount = 0;
+    for (string_view c : Span<string_view>(classes, classCount)) {
+        ClassId id = encodeClassCode(c);
+        if (id == INVALID_CLASS_ID) return false;
+        if (this->classes->classToLocation.find(id) == this->classes->classToLocation.end()) return false;
+        ids[idCount++] = id;
     }
 
     // validate resident ID (it should exists as a node in the graph)
 
-    if (adjList.find(residence) == adjList.end())
+    if (topology->adjList.find(residence) == topology->adjList.end())
         return false;
 
     // Finally we can add student...
-    students[ufidStr] = Student(name, ufid,classes, residence);
+    // the name goes into the pool, the record only remembers the slice
+    Registry& reg = writable(registry);
+    uint32_t offset;
+    if (!reg.studentNames.append(name, offset)) return false; // name pool is full
+    SlabHandle handle = reg.students.allocate(Student(offset, static_cast<uint16_t>(name.size()), ufid,
+                                                  ClassSpan(ids, idCount), residence));
+    if (handle == INVALID_HANDLE) {
+        reg.studentNames.dropLast(offset);
+        return false; // registry is full
+    }
+    reg.studentIndex.insert(ufid.value, handle);
     return true;
 }
 
 // remove student by ufid
-bool Graph::removeStudent(const string& ufid) {
-    return students.erase(ufid) > 0;
+bool Graph::removeStudent(UFIDKey ufid) {
+    SlabHandle handle = registry->studentIndex.find(ufid.value);
+    if (handle == INVALID_HANDLE) return false;
+    Registry& reg = writable(registry);
+    eraseStudent(reg, handle);
+    compactStudentNames(reg);
+    return true;
 }
 
 // remove class from all students
 // well remove the student entirely too if no classes left after removal
-int Graph::removeClass(const std::string& classCode) {
+int Graph::removeClass(string_view classCode) {
+    ClassId id = encodeClassCode(classCode);
+    if (id == INVALID_CLASS_ID) return 0;
     int count = 0;
-    vector<string> toErase;
-    for (auto &kv : students) {
-        string uf = kv.first;
-        Student &s = kv.second;
-        if (s.hasClass(classCode)) {
-            if (s.removeClass(classCode)) {
-                count++;
-                if (s.getNumberOfClasses() == 0) toErase.push_back(uf);
-            }
+    // find the takers first, so only the slab chunks they are in get copied
+    vector<SlabHandle> takers;
+    registry->students.forEach([&](SlabHandle h, const Student &s) {
+        if (s.hasClass(id)) takers.push_back(h);
+    });
+    if (!takers.empty()) {
+        Registry& reg = writable(registry);
+        for (SlabHandle h : takers) {
+            Student &s = *reg.students.get(h);
+            s.removeClass(id);
+            count++;
+            if (s.getNumberOfClasses() == 0) eraseStudent(reg, h);
         }
+        compactStudentNames(reg);
+    }
+    if (classes->classToLocation.find(id) != classes->classToLocation.end() ||
+        classes->classInfoMap.find(id) != classes->classInfoMap.end()) {
+        ClassTable& table = writable(classes);
+        table.classToLocation.erase(id);
+        table.classInfoMap.erase(id);
     }
-    for (const string&u : toErase) students.erase(u);
-    classToLocation.erase(classCode);
-    classInfoMap.erase(classCode);
     return count;
 }
 
-bool Graph::dropClass(const string& ufid, const std::string& classCode) {
-    auto it = students.find(ufid);
-    if (it == students.end()) return false;
-    Student &s = it->second;
-    if (!s.hasClass(classCode)) return false;
-    s.removeClass(classCode);
-    if (s.getNumberOfClasses() == 0) students.erase(ufid);
+bool Graph::dropClass(UFIDKey ufid, string_view classCode) {
+    SlabHandle handle = registry->studentIndex.find(ufid.value);
+    const Student* found = registry->students.get(handle);
+    if (!found) return false;
+    ClassId id = encodeClassCode(classCode);
+    if (!found->hasClass(id)) return false;
+    Registry& reg = writable(registry);
+    Student &s = *reg.students.get(handle);
+    s.removeClass(id);
+    if (s.getNumberOfClasses() == 0) {
+        eraseStudent(reg, handle);
+        compactStudentNames(reg);
+    }
     return true;
 }
 
-bool Graph::replaceClass(const string& ufid, const std::string& oldClass, const std::string& newClass) {
-    auto it = students.find(ufid);
-    if (it == students.end()) return false;
-    Student &s = it->second;
-    if (!s.hasClass(oldClass)) return false;
-    if (s.hasClass(newClass)) return false;
-    if (classToLocation.find(newClass) == classToLocation.end()) return false;
-    return s.replaceClass(oldClass, newClass);
+bool Graph::replaceClass(UFIDKey ufid, string_view oldClass, string_view newClass) {
+    SlabHandle handle = registry->studentIndex.find(ufid.value);
+    const Student* found = registry->students.get(handle);
+    if (!found) return false;
+    ClassId oldId = encodeClassCode(oldClass);
+    ClassId newId = encodeClassCode(newClass);
+    if (!found->hasClass(oldId)) return false;
+    if (newId == INVALID_CLASS_ID || found->hasClass(newId)) return false;
+    if (classes->classToLocation.find(newId) == classes->classToLocation.end()) return false;
+    return writable(registry).students.get(handle)->replaceClass(oldId, newId);
 }
 
 // Student helpers for main.cpp...
 // I explained these in the header file...
 
-string Graph::getStudentName(const string& ufid) const {
-    auto it = students.find(ufid);
-    return it != students.end() ? it->second.getName() : "";
+string Graph::getStudentName(UFIDKey ufid) const {
+    return string(getStudentNameView(ufid));
 }
 
-int Graph::getStudentResidence(const string& ufid) const {
-    auto it = students.find(ufid);
-    return it != students.end() ? it->second.getResidence() : -1;
+string_view Graph::getStudentNameView(UFIDKey ufid) const {
+    const Student* s = findStudent(ufid);
+    return s ? s->getName(registry->studentNames) : string_view();
 }
 
-vector<pair<string,int>> Graph::getStudentClasses(const string& ufid) const {
+int Graph::getStudentResidence(UFIDKey ufid) const {
+    const Student* s = findStudent(ufid);
+    return s ? s->getResidence() : -1;
+}
+
+vector<pair<string,int>> Graph::getStudentClasses(UFIDKey ufid) const {
     vector<pair<string,int>> result;
-    auto it = students.find(ufid);
-    if (it == students.end()) return result;
-    for (const auto &code : it->second.getClasses()) {
-        result.emplace_back(code, getClassLocation(code));
+    const Student* s = findStudent(ufid);
+    if (!s) return result;
+    for (ClassId id : s->getClasses()) {
+        auto loc = classes->classToLocation.find(id);
+        result.emplace_back(formatClassCode(id), loc != classes->classToLocation.end() ? loc->second : -1);
     }
     return result;
 }
 
+ClassSpan Graph::getStudentClassIds(UFIDKey ufid) const {
+    const Student* s = findStudent(ufid);
+    return s ? s->getClasses() : ClassSpan();
+}
+
+// the registry itself...
+// students is a slab of records, studentIndex maps a ufid to its handle
+// erasing just frees the slot, nothing moves and nothing is rehashed
+
+const Student* Graph::findStudent(UFIDKey ufid) const {
+    return registry->students.get(registry->studentIndex.find(ufid.value));
+}
+
+void Graph::eraseStudent(Registry& reg, SlabHandle handle) {
+    Student* s = reg.students.get(handle);
+    if (!s) return;
+    releaseStudentName(reg, *s);
+    reg.studentIndex.erase(s->getUFID().value);
+    reg.students.free(handle);
+}
+
+// name pool housekeeping...
+// removing a student just leaves its name behind as garbage
+// once garbage is more than half the pool we copy the live names over
+
+void Graph::releaseStudentName(Registry& reg, const Student& s) {
+    reg.deadNameBytes += s.getNameLength();
+}
+
+void Graph::compactStudentNames(Registry& reg) {
+    if (reg.deadNameBytes * 2 <= reg.studentNames.size()) return;
+    NamePool pool;
+    reg.students.forEach([&](SlabHandle, Student &s) {
+        uint32_t offset;
+        pool.append(s.getName(reg.studentNames), offset); // fits, it's smaller than before
+        s.setNameOffset(offset);
+    });
+    reg.studentNames = std::move(pool);
+    reg.deadNameBytes = 0;
+}
+
 
 // shortestTimesFromResidence computes shortest travel times
 // from residenceId to each class location in classes
 
 map<string,int> Graph::shortestTimesFromResidence(int residenceId, const vector<pair<string,int>>& classes) const {
+    const auto& adjList = topology->adjList;
     map<string,int> out;
     if (adjList.find(residenceId) == adjList.end()) {
         // but still return mapping with -1 for each class
@@ -439,8 +842,7 @@ map<string,int> Graph::shortestTimesFromResidence(int residenceId, const vector<
             out[classCode] = -1;
             continue;
         }
-        PathResult pr = dijkstra(residenceId, loc);
-        out[classCode] = pr.totalCost;
+        out[classCode] = shortestTime(residenceId, loc);
     }
     return out;
 }
@@ -463,34 +865,136 @@ vector<string> Graph::verifySchedule(const vector<ClassInfo>& classes) const {
 
     // check each consecutive class pair
     for (size_t i = 0; i+1 < classes.size(); ++i) {
-        PathResult pr = dijkstra(classes[i].locationId, classes[i+1].locationId);
-        if (pr.totalCost == -1) { out.push_back("Cannot make it!"); continue; }
+        int cost = shortestTime(classes[i].locationId, classes[i+1].locationId);
+        if (cost == -1) { out.push_back("Cannot make it!"); continue; }
         // calculate the gap time between classes
         int gap = timeToMinutes(classes[i+1].startTime) - timeToMinutes(classes[i].endTime);
-        out.push_back(gap >= pr.totalCost ? "Can make it!" : "Cannot make it!");
+        out.push_back(gap >= cost ? "Can make it!" : "Cannot make it!");
     }
     return out;
 }
 
 // the edge helpers to find edges in the adjacency list...
 
-Edge* Graph::findEdge(int u, int v) {
+const Edge* Graph::findEdgeConst(int u, int v) const {
+    const auto& adjList = topology->adjList;
     auto it = adjList.find(u);
     if (it == adjList.end()) return nullptr;
-    for (auto &e : it->second) if (e.destination == v) return &e;
+    for (const auto &e : it->second) if (e.destination == v) return &e;
     return nullptr;
 }
 
-const Edge* Graph::findEdgeConst(int u, int v) const {
-    auto it = adjList.find(u);
-    if (it == adjList.end()) return nullptr;
-    for (const auto &e : it->second) if (e.destination == v) return &e;
+
+// routing index housekeeping...
+// nothing is built until a query (or prepareRoutingIndex) needs it, so
+// loading the CSVs or a burst of toggles doesn't start a build per change
+
+void Graph::enableRoutingIndex(const string& cachePath) {
+    routing = make_shared<RoutingManager>(cachePath);
+}
+
+// the one place the cache file is read on the caller's thread (Main does
+// it at startup), a query that misses leaves that to the builder too
+
+void Graph::prepareRoutingIndex() const {
+    if (!routing || routingIndexReady()) return;
+    if (!routing->tryLoadCache(routingKey())) usableRoutingIndex();
+}
+
+bool Graph::routingIndexReady() const {
+    if (!routing) return false;
+    shared_ptr<const LandmarkIndex> index = routing->current();
+    return index && index->getKey() == routingKey();
+}
+
+void Graph::waitForRoutingIndex() const {
+    if (routing) routing->waitForBuild();
+}
+
+RoutingKey Graph::routingKey() const {
+    RoutingKey key;
+    key.edgesFingerprint = topology->edgesFingerprint;
+    key.nodeCount = topology->adjList.size();
+    key.edgeCount = topology->edgeCount;
+    return key;
+}
+
+shared_ptr<const LandmarkIndex> Graph::usableRoutingIndex() const {
+    if (!routing) return nullptr;
+    RoutingKey key = routingKey();
+    shared_ptr<const LandmarkIndex> index = routing->current();
+    if (index && index->getKey() == key) return index;
+    // the builder copies the edges itself, from this version of the topology
+    shared_ptr<const Topology> edges = topology;
+    routing->requestBuild(key, [edges] { return routingTopology(*edges, nullptr); });
     return nullptr;
 }
 
+RoutingTopology Graph::routingTopology(const Topology& from, const Closures* skip) {
+    const auto& adjList = from.adjList;
+    RoutingTopology topo;
+    topo.ids.reserve(adjList.size());
+    for (const auto& kv : adjList) topo.ids.push_back(kv.first);
+    sort(topo.ids.begin(), topo.ids.end());
+    unordered_map<int, uint32_t> slot;
+    slot.reserve(topo.ids.size());
+    for (uint32_t i = 0; i < topo.ids.size(); ++i) slot[topo.ids[i]] = i;
+
+    topo.offsets.reserve(topo.ids.size() + 1);
+    topo.offsets.push_back(0);
+    for (int id : topo.ids) {
+        for (const Edge& e : adjList.at(id)) {
+            if (skip && !skip->isOpen(e)) continue;
+            topo.targets.push_back(slot.at(e.destination));
+            topo.weights.push_back(e.travelTime);
+        }
+        topo.offsets.push_back(static_cast<uint32_t>(topo.targets.size()));
+    }
+    return topo;
+}
+
+
+// memory...
+// the adjacency list is a node-based unordered_map, so we count it the way
+// libstdc++ lays it out: a bucket array of pointers, and one heap node per
+// entry (next pointer + the pair), plus every edge vector's capacity
+
+// the heap part of a string, 0 when it's short enough to live inside it
+static size_t stringHeapBytes(const string& s) {
+    const char* self = reinterpret_cast<const char*>(&s);
+    bool inside = s.data() >= self && s.data() < self + sizeof(s);
+    return inside ? 0 : s.capacity() + 1;
+}
+
+MemoryUsage Graph::memoryUsage() const {
+    MemoryUsage m;
+    const auto& adjList = topology->adjList;
+    using AdjEntry = unordered_map<int, vector<Edge>>::value_type;
+    m.nodes = adjList.size();
+    m.edges = topology->edgeCount / 2;
+    m.adjacency = adjList.bucket_count() * sizeof(void*) + adjList.size() * (sizeof(void*) + sizeof(AdjEntry));
+    for (const auto& kv : adjList) m.adjacency += kv.second.capacity() * sizeof(Edge);
+    m.adjacency += closures->closed.capacity() * sizeof(uint64_t);
+
+    m.classes = classes->classInfoMap.size();
+    m.classMaps = classes->classToLocation.memoryBytes() + classes->classInfoMap.memoryBytes();
+    for (const auto& kv : classes->classInfoMap)
+        m.classMaps += stringHeapBytes(kv.second.startTime) + stringHeapBytes(kv.second.endTime);
+
+    m.students = registry->students.size();
+    m.studentRecords = registry->students.memoryBytes();
+    m.studentIndex = registry->studentIndex.memoryBytes();
+    m.studentNames = registry->studentNames.memoryBytes();
+
+    if (routing) {
+        shared_ptr<const LandmarkIndex> index = routing->current();
+        if (index) m.routingIndex = index->memoryBytes();
+    }
+    return m;
+}
 
 // again we just print graph and student counts for debugging...
 void Graph::debugGraphState() const {
-    cerr << "Nodes: " << adjList.size() << "\n";
-    cerr << "Students: " << students.size() << "\n";
+    cerr << "Nodes: " << topology->adjList.size() << "\n";
+    cerr << "Students: " << registry->students.size() << "\n";
 }
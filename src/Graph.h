@@ -7,22 +7,30 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <map>
+#include <memory>
 #include "student.h"
+#include "FlatHashMap.h"
+#include "UFIDIndex.h"
+#include "CsvReader.h"
+#include "RoutingIndex.h"
+#include "SearchStats.h"
 
 using namespace std;
 
+class ThreadPool;
 
 // We need to define Edge, PathResult, ClassInfo, EdgeInfo structs here
 // destination is the node ID reached from current node
 // travelTime is the weight of the edge
-// isOpen indicates whether the path is usable or not (true = open, false = closed)
+// link numbers the edge (both directions share it), whether the path is
+// usable or not is kept by the Graph under that number (see Graph::Closures)
 
 struct Edge {
     int destination;
     int travelTime;
-    bool isOpen;
-    Edge(int dest = 0, int time = 0, bool open = true)
-        : destination(dest), travelTime(time), isOpen(open) {}
+    uint32_t link;
+    Edge(int dest = 0, int time = 0, uint32_t link = 0)
+        : destination(dest), travelTime(time), link(link) {}
 };
 
 // stores the result of a shortest path search
@@ -56,6 +64,43 @@ struct EdgeInfo {
     EdgeInfo(int u = 0, int v = 0, int w = 0) : startNodeId(u), endNodeId(v), weight(w) {}
 };
 
+// one student's answer in the bulk reports (shortestTimesForAllStudents and co.)
+// times are (class code, travel time from the residence or -1) sorted by
+// code, the same lines printShortestEdges prints
+// verdicts are verifySchedule's, for the classes in start time order
+
+struct StudentTimes {
+    UFIDKey ufid;
+    vector<pair<string,int>> times;
+};
+
+struct StudentZoneCost {
+    UFIDKey ufid;
+    int cost = 0;
+};
+
+struct StudentSchedule {
+    UFIDKey ufid;
+    vector<string> verdicts;
+};
+
+// what memoryUsage reports: the sizes, then the heap bytes behind each part
+// (what the containers hold, malloc's own overhead not counted; a part shared
+// with another copy of the graph is counted in full by both)
+
+struct MemoryUsage {
+    size_t nodes = 0, edges = 0, classes = 0, students = 0;
+    size_t adjacency = 0;      // adjList: buckets, nodes and edge vectors (and the closed bits)
+    size_t classMaps = 0;      // classToLocation + classInfoMap (and their time strings)
+    size_t studentRecords = 0; // the slab of Student records
+    size_t studentIndex = 0;   // UFID -> record
+    size_t studentNames = 0;   // the name pool, removed students' slices too
+    size_t routingIndex = 0;   // the landmark index (mapped or built), 0 without one
+    size_t total() const {
+        return adjacency + classMaps + studentRecords + studentIndex + studentNames + routingIndex;
+    }
+};
+
 // Graph class definition
 // main part of our project...
 class Graph {
@@ -63,25 +108,49 @@ public:
 
     // Constructors / Destructors
 
+    // the registry mode picks how a UFID finds its student (see UFIDIndex.h)
+    // Hashed is the default, DirectAddress is for registrar sized data
+
+    // copying a graph is cheap, the copy shares the topology, closures, class
+    // table and student registry with the original until one of them changes a part
+    // (copy-on-write, see the private section). GraphStore.h builds on this
+
     Graph() = default;
+    explicit Graph(RegistryMode mode) : registry(make_shared<Registry>(mode)) {}
     ~Graph() = default;
 
+    RegistryMode getRegistryMode() const { return registry->studentIndex.getMode(); }
+
+    // true if both graphs still share all four parts (neither changed anything)
+    bool sharesStateWith(const Graph& other) const {
+        return topology == other.topology && closures == other.closures && classes == other.classes &&
+               registry == other.registry;
+    }
+
     // CSV loaders (debug: main.cpp will call using "../data/...")
     // be careful of the relative path when testing
     // loadEdgesCSV loads edges into the graph
     // loadClassesCSV loads class location and time info
 
+    // getLoadErrors lists the rows the last loader skipped (with line numbers)
+    // edge files bigger than the parallel threshold (bytes) are parsed on the thread pool
+
     bool loadEdgesCSV(const string& filepath);
     bool loadClassesCSV(const string& filepath);
+    const vector<CsvError>& getLoadErrors() const { return loadErrors; }
+    void setParallelLoadThreshold(size_t bytes) { parallelLoadThreshold = bytes; }
 
     // Class queries
     // getClassLocation returns location ID for classCode, of course -1 if DNE...
     // getClassInfo returns stored ClassInfo (literally class information) for classCode
     // setClassInfo sets/updates ClassInfo for classCode (insertion...)
 
-    int getClassLocation(const string& classCode) const;
-    ClassInfo getClassInfo(const string& classCode) const;
-    void setClassInfo(const std::string& classCode, const ClassInfo& info);
+    // (class codes are taken as string_view, so a token from the input works as is)
+
+    int getClassLocation(string_view classCode) const;
+    int getClassLocationById(ClassId id) const;
+    ClassInfo getClassInfo(string_view classCode) const;
+    void setClassInfo(string_view classCode, const ClassInfo& info);
 
     // Edge operations
     // addEdge adds an directed edge between u and v with given traveltime
@@ -98,9 +167,14 @@ public:
     // return true if there is a path from src to dst
     // we love dijkstra...
     // we only use open edges for dijkstra
-
-    bool isConnected(int src, int dst) const;
-    PathResult dijkstra(int src, int dst) const;
+    // stats (optional) gets how much searching the query took (SearchStats.h)
+    // the searches work in per-thread scratch, so once warm they allocate
+    // nothing; the second dijkstra fills a result the caller keeps reusing
+    // (the first one has to allocate the path it hands back)
+
+    bool isConnected(int src, int dst, SearchStats* stats = nullptr) const;
+    PathResult dijkstra(int src, int dst, SearchStats* stats = nullptr) const;
+    void dijkstra(int src, int dst, PathResult& result, SearchStats* stats = nullptr) const;
     PathResult shortestPath(int start, int end);
 
 
@@ -113,11 +187,14 @@ public:
     // dropClass removes class from 1 specific student, returns true if successful
     // replaceClass replaces oldClass with newClass for a specific student, returns true if successful
 
-    bool addStudent(const std::string& name, const string& ufid,const std::vector<std::string>& classes, int residence);
-    bool removeStudent(const string& ufid);
-    int removeClass(const std::string& classCode);
-    bool dropClass(const string& ufid, const std::string& classCode);
-    bool replaceClass(const string& ufid, const std::string& oldClass, const std::string& newClass);
+    // (the second one takes views straight from the input line, nothing is copied)
+
+    bool addStudent(const std::string& name, UFIDKey ufid,const std::vector<std::string>& classes, int residence);
+    bool addStudent(string_view name, UFIDKey ufid, const string_view* classes, size_t classCount, int residence);
+    bool removeStudent(UFIDKey ufid);
+    int removeClass(string_view classCode);
+    bool dropClass(UFIDKey ufid, string_view classCode);
+    bool replaceClass(UFIDKey ufid, string_view oldClass, string_view newClass);
 
     
     
@@ -125,10 +202,16 @@ public:
     // getStudentName returns name by ufid, empty string if DNE
     // getStudentResidence returns residence ID by ufid, -1 if DNE
     // getStudentClasses returns vector/pair of (classCode, locationID) pairs for student
+    // (this is where the packed class ids get turned back into strings)
+    // getStudentClassIds is the no-copy version, a view into the Student record
+    // (it is only good until the next change to that student)
+    // getStudentNameView is the same idea for the name, a view into the name pool
 
-    string getStudentName(const string& ufid) const;
-    int getStudentResidence(const string& ufid) const;
-    vector<pair<string,int>> getStudentClasses(const string& ufid) const;
+    string getStudentName(UFIDKey ufid) const;
+    string_view getStudentNameView(UFIDKey ufid) const;
+    int getStudentResidence(UFIDKey ufid) const;
+    vector<pair<string,int>> getStudentClasses(UFIDKey ufid) const;
+    ClassSpan getStudentClassIds(UFIDKey ufid) const;
 
     // Times and student zone
     // shortestTimesFromResidence returns map 
@@ -136,14 +219,68 @@ public:
     // basically the shortest travel time from residence to each class location
     // if unreachable or invalid location, time is -1
     // computeStudentZoneCost computes the total cost of MST 
-    // for the set of class locations from residenceId
+    // for the set of class locations from residenceId (stats: all of its searches)
     map<string,int> shortestTimesFromResidence(int residenceId, const vector<pair<string,int>>& classes) const;
-    int computeStudentZoneCost(int residenceId, const vector<int>& classLocations) const;
+    int computeStudentZoneCost(int residenceId, const vector<int>& classLocations, SearchStats* stats = nullptr) const;
+    int computeStudentZoneCost(int residenceId, const int* classLocations, size_t count,
+                               SearchStats* stats = nullptr) const;
 
     // Extra credit...
     // we check if the schedule has any conflicts
     vector<string> verifySchedule(const vector<ClassInfo>& classes) const;
 
+    // Bulk reports over the whole registry (the nightly ones)
+    // every student once, in UFID order, with the same answers as asking
+    // for one student at a time. the students are cut into tasks for the
+    // work-stealing pool and every worker keeps its own dijkstra workspace
+    // (see BulkQueries.cpp), pool null means ThreadPool::shared()
+
+    vector<StudentTimes> shortestTimesForAllStudents(ThreadPool* pool = nullptr) const;
+    vector<StudentZoneCost> zoneCostForAllStudents(ThreadPool* pool = nullptr) const;
+    vector<StudentSchedule> verifyAllSchedules(ThreadPool* pool = nullptr) const;
+
+    // Snapshots (see Snapshot.h)
+    // saveSnapshot writes everything (topology + closures, classes, students) in one call
+    // loadSnapshot replaces this graph with the file's, false (and no change) if it's bad
+    // the fingerprints are hashes of the CSVs this graph was loaded from (0 if none)
+
+    bool saveSnapshot(const string& path) const;
+    bool loadSnapshot(const string& path);
+    uint64_t getEdgesFingerprint() const { return topology->edgesFingerprint; }
+    uint64_t getClassesFingerprint() const { return classes->classesFingerprint; }
+
+    // the sizes without walking anything (memoryUsage has the bytes)
+    // closureEpoch counts the toggleEdgesClosure calls that flipped an edge
+    // since the graph was built or loaded
+    size_t getLocationCount() const { return topology->adjList.size(); }
+    size_t getEdgeCount() const { return topology->edgeCount / 2; }
+    size_t getStudentCount() const { return registry->students.size(); }
+    uint64_t getClosureEpoch() const { return closures->epoch; }
+
+    // Routing index (see RoutingIndex.h)
+    // enableRoutingIndex turns on the landmark index for the cost-only queries
+    // (shortestTime, shortestTimesFromResidence, verifySchedule), paths and
+    // zones still come from dijkstra. cachePath is where the index is kept
+    // between runs, "" keeps it in memory only
+    // prepareRoutingIndex maps the cache in if it matches the edges,
+    // otherwise starts a background build (a query that misses does that)
+    // closing or opening edges never makes the index stale, see RoutingIndex.h
+    // routingIndexEnabled: enableRoutingIndex was called
+    // routingIndexReady says whether the published index fits the graph right now
+    // waitForRoutingIndex blocks until a background build is done
+    // shortestTime is the cost of the shortest open path, -1 if none
+    // (engine and stats say who answered and how much work it was)
+
+    void enableRoutingIndex(const string& cachePath = "");
+    bool routingIndexEnabled() const { return routing != nullptr; }
+    void prepareRoutingIndex() const;
+    bool routingIndexReady() const;
+    void waitForRoutingIndex() const;
+    int shortestTime(int src, int dst, RoutingEngine* engine = nullptr, SearchStats* stats = nullptr) const;
+
+    // memoryUsage adds up what every structure holds, see MemoryUsage
+    MemoryUsage memoryUsage() const;
+
     // Debug
     // We might print the adjacency list and class/student registries for debugging
     // It's really useful for you to see which function works and which doesn't
@@ -155,30 +292,128 @@ private:
     // adjacency list representation of the graph
     // classToLocation maps class codes to location IDs
     // classInfoMap maps class codes to ClassInfo structs
-    // students maps UFID to Student objects
-
-    unordered_map<int, vector<Edge>> adjList;
-    unordered_map<string, int> classToLocation;
-    unordered_map<string, ClassInfo> classInfoMap;
-    unordered_map<string, Student> students;
+    // students holds the Student records in a slab (Slab.h),
+    // studentIndex maps a packed UFID to the record's handle
+    // all of these are keyed on the packed ids from student.h, not strings
+    // and the class registries are flat open-addressing tables (FlatHashMap.h)
+
+    // they live in four parts behind shared pointers, so copies of the graph
+    // (the published versions in a GraphStore) share whatever they didn't change
+    // edgeCount counts both directions of every edge, an edge's link is
+    // edgeCount / 2 from just before it was added
+    // which edges are closed is a part of its own, one bit per link (set =
+    // closed), so a toggle copies those bits and never the adjacency lists;
+    // epoch goes up by one with every toggle that changed them
+    // studentNames is the name pool, every Student keeps a slice of it
+    // deadNameBytes counts the slices of removed students, we compact
+    // the pool once more than half of it is garbage
+    // inside the registry the slab chunks, index pages/shards and name blocks
+    // are shared the same way, so changing one student copies the pieces
+    // that student is in, not the whole registry (a compaction or a
+    // removeClass that hits everyone still touches it all)
+
+    struct Topology {
+        unordered_map<int, vector<Edge>> adjList;
+        size_t edgeCount = 0;
+        uint64_t edgesFingerprint = 0;
+    };
+    struct Closures {
+        vector<uint64_t> closed; // as long as the highest link ever closed needs
+        uint64_t epoch = 0;
+
+        bool isOpen(const Edge& e) const {
+            size_t word = e.link >> 6;
+            return word >= closed.size() || !((closed[word] >> (e.link & 63)) & 1);
+        }
+        void flip(uint32_t link) {
+            if ((link >> 6) >= closed.size()) closed.resize((link >> 6) + 1);
+            closed[link >> 6] ^= uint64_t(1) << (link & 63);
+        }
+    };
+    struct ClassTable {
+        FlatHashMap<ClassId, int, ClassKeyTraits> classToLocation;
+        FlatHashMap<ClassId, ClassInfo, ClassKeyTraits> classInfoMap;
+        uint64_t classesFingerprint = 0;
+    };
+    struct Registry {
+        explicit Registry(RegistryMode mode = RegistryMode::Hashed) : studentIndex(mode) {}
+        Slab<Student> students;
+        UFIDIndex studentIndex;
+        NamePool studentNames;
+        size_t deadNameBytes = 0;
+    };
+
+    shared_ptr<const Topology> topology = make_shared<Topology>();
+    shared_ptr<const Closures> closures = make_shared<Closures>();
+    shared_ptr<const ClassTable> classes = make_shared<ClassTable>();
+    shared_ptr<const Registry> registry = make_shared<Registry>();
+
+    // writable hands out a part we may change: ours alone if nobody else holds
+    // it, otherwise a private copy first (the other holders keep the old one)
+    // every mutator goes through here, readers just use the const pointers
+
+    template <class Part>
+    static Part& writable(shared_ptr<const Part>& part) {
+        if (part.use_count() != 1) part = make_shared<Part>(*part);
+        return const_cast<Part&>(*part);
+    }
+
+    // malformed rows from the last CSV load
+    vector<CsvError> loadErrors;
+    size_t parallelLoadThreshold = size_t(4) << 20;
+
+    // routing is null until enableRoutingIndex, it's shared so copies of the
+    // graph share one builder (the index key tells them apart)
+
+    shared_ptr<RoutingManager> routing;
 
 
     // Some internal helper functions for graph algorithms...
     // inducedSubgraphEdges returns all edges between the given set of vertices
     // computeMSTCost computes the total weight of the MST for the given vertices and edges
     // we can use either Kruskal or Prim algorithm learned in class
+    // (vertices sorted without duplicates, the edges go into the caller's vector)
 
-    vector<EdgeInfo> inducedSubgraphEdges(const unordered_set<int>& vertices) const;
-    int computeMSTCost(const unordered_set<int>& vertices, const vector<EdgeInfo>& edges) const;
+    void inducedSubgraphEdges(const vector<int>& vertices, vector<EdgeInfo>& edges) const;
+    int computeMSTCost(const vector<int>& vertices, const vector<EdgeInfo>& edges) const;
 
-    //findEdge helps to find edge from u to v
-    //findEdgeConst is the const version...
+    //findEdgeConst helps to find edge from u to v
 
-    Edge* findEdge(int u, int v);
     const Edge* findEdgeConst(int u, int v) const;
 
-    // buildPath constructs the path from source to target
-    // Of course we are using it from dijkstra parent map...
+    // dijkstraSearch is dijkstra without the bookkeeping, counting into counts:
+    // the cost (-1 if none), and the path into *path when one is wanted
+
+    int dijkstraSearch(int src, int dst, SearchStats& counts, vector<int>* path = nullptr) const;
+
+    // addEdgesBulk adds every edge of every chunk, same result as addEdge in order
+    void addEdgesBulk(const vector<vector<EdgeInfo>>& chunks);
+
+    // findStudent returns the record for ufid or nullptr
+    // eraseStudent frees the record and its index entry, O(1)
+
+    const Student* findStudent(UFIDKey ufid) const;
+    static void eraseStudent(Registry& reg, SlabHandle handle);
+
+    // releaseStudentName marks a removed student's name as garbage
+    // compactStudentNames rebuilds the pool and fixes every student's offset
+
+    static void releaseStudentName(Registry& reg, const Student& s);
+    static void compactStudentNames(Registry& reg);
+
+    // routingKey describes the edges as they are now, the index must match it
+    // routingTopology copies the edges into a CSR, leaving out the ones
+    // closed in *skip (the index is built on all of them, skip null)
+    // usableRoutingIndex returns the index if it matches, else asks for one
+    // landmarkSearch is A* with the landmark bounds, cost only
+
+    // studentsByUFID lists every record in UFID order (for the bulk reports)
+
+    vector<const Student*> studentsByUFID() const;
 
-    vector<int> buildPath(int target, const unordered_map<int,int>& parent) const;
+    RoutingKey routingKey() const;
+    RoutingTopology routingTopology() const { return routingTopology(*topology, closures.get()); }
+    static RoutingTopology routingTopology(const Topology& from, const Closures* skip);
+    shared_ptr<const LandmarkIndex> usableRoutingIndex() const;
+    int landmarkSearch(int src, int dst, const LandmarkIndex& index, SearchStats& counts) const;
 };
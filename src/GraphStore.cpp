@@ -0,0 +1,23 @@
+#include "GraphStore.h"
+
+GraphStore::GraphStore(Graph initial)
+    : latest(make_shared<const Graph>(std::move(initial))), current(latest) {}
+
+// the pointer goes out before the version number, so a reader that sees
+// the new number always gets (at least) the new version
+
+void GraphStore::commit(Graph& next) {
+    if (next.sharesStateWith(*latest)) return;
+    latest = make_shared<const Graph>(std::move(next));
+    atomic_store(&current, latest);
+    published.fetch_add(1, memory_order_release);
+}
+
+const Graph& GraphStore::Reader::get() {
+    uint64_t now = store.version();
+    if (now != seen || !cached) {
+        cached = store.snapshot();
+        seen = now;
+    }
+    return *cached;
+}
@@ -0,0 +1,79 @@
+// GraphStore.h
+// one Graph shared by many threads, published RCU style
+//
+// the current graph is an immutable version behind a shared pointer.
+// a reader takes a version and works on it without any lock, for as long as
+// it likes. a writer copies the current version (cheap, the copy shares the
+// topology, class table and student registry, see Graph.h), changes its copy
+// and publishes it; only the parts it touched are really copied. an old
+// version goes away when its last reader lets go of it
+//
+// writers take turns on a mutex, readers never wait for them: a query that
+// started on the old version just finishes on it
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include "Graph.h"
+
+using namespace std;
+
+class GraphStore {
+public:
+    // takes a copy of initial (shared parts, so it's cheap)
+    explicit GraphStore(Graph initial);
+    GraphStore(const GraphStore&) = delete;
+    GraphStore& operator=(const GraphStore&) = delete;
+
+    // the current version, it never changes under you
+    shared_ptr<const Graph> snapshot() const { return atomic_load(&current); }
+
+    // bumped on every publish
+    uint64_t version() const { return published.load(memory_order_acquire); }
+
+    // runs change(Graph&) on a copy of the current version and publishes it,
+    // returns what change returned. the caller sees its own change right away
+    // a change that touched nothing (a failed remove, a toggle of a missing
+    // edge) publishes nothing
+    template <class Change>
+    auto update(Change&& change) {
+        lock_guard<mutex> guard(writer);
+        Graph next(*latest);
+        if constexpr (is_void_v<invoke_result_t<Change&, Graph&>>) {
+            change(next);
+            commit(next);
+        } else {
+            auto result = change(next);
+            commit(next);
+            return result;
+        }
+    }
+
+    // Reader is one thread's view of the store: it keeps the version it used
+    // last and only goes back to the shared pointer when the version number
+    // moved, so readers on different cores don't all bump one reference count
+    // (one per thread, it isn't thread safe itself)
+    class Reader {
+    public:
+        explicit Reader(const GraphStore& store) : store(store) {}
+
+        // the newest version, good until the next get()
+        const Graph& get();
+
+    private:
+        const GraphStore& store;
+        shared_ptr<const Graph> cached;
+        uint64_t seen = 0;
+    };
+
+private:
+    void commit(Graph& next);
+
+    mutex writer;                    // one writer at a time
+    shared_ptr<const Graph> latest;  // writer's copy of current, guarded by writer
+    shared_ptr<const Graph> current; // only through atomic_load / atomic_store
+    atomic<uint64_t> published{1};
+};
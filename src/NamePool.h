@@ -0,0 +1,87 @@
+// NamePool.h
+// the students' names back to back, a Student keeps its name as a slice
+// (offset, length) of the pool (see student.h)
+//
+// the bytes are in blocks of BLOCK_SIZE and a name never straddles two
+// blocks, so a slice is always one string_view. copies of the pool share
+// the blocks, and since names only ever go on the end, a copy that adds a
+// name copies the last block and nothing else
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+class NamePool {
+public:
+    static constexpr uint32_t BLOCK_BITS = 16;
+    static constexpr uint32_t BLOCK_SIZE = 1u << BLOCK_BITS; // the longest name (16 bit length) fits one
+    static constexpr size_t MAX_BLOCKS = size_t(1) << (32 - BLOCK_BITS); // offsets are 32 bits
+
+    string_view view(uint32_t offset, uint16_t length) const {
+        return string_view(*blocks[offset >> BLOCK_BITS]).substr(offset & (BLOCK_SIZE - 1), length);
+    }
+
+    // true if (offset, length) lies inside one block, like every slice we hand out
+    bool holds(uint32_t offset, uint16_t length) const {
+        size_t b = offset >> BLOCK_BITS;
+        return b < blocks.size() && (offset & (BLOCK_SIZE - 1)) + size_t(length) <= blocks[b]->size();
+    }
+
+    // copies name onto the end, false once the 32 bit offsets run out
+    bool append(string_view name, uint32_t& offset) {
+        if (blocks.empty() || blocks.back()->size() + name.size() > BLOCK_SIZE) {
+            if (blocks.size() == MAX_BLOCKS) return false;
+            blocks.push_back(make_shared<string>());
+        }
+        // the last block is ours alone or copied first (another pool holds it)
+        shared_ptr<const string>& last = blocks.back();
+        if (last.use_count() != 1) {
+            auto copy = make_shared<string>();
+            copy->reserve(last->size() + name.size());
+            copy->append(*last);
+            last = std::move(copy);
+        }
+        string& bytes = const_cast<string&>(*last);
+        offset = static_cast<uint32_t>((blocks.size() - 1) << BLOCK_BITS | bytes.size());
+        bytes += name;
+        return true;
+    }
+
+    // takes the last append back (offset is what it returned)
+    void dropLast(uint32_t offset) {
+        shared_ptr<const string>& last = blocks.back();
+        size_t keep = offset & (BLOCK_SIZE - 1);
+        if (keep == 0) blocks.pop_back();
+        else if (last.use_count() != 1) last = make_shared<string>(last->substr(0, keep));
+        else const_cast<string&>(*last).resize(keep);
+    }
+
+    // the pool as one run of bytes, the unused end of every block but the
+    // last zero filled, so the offsets index straight into it
+    size_t size() const { return blocks.empty() ? 0 : (blocks.size() - 1) * BLOCK_SIZE + blocks.back()->size(); }
+    void appendTo(string& out) const {
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            out += *blocks[b];
+            if (b + 1 < blocks.size()) out.append(BLOCK_SIZE - blocks[b]->size(), '\0');
+        }
+    }
+    // and back (blocks come out full, bar the last)
+    void assign(string_view bytes) {
+        blocks.clear();
+        for (size_t at = 0; at < bytes.size(); at += BLOCK_SIZE)
+            blocks.push_back(make_shared<string>(bytes.substr(at, BLOCK_SIZE)));
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = blocks.capacity() * sizeof(blocks[0]);
+        for (const auto& block : blocks) bytes += block->capacity();
+        return bytes;
+    }
+
+private:
+    vector<shared_ptr<const string>> blocks;
+};
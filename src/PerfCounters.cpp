@@ -0,0 +1,200 @@
+#include "PerfCounters.h"
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PERF_HAS_EVENTS 1
+#endif
+
+PerfSample& PerfSample::operator+=(const PerfSample& other) {
+    count += other.count;
+    cycles += other.cycles;
+    instructions += other.instructions;
+    cacheMisses += other.cacheMisses;
+    branchMisses += other.branchMisses;
+    scaled += other.scaled;
+    timeEnabled += other.timeEnabled;
+    timeRunning += other.timeRunning;
+    return *this;
+}
+
+bool PerfSample::since(const PerfSample& start, PerfSample& delta) const {
+    uint64_t enabled = timeEnabled - start.timeEnabled, running = timeRunning - start.timeRunning;
+    if (running == 0) return false; // never on the PMU, nothing to scale
+    delta = PerfSample();
+    delta.count = 1;
+    delta.timeEnabled = enabled;
+    delta.timeRunning = running;
+    delta.cycles = cycles - start.cycles;
+    delta.instructions = instructions - start.instructions;
+    delta.cacheMisses = cacheMisses - start.cacheMisses;
+    delta.branchMisses = branchMisses - start.branchMisses;
+    if (running < enabled) {
+        double factor = static_cast<double>(enabled) / static_cast<double>(running);
+        for (uint64_t* n : {&delta.cycles, &delta.instructions, &delta.cacheMisses, &delta.branchMisses})
+            *n = static_cast<uint64_t>(static_cast<double>(*n) * factor + 0.5);
+        delta.scaled = 1;
+    }
+    return true;
+}
+
+atomic<bool> PerfCounters::switchedOn{false};
+
+#ifdef PERF_HAS_EVENTS
+
+// the events, in the order they're read back; cycles leads the group
+static const uint64_t EVENTS[4] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                   PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+static const char* const EVENT_NAMES[4] = {"cycles", "instructions", "cache misses", "branch misses"};
+
+namespace {
+
+// one thread's group, closed when the thread ends
+struct CounterGroup {
+    int fds[4] = {-1, -1, -1, -1};
+    bool tried = false;
+    string error;
+
+    bool open() {
+        if (tried) return fds[0] != -1;
+        tried = true;
+        for (int i = 0; i < 4; ++i) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = EVENTS[i];
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.exclude_kernel = 1; // what perf_event_paranoid 2 allows, and what we care about
+            attr.exclude_hv = 1;
+            attr.disabled = i == 0; // the group starts when its leader is enabled
+            long fd = syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0);
+            if (fd < 0) {
+                error = string("can't open the ") + EVENT_NAMES[i] + " counter: " + strerror(errno);
+                close();
+                return false;
+            }
+            fds[i] = static_cast<int>(fd);
+        }
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+    }
+
+    void close() {
+        for (int& fd : fds) {
+            if (fd != -1) ::close(fd);
+            fd = -1;
+        }
+    }
+
+    ~CounterGroup() { close(); }
+};
+
+CounterGroup& threadGroup() {
+    thread_local CounterGroup group;
+    return group;
+}
+
+} // namespace
+
+bool PerfCounters::enable(string& error) {
+    CounterGroup& group = threadGroup();
+    if (!group.open()) {
+        error = group.error;
+        return false;
+    }
+    switchedOn.store(true, memory_order_relaxed);
+    return true;
+}
+
+bool PerfCounters::read(PerfSample& now) {
+    CounterGroup& group = threadGroup();
+    if (!group.open()) return false;
+    // nr, time enabled, time running, then the values (the group shares its times)
+    uint64_t values[3 + 4];
+    if (::read(group.fds[0], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)) || values[0] != 4)
+        return false;
+    now.count = 1;
+    now.timeEnabled = values[1];
+    now.timeRunning = values[2];
+    now.cycles = values[3];
+    now.instructions = values[4];
+    now.cacheMisses = values[5];
+    now.branchMisses = values[6];
+    return true;
+}
+
+#else
+
+bool PerfCounters::enable(string& error) {
+    error = "hardware counters need Linux (perf_event_open)";
+    return false;
+}
+
+bool PerfCounters::read(PerfSample&) {
+    return false;
+}
+
+#endif
+
+void PerfCounters::disable() {
+    switchedOn.store(false, memory_order_relaxed);
+}
+
+
+// totals...
+
+PerfTotals::PerfTotals(size_t rows) : size(rows), table(make_unique<Row[]>(rows)) {}
+
+void PerfTotals::add(size_t row, const PerfSample& delta) {
+    if (row >= size) return;
+    Row& r = table[row];
+    r.count.fetch_add(delta.count, memory_order_relaxed);
+    r.cycles.fetch_add(delta.cycles, memory_order_relaxed);
+    r.instructions.fetch_add(delta.instructions, memory_order_relaxed);
+    r.cacheMisses.fetch_add(delta.cacheMisses, memory_order_relaxed);
+    r.branchMisses.fetch_add(delta.branchMisses, memory_order_relaxed);
+    r.scaled.fetch_add(delta.scaled, memory_order_relaxed);
+}
+
+PerfSample PerfTotals::total(size_t row) const {
+    PerfSample s;
+    if (row >= size) return s;
+    const Row& r = table[row];
+    s.count = r.count.load(memory_order_relaxed);
+    s.cycles = r.cycles.load(memory_order_relaxed);
+    s.instructions = r.instructions.load(memory_order_relaxed);
+    s.cacheMisses = r.cacheMisses.load(memory_order_relaxed);
+    s.branchMisses = r.branchMisses.load(memory_order_relaxed);
+    s.scaled = r.scaled.load(memory_order_relaxed);
+    return s;
+}
+
+bool PerfTotals::empty() const {
+    for (size_t row = 0; row < size; ++row)
+        if (table[row].count.load(memory_order_relaxed)) return false;
+    return true;
+}
+
+void PerfTotals::reset() {
+    for (size_t row = 0; row < size; ++row) {
+        Row& r = table[row];
+        for (atomic<uint64_t>* n : {&r.count, &r.cycles, &r.instructions, &r.cacheMisses, &r.branchMisses, &r.scaled})
+            n->store(0, memory_order_relaxed);
+    }
+}
+
+void PerfScope::finish(size_t row) {
+    if (!on) return;
+    on = false;
+    PerfSample end;
+    if (!PerfCounters::read(end)) return;
+    PerfSample delta;
+    if (end.since(start, delta)) totals.add(row, delta);
+}
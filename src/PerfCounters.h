@@ -0,0 +1,92 @@
+// PerfCounters.h
+// hardware counters (cycles, instructions, cache misses, branch misses)
+// around every command and every routing search, opt-in with `Main --perf`
+//
+// every thread that measures something opens its own counter group with
+// perf_event_open the first time (user space only, this thread only), and a
+// measurement is one read() of the group before and one after. that's a
+// couple of syscalls a command, which is why it's off unless asked for
+// the differences are added up per row: CommandStats keeps one row per
+// command kind, SearchTotals one per kind of search (the Graph method), and
+// `stats` prints them next to the latencies
+// when the kernel has more counters to run than the PMU has room for it
+// takes turns (multiplexing); a group that only ran for part of a
+// measurement is scaled up by enabled / running time, like perf stat does,
+// and `stats` says how many measurements were scaled
+// off Linux (or when the kernel says no) nothing is counted
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+struct PerfSample {
+    uint64_t count = 0; // how many measurements were added up
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t cacheMisses = 0;
+    uint64_t branchMisses = 0;
+    uint64_t scaled = 0; // how many of those were multiplexed (and scaled up)
+    // a reading's times in ns: the group was enabled / actually counting
+    uint64_t timeEnabled = 0;
+    uint64_t timeRunning = 0;
+
+    PerfSample& operator+=(const PerfSample& other);
+
+    // the counts between reading start and this reading, scaled up if the
+    // group only counted for part of it; false if it never counted at all
+    bool since(const PerfSample& start, PerfSample& delta) const;
+};
+
+class PerfCounters {
+public:
+    // opens the counters on this thread to see whether they work, and if
+    // they do turns measuring on for every thread (error says why not)
+    static bool enable(string& error);
+    static void disable();
+    static bool enabled() { return switchedOn.load(memory_order_relaxed); }
+
+    // this thread's counters right now, false if they can't be read
+    static bool read(PerfSample& now);
+
+private:
+    static atomic<bool> switchedOn;
+};
+
+// the differences, added up per row (a few relaxed adds each)
+class PerfTotals {
+public:
+    explicit PerfTotals(size_t rows);
+    size_t rows() const { return size; }
+    void add(size_t row, const PerfSample& delta);
+    PerfSample total(size_t row) const;
+    bool empty() const;
+    void reset();
+
+private:
+    struct Row {
+        atomic<uint64_t> count{0}, cycles{0}, instructions{0}, cacheMisses{0}, branchMisses{0}, scaled{0};
+    };
+    size_t size;
+    unique_ptr<Row[]> table;
+};
+
+// measures from construction to finish() into one row (the row is picked
+// at the end, when it's known); never finished, nothing is added
+class PerfScope {
+public:
+    explicit PerfScope(PerfTotals& totals) : totals(totals) {
+        if (PerfCounters::enabled()) on = PerfCounters::read(start);
+    }
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+    void finish(size_t row);
+
+private:
+    PerfTotals& totals;
+    PerfSample start;
+    bool on = false;
+};
@@ -0,0 +1,270 @@
+#include "RoutingIndex.h"
+#include "CsvReader.h"
+#include "Snapshot.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <queue>
+
+// cache file layout (also the body of a snapshot's ROUTING section):
+//   RoutingCacheHeader
+//   ids[nodes]                int32, padded to 8 bytes
+//   dist[landmarks * nodes]   int32, UNREACHABLE for nodes a landmark can't reach
+
+namespace {
+
+constexpr char ROUTING_MAGIC[8] = {'C','A','M','P','R','O','U','T'};
+constexpr uint32_t ROUTING_VERSION = 2; // 1 was built over the open edges only
+
+struct RoutingCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    RoutingKey key;
+    uint32_t landmarks;
+    uint32_t nodes;
+    uint64_t checksum; // fingerprintBytes of everything after the header
+};
+
+size_t idsBytes(uint32_t nodes) { return (size_t(nodes) * 4 + 7) / 8 * 8; }
+
+// plain Dijkstra over the CSR copy, distances are capped at INT32_MAX
+// (capping can only shrink a difference, so the lower bounds stay valid)
+// returns false if cancelled
+bool distancesFrom(const RoutingTopology& topo, uint32_t source, int32_t* out, const atomic<bool>* cancel) {
+    const int64_t INF = numeric_limits<int64_t>::max();
+    size_t n = topo.ids.size();
+    vector<int64_t> dist(n, INF);
+    priority_queue<pair<int64_t,uint32_t>, vector<pair<int64_t,uint32_t>>, greater<pair<int64_t,uint32_t>>> pq;
+    dist[source] = 0;
+    pq.push({0, source});
+    size_t pops = 0;
+    while (!pq.empty()) {
+        auto [d, u] = pq.top(); pq.pop();
+        if (d > dist[u]) continue;
+        // look at the flag now and then, a cancelled build should stop quickly
+        if ((++pops & 4095) == 0 && cancel && cancel->load(memory_order_relaxed)) return false;
+        for (uint32_t k = topo.offsets[u]; k < topo.offsets[u + 1]; ++k) {
+            uint32_t v = topo.targets[k];
+            int64_t cand = d + topo.weights[k];
+            if (cand < dist[v]) {
+                dist[v] = cand;
+                pq.push({cand, v});
+            }
+        }
+    }
+    for (size_t i = 0; i < n; ++i)
+        out[i] = dist[i] == INF ? LandmarkIndex::UNREACHABLE
+                                : static_cast<int32_t>(min<int64_t>(dist[i], numeric_limits<int32_t>::max()));
+    return true;
+}
+
+} // namespace
+
+// build...
+// landmarks are picked "farthest first": start from the busiest node, then
+// keep taking the node farthest from every landmark so far
+// only nodes in the seed's component are candidates, other components get
+// no landmarks (queries there just see a bound of 0, same as Dijkstra)
+
+shared_ptr<LandmarkIndex> LandmarkIndex::build(const RoutingTopology& topo, const RoutingKey& key,
+                                               const atomic<bool>* cancel) {
+    auto index = make_shared<LandmarkIndex>();
+    index->key = key;
+    uint32_t n = static_cast<uint32_t>(topo.ids.size());
+    index->nodes = n;
+    index->ownedIds.assign(topo.ids.begin(), topo.ids.end());
+    index->ids = index->ownedIds.data();
+    if (n == 0) return index;
+
+    uint32_t seed = 0;
+    for (uint32_t i = 1; i < n; ++i)
+        if (topo.offsets[i + 1] - topo.offsets[i] > topo.offsets[seed + 1] - topo.offsets[seed]) seed = i;
+
+    vector<int32_t> scratch(n);
+    if (!distancesFrom(topo, seed, scratch.data(), cancel)) return nullptr;
+    // closest[v] = distance from v to the nearest landmark (or the seed)
+    vector<int32_t> closest(scratch);
+
+    index->ownedDist.reserve(size_t(MAX_LANDMARKS) * n);
+    for (uint32_t l = 0; l < MAX_LANDMARKS; ++l) {
+        uint32_t pick = n;
+        for (uint32_t i = 0; i < n; ++i)
+            if (closest[i] > 0 && (pick == n || closest[i] > closest[pick])) pick = i;
+        if (pick == n) break; // every reachable node is already a landmark
+
+        if (!distancesFrom(topo, pick, scratch.data(), cancel)) return nullptr;
+        index->ownedDist.insert(index->ownedDist.end(), scratch.begin(), scratch.end());
+        for (uint32_t i = 0; i < n; ++i)
+            if (scratch[i] != UNREACHABLE && scratch[i] < closest[i]) closest[i] = scratch[i];
+        ++index->landmarks;
+    }
+    index->dist = index->ownedDist.data();
+    return index;
+}
+
+int LandmarkIndex::slotOf(int nodeId) const {
+    const int32_t* end = ids + nodes;
+    const int32_t* it = lower_bound(ids, end, nodeId);
+    return it != end && *it == nodeId ? static_cast<int>(it - ids) : -1;
+}
+
+size_t LandmarkIndex::memoryBytes() const {
+    return sizeof(*this) + size_t(nodes) * 4 * (1 + landmarks);
+}
+
+void LandmarkIndex::serialize(string& out) const {
+    string body;
+    body.append(reinterpret_cast<const char*>(ids), size_t(nodes) * 4);
+    body.resize(idsBytes(nodes), '\0');
+    body.append(reinterpret_cast<const char*>(dist), size_t(landmarks) * nodes * 4);
+
+    RoutingCacheHeader header;
+    memcpy(header.magic, ROUTING_MAGIC, 8);
+    header.version = ROUTING_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.key = key;
+    header.landmarks = landmarks;
+    header.nodes = nodes;
+    header.checksum = fingerprintBytes(body);
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out += body;
+}
+
+// fromBytes checks everything before pointing into the bytes,
+// a truncated or stale file just gives nullptr
+
+shared_ptr<LandmarkIndex> LandmarkIndex::fromBytes(string_view bytes, shared_ptr<const void> keepAlive) {
+    RoutingCacheHeader header;
+    if (bytes.size() < sizeof(header)) return nullptr;
+    memcpy(&header, bytes.data(), sizeof(header));
+    if (memcmp(header.magic, ROUTING_MAGIC, 8) != 0) return nullptr;
+    if (header.version != ROUTING_VERSION || header.byteOrder != SNAPSHOT_BYTE_ORDER) return nullptr;
+    if (header.landmarks > MAX_LANDMARKS) return nullptr;
+
+    string_view body = bytes.substr(sizeof(header));
+    size_t need = idsBytes(header.nodes) + size_t(header.landmarks) * header.nodes * 4;
+    if (body.size() != need) return nullptr;
+    if (reinterpret_cast<uintptr_t>(body.data()) % alignof(int32_t) != 0) return nullptr;
+    if (fingerprintBytes(body) != header.checksum) return nullptr;
+
+    auto index = make_shared<LandmarkIndex>();
+    index->key = header.key;
+    index->landmarks = header.landmarks;
+    index->nodes = header.nodes;
+    index->ids = reinterpret_cast<const int32_t*>(body.data());
+    index->dist = reinterpret_cast<const int32_t*>(body.data() + idsBytes(header.nodes));
+    index->keepAlive = std::move(keepAlive);
+    return index;
+}
+
+shared_ptr<LandmarkIndex> LandmarkIndex::loadFile(const string& path) {
+    auto file = make_shared<MappedFile>();
+    if (!file->open(path)) return nullptr;
+    return fromBytes(file->contents(), file);
+}
+
+// written to a temp file and renamed, like the snapshots
+bool LandmarkIndex::saveFile(const string& path) const {
+    string bytes;
+    serialize(bytes);
+    string tmp = path + ".tmp";
+    {
+        ofstream out(tmp, ios::binary | ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+        if (!out) return false;
+    }
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+
+// RoutingManager...
+
+RoutingManager::~RoutingManager() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+        cancel.store(true);
+    }
+    wake.notify_all();
+    if (builder.joinable()) builder.join();
+}
+
+bool RoutingManager::tryLoadCache(const RoutingKey& key) {
+    if (cachePath.empty()) return false;
+    {
+        lock_guard<mutex> guard(lock);
+        if (cacheTriedValid && cacheTried == key) return false;
+        cacheTried = key;
+        cacheTriedValid = true;
+    }
+    shared_ptr<const LandmarkIndex> loaded = LandmarkIndex::loadFile(cachePath);
+    if (!loaded || loaded->getKey() != key) return false;
+    adopt(std::move(loaded));
+    return true;
+}
+
+void RoutingManager::requestBuild(const RoutingKey& key, function<RoutingTopology()> edges) {
+    shared_ptr<const LandmarkIndex> published = current();
+    if (published && published->getKey() == key) return;
+    lock_guard<mutex> guard(lock);
+    if (stopping) return;
+    if (buildRunning && building == key) {
+        haveQueued = false; // whatever was queued behind it is older
+        queuedEdges = nullptr;
+        cancel.store(false); // (if the build already gave up, the next miss asks again)
+        return;
+    }
+    if (haveQueued && queued == key) return;
+    if (buildRunning) cancel.store(true); // that build is for an older state
+    queued = key;
+    queuedEdges = std::move(edges);
+    haveQueued = true;
+    if (!builder.joinable()) builder = thread([this] { builderLoop(); });
+    wake.notify_one();
+}
+
+// takes the queued request, tries the cache file, else copies the edges and
+// builds; publishes first, then persists for the next run
+
+void RoutingManager::builderLoop() {
+    unique_lock<mutex> guard(lock);
+    for (;;) {
+        wake.wait(guard, [&] { return stopping || haveQueued; });
+        if (stopping) return;
+        RoutingKey key = queued;
+        function<RoutingTopology()> edges = std::move(queuedEdges);
+        queuedEdges = nullptr;
+        haveQueued = false;
+        building = key;
+        buildRunning = true;
+        cancel.store(false);
+        guard.unlock();
+
+        if (!tryLoadCache(key)) {
+            ++builds;
+            RoutingTopology topo = edges();
+            edges = nullptr; // lets go of the graph's edges before the long part
+            shared_ptr<LandmarkIndex> built = LandmarkIndex::build(topo, key, &cancel);
+            if (built && !cancel.load()) {
+                atomic_store(&index, shared_ptr<const LandmarkIndex>(built));
+                if (!cachePath.empty()) built->saveFile(cachePath);
+            }
+        }
+
+        guard.lock();
+        buildRunning = false;
+        if (!haveQueued) idle.notify_all();
+    }
+}
+
+void RoutingManager::adopt(shared_ptr<const LandmarkIndex> fresh) {
+    atomic_store(&index, std::move(fresh));
+}
+
+void RoutingManager::waitForBuild() {
+    unique_lock<mutex> guard(lock);
+    idle.wait(guard, [&] { return stopping || (!haveQueued && !buildRunning); });
+}
@@ -0,0 +1,164 @@
+// RoutingIndex.h
+// precomputed routing data for Graph: a landmark ("ALT") index
+//
+// we pick a few landmark nodes and store the distance from each landmark to
+// every node (every edge, open or closed). by the triangle inequality
+//     dist(v, t) >= |d(L, t) - d(L, v)|   for every landmark L
+// which is a lower bound A* can use to skip most of the graph
+//
+// closing an edge only makes paths longer, so those bounds still hold with
+// any set of edges closed, and A* over the open edges stays exact: the index
+// is keyed on the edges alone (edges.csv fingerprint, node/edge counts) and
+// a toggleEdgesClosure never makes it stale
+// it can be saved next to the data and mapped back in on the next start;
+// when it is stale the RoutingManager rebuilds it on a background thread
+// and Graph answers with plain Dijkstra until the new one is published
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// which engine answered a routing query
+enum class RoutingEngine { Dijkstra, Landmarks };
+
+struct RoutingKey {
+    uint64_t edgesFingerprint = 0;
+    uint64_t nodeCount = 0;
+    uint64_t edgeCount = 0;
+
+    bool operator==(const RoutingKey& o) const {
+        return edgesFingerprint == o.edgesFingerprint && nodeCount == o.nodeCount && edgeCount == o.edgeCount;
+    }
+    bool operator!=(const RoutingKey& o) const { return !(*this == o); }
+};
+
+// compact copy of the edges (CSR), the builder works on this so the
+// Graph can keep changing while a build runs
+struct RoutingTopology {
+    vector<int32_t> ids;      // sorted node ids
+    vector<uint32_t> offsets; // edges of ids[i] are [offsets[i], offsets[i+1])
+    vector<uint32_t> targets; // index into ids
+    vector<int32_t> weights;
+};
+
+class LandmarkIndex {
+public:
+    static constexpr uint32_t MAX_LANDMARKS = 8;
+    static constexpr int32_t UNREACHABLE = -1;
+    // lowerBound result when the two nodes can't reach each other at all
+    static constexpr int DISCONNECTED = 0x3FFFFFFF;
+
+    // builds the index, returns nullptr if cancel was set along the way
+    static shared_ptr<LandmarkIndex> build(const RoutingTopology& topo, const RoutingKey& key,
+                                           const atomic<bool>* cancel = nullptr);
+
+    // reads an index written by serialize, in place: the tables point into
+    // bytes, keepAlive owns them (a mapped file or a string)
+    static shared_ptr<LandmarkIndex> fromBytes(string_view bytes, shared_ptr<const void> keepAlive);
+
+    // cache files are just serialize() written out, loaded with mmap
+    static shared_ptr<LandmarkIndex> loadFile(const string& path);
+    bool saveFile(const string& path) const;
+    void serialize(string& out) const;
+
+    const RoutingKey& getKey() const { return key; }
+    size_t landmarkCount() const { return landmarks; }
+    size_t nodeCount() const { return nodes; }
+    size_t memoryBytes() const;
+
+    // position of node id in the tables, -1 if the index doesn't know it
+    int slotOf(int nodeId) const;
+
+    // lower bound on dist(from, to) using slots from slotOf
+    int lowerBound(int fromSlot, int toSlot) const {
+        if (fromSlot < 0 || toSlot < 0) return 0;
+        int best = 0;
+        for (uint32_t l = 0; l < landmarks; ++l) {
+            int32_t a = dist[size_t(l) * nodes + fromSlot], b = dist[size_t(l) * nodes + toSlot];
+            if ((a == UNREACHABLE) != (b == UNREACHABLE)) return DISCONNECTED;
+            if (a == UNREACHABLE) continue;
+            int d = a > b ? a - b : b - a;
+            if (d > best) best = d;
+        }
+        return best;
+    }
+
+private:
+    RoutingKey key;
+    uint32_t landmarks = 0;
+    uint32_t nodes = 0;
+    const int32_t* ids = nullptr;  // sorted node ids
+    const int32_t* dist = nullptr; // dist[l * nodes + slot]
+    vector<int32_t> ownedIds, ownedDist;
+    shared_ptr<const void> keepAlive;
+};
+
+// RoutingManager owns the current index and the background builder
+// everything here is safe to call from several threads
+//
+// the index is published like GraphStore publishes graphs (atomic_load /
+// atomic_store on the shared pointer), so a query never takes our lock.
+// builds run on one long-lived thread: a request only leaves the key and a
+// way to get the edges in a one-slot queue (only the newest state is worth
+// building, a newer request replaces one that hasn't started) and returns,
+// the edges are copied, the cache file tried and written on the builder
+class RoutingManager {
+public:
+    explicit RoutingManager(string cachePath = "") : cachePath(std::move(cachePath)) {}
+    ~RoutingManager();
+    RoutingManager(const RoutingManager&) = delete;
+    RoutingManager& operator=(const RoutingManager&) = delete;
+
+    // the published index (may be stale, compare its key), no lock
+    shared_ptr<const LandmarkIndex> current() const { return atomic_load(&index); }
+
+    // use the cache file if it was built for key
+    // (the file is only looked at once per key)
+    bool tryLoadCache(const RoutingKey& key);
+
+    // queue a build for key unless the published index, the running build or
+    // the queued one is for it already; a running build for another key is
+    // cancelled. never waits for the builder: edges() is called on the
+    // builder's thread (after it tried the cache file) for the CSR to build on
+    void requestBuild(const RoutingKey& key, function<RoutingTopology()> edges);
+
+    // publish an index we got some other way (snapshot)
+    void adopt(shared_ptr<const LandmarkIndex> index);
+
+    // blocks until nothing is queued or running (and the cache file is
+    // written), tests and shutdown
+    void waitForBuild();
+
+    const string& getCachePath() const { return cachePath; }
+    size_t buildsStarted() const { return builds.load(); }
+
+private:
+    void builderLoop();
+
+    string cachePath;
+    shared_ptr<const LandmarkIndex> index; // only through atomic_load / atomic_store
+    mutable mutex lock;                    // guards everything below
+    condition_variable wake;               // a request came in, or we're going away
+    condition_variable idle;               // the builder ran out of work
+    thread builder;                        // started by the first request
+    bool stopping = false;
+    function<RoutingTopology()> queuedEdges;
+    RoutingKey queued;      // key of the queued request
+    bool haveQueued = false;
+    RoutingKey building;    // key of the running build
+    bool buildRunning = false;
+    atomic<bool> cancel{false}; // the running build's flag, cleared when the next one starts
+    RoutingKey cacheTried;
+    bool cacheTriedValid = false;
+    atomic<size_t> builds{0};
+};
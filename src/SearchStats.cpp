@@ -0,0 +1,99 @@
+#include "SearchStats.h"
+#include <initializer_list>
+
+SearchStats& SearchStats::operator+=(const SearchStats& other) {
+    searches += other.searches;
+    nodesSettled += other.nodesSettled;
+    edgesRelaxed += other.edgesRelaxed;
+    heapPushes += other.heapPushes;
+    heapPops += other.heapPops;
+    stalePops += other.stalePops;
+    nanos += other.nanos;
+    subgraphNodes += other.subgraphNodes;
+    subgraphEdges += other.subgraphEdges;
+    return *this;
+}
+
+const char* searchName(SearchKind kind) {
+    static const char* const NAMES[SEARCH_KINDS] = {"dijkstra", "landmarks", "connectivity", "zone"};
+    size_t k = static_cast<size_t>(kind);
+    return k < SEARCH_KINDS ? NAMES[k] : "unknown";
+}
+
+SearchTotals& SearchTotals::global() {
+    static SearchTotals totals;
+    return totals;
+}
+
+void SearchTotals::add(SearchKind kind, const SearchStats& stats) {
+    if (!enabled()) return;
+    Row& row = rows[static_cast<size_t>(kind)];
+    row.searches.fetch_add(stats.searches, memory_order_relaxed);
+    row.nodesSettled.fetch_add(stats.nodesSettled, memory_order_relaxed);
+    row.edgesRelaxed.fetch_add(stats.edgesRelaxed, memory_order_relaxed);
+    row.heapPushes.fetch_add(stats.heapPushes, memory_order_relaxed);
+    row.heapPops.fetch_add(stats.heapPops, memory_order_relaxed);
+    row.stalePops.fetch_add(stats.stalePops, memory_order_relaxed);
+    row.nanos.fetch_add(stats.nanos, memory_order_relaxed);
+}
+
+SearchStats SearchTotals::total(SearchKind kind) const {
+    const Row& row = rows[static_cast<size_t>(kind)];
+    SearchStats s;
+    s.searches = row.searches.load(memory_order_relaxed);
+    s.nodesSettled = row.nodesSettled.load(memory_order_relaxed);
+    s.edgesRelaxed = row.edgesRelaxed.load(memory_order_relaxed);
+    s.heapPushes = row.heapPushes.load(memory_order_relaxed);
+    s.heapPops = row.heapPops.load(memory_order_relaxed);
+    s.stalePops = row.stalePops.load(memory_order_relaxed);
+    s.nanos = row.nanos.load(memory_order_relaxed);
+    return s;
+}
+
+void SearchTotals::reset() {
+    for (Row& row : rows) {
+        for (atomic<uint64_t>* n : {&row.searches, &row.nodesSettled, &row.edgesRelaxed, &row.heapPushes,
+                                    &row.heapPops, &row.stalePops, &row.nanos})
+            n->store(0, memory_order_relaxed);
+    }
+    perfTotals.reset();
+}
+
+static thread_local SearchCapture* innermost = nullptr;
+
+SearchCapture::SearchCapture() : outer(innermost) {
+    innermost = this;
+}
+
+SearchCapture::~SearchCapture() {
+    innermost = outer;
+    if (outer)
+        for (size_t k = 0; k < SEARCH_KINDS; ++k) outer->kinds[k] += kinds[k];
+}
+
+SearchCapture* SearchCapture::active() {
+    return innermost;
+}
+
+SearchStats SearchCapture::total() const {
+    SearchStats all;
+    for (const SearchStats& k : kinds) all += k;
+    return all;
+}
+
+SearchScope::SearchScope(SearchKind kind, SearchStats* caller)
+    : kind(kind), caller(caller), timed(caller || innermost || SearchTotals::global().enabled()),
+      counters(SearchTotals::global().perf()) {
+    counts.searches = 1;
+    if (timed) start = chrono::steady_clock::now();
+}
+
+SearchScope::~SearchScope() {
+    counters.finish(static_cast<size_t>(kind));
+    if (!timed) return;
+    counts.nanos = static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    if (caller) *caller = counts;
+    if (innermost) innermost->kinds[static_cast<size_t>(kind)] += counts;
+    SearchTotals::global().add(kind, counts);
+}
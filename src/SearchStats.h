@@ -0,0 +1,108 @@
+// SearchStats.h
+// how much work a routing query did: nodes settled, edges looked at, heap
+// traffic and time. Graph's dijkstra, isConnected, shortestTime and
+// computeStudentZoneCost take an optional SearchStats* to fill in (like
+// shortestTime's RoutingEngine*), and every search is also added to
+// SearchTotals::global() when that's on (Main turns it on, `stats` prints it)
+//
+// the counts are plain locals in the search, so they cost next to nothing;
+// the clock is only read when someone wants the numbers
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "PerfCounters.h"
+
+using namespace std;
+
+struct SearchStats {
+    uint64_t searches = 0;     // 1 for one query, more once added up
+    uint64_t nodesSettled = 0; // taken off the heap (or queue) for good
+    uint64_t edgesRelaxed = 0; // open edges looked at from a settled node
+    uint64_t heapPushes = 0;
+    uint64_t heapPops = 0;
+    uint64_t stalePops = 0;    // popped with an old distance, skipped
+    uint64_t nanos = 0;
+    // a zone's induced subgraph, what the MST ran on (not in the totals)
+    uint64_t subgraphNodes = 0;
+    uint64_t subgraphEdges = 0;
+
+    SearchStats& operator+=(const SearchStats& other);
+};
+
+// the rows of SearchTotals: one per search a caller can ask for
+// (shortestTime lands in the row of the engine that answered it, a zone's
+// dijkstras are in the zone row only)
+enum class SearchKind { Dijkstra, Landmarks, Connectivity, Zone };
+constexpr size_t SEARCH_KINDS = 4;
+const char* searchName(SearchKind kind);
+
+// everything added up since the start (or the last reset)
+// a few relaxed adds a search, nothing next to the search itself
+class SearchTotals {
+public:
+    static SearchTotals& global();
+
+    // off until enabled, add does nothing while off
+    void enable(bool on = true) { switchedOn.store(on, memory_order_relaxed); }
+    bool enabled() const { return switchedOn.load(memory_order_relaxed); }
+
+    void add(SearchKind kind, const SearchStats& stats);
+    SearchStats total(SearchKind kind) const;
+    void reset();
+
+    // hardware counters per kind of search (PerfCounters.h, only with --perf)
+    PerfTotals& perf() { return perfTotals; }
+    const PerfTotals& perf() const { return perfTotals; }
+
+private:
+    struct Row {
+        atomic<uint64_t> searches{0}, nodesSettled{0}, edgesRelaxed{0}, heapPushes{0}, heapPops{0},
+            stalePops{0}, nanos{0};
+    };
+    atomic<bool> switchedOn{false};
+    Row rows[SEARCH_KINDS];
+    PerfTotals perfTotals{SEARCH_KINDS};
+};
+
+// everything searched on this thread while it's alive, per kind of search
+// (what one command did, for the slow query log); captures nest, an inner
+// one hands its searches on to the outer one when it goes
+class SearchCapture {
+public:
+    SearchCapture();
+    ~SearchCapture();
+    SearchCapture(const SearchCapture&) = delete;
+    SearchCapture& operator=(const SearchCapture&) = delete;
+
+    // the capture searches on this thread are counted into, null if none
+    static SearchCapture* active();
+
+    SearchStats kinds[SEARCH_KINDS];
+    SearchStats total() const;
+
+private:
+    SearchCapture* outer;
+};
+
+// one search from start to return: the search counts into `counts`, the
+// destructor takes the time and hands the numbers to the caller's
+// SearchStats (overwritten), to the global totals and to the active
+// SearchCapture
+class SearchScope {
+public:
+    SearchScope(SearchKind kind, SearchStats* caller);
+    ~SearchScope();
+    SearchScope(const SearchScope&) = delete;
+    SearchScope& operator=(const SearchScope&) = delete;
+
+    SearchStats counts;
+
+private:
+    SearchKind kind;
+    SearchStats* caller;
+    bool timed;
+    chrono::steady_clock::time_point start;
+    PerfScope counters;
+};
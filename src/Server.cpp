@@ -0,0 +1,296 @@
+#include "Server.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define SERVER_HAS_EPOLL 1
+#endif
+
+CommandServer::CommandServer(GraphStore& store, size_t loopCount) : store(store) {
+    if (loopCount == 0) loopCount = max(1u, thread::hardware_concurrency());
+    for (size_t i = 0; i < loopCount; ++i) loops.push_back(make_unique<Loop>(store));
+}
+
+CommandServer::~CommandServer() {
+#ifdef SERVER_HAS_EPOLL
+    for (auto& loop : loops) {
+        for (auto& kv : loop->connections) ::close(kv.first);
+        if (loop->wakeFd >= 0) ::close(loop->wakeFd);
+        if (loop->epollFd >= 0) ::close(loop->epollFd);
+    }
+    if (listenFd >= 0) ::close(listenFd);
+    if (!unixPath.empty()) ::unlink(unixPath.c_str());
+#endif
+}
+
+#ifdef SERVER_HAS_EPOLL
+
+// listen...
+// the socket is made, bound and registered here, run() does the rest
+
+bool CommandServer::listen(const string& endpoint, string& error) {
+    if (endpoint.rfind("unix:", 0) == 0) {
+        string path = endpoint.substr(5);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            error = "bad socket path";
+            return false;
+        }
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        ::unlink(path.c_str()); // a socket left behind by an old run
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            error = string("can't bind ") + path + ": " + strerror(errno);
+            return false;
+        }
+        unixPath = path;
+    } else if (endpoint.rfind("tcp:", 0) == 0) {
+        int wanted = 0;
+        if (!parseIntField(endpoint.substr(4), wanted) || wanted < 0 || wanted > 65535) {
+            error = "bad port";
+            return false;
+        }
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(wanted));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // local clients only
+        listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int on = 1;
+        if (listenFd >= 0) setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            error = string("can't bind port ") + to_string(wanted) + ": " + strerror(errno);
+            return false;
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &len);
+        port = ntohs(addr.sin_port);
+    } else {
+        error = "endpoint must be unix:PATH or tcp:PORT";
+        return false;
+    }
+
+    if (::listen(listenFd, 128) != 0) {
+        error = string("listen failed: ") + strerror(errno);
+        return false;
+    }
+    // every loop waits on the listening socket, EPOLLEXCLUSIVE wakes just
+    // one of them per client instead of all (the others' accept would fail anyway)
+    for (auto& loop : loops) {
+        loop->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        loop->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (loop->epollFd < 0 || loop->wakeFd < 0) {
+            error = string("epoll setup failed: ") + strerror(errno);
+            return false;
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN | (loops.size() > 1 ? EPOLLEXCLUSIVE : 0);
+        ev.data.fd = listenFd;
+        epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+        ev.events = EPOLLIN;
+        ev.data.fd = loop->wakeFd;
+        epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, loop->wakeFd, &ev);
+    }
+    return true;
+}
+
+void CommandServer::run() {
+    if (loops.empty() || loops[0]->epollFd < 0) return;
+    vector<thread> others;
+    for (size_t i = 1; i < loops.size(); ++i) others.emplace_back([this, i]() { runLoop(*loops[i]); });
+    runLoop(*loops[0]);
+    for (thread& t : others) t.join();
+}
+
+void CommandServer::runLoop(Loop& loop) {
+    epoll_event events[64];
+    while (!stopping.load()) {
+        int n = epoll_wait(loop.epollFd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            uint32_t what = events[i].events;
+            if (fd == loop.wakeFd) {
+                uint64_t count;
+                while (::read(loop.wakeFd, &count, sizeof(count)) > 0) {}
+                continue;
+            }
+            if (fd == listenFd) { accept(loop); continue; }
+
+            auto it = loop.connections.find(fd);
+            if (it == loop.connections.end()) continue; // closed earlier in this round
+            if (what & EPOLLERR) { closeConnection(loop, fd); continue; }
+            if (what & (EPOLLIN | EPOLLHUP)) {
+                onReadable(loop, fd, it->second);
+                it = loop.connections.find(fd);
+                if (it == loop.connections.end()) continue;
+            }
+            if (what & EPOLLOUT) {
+                // catching up on output may let us run lines we held back
+                Connection& c = it->second;
+                if (!flushOutput(fd, c)) { closeConnection(loop, fd); continue; }
+                onReadable(loop, fd, c);
+            }
+        }
+    }
+    while (!loop.connections.empty()) closeConnection(loop, loop.connections.begin()->first);
+}
+
+void CommandServer::stop() {
+    stopping.store(true);
+    uint64_t one = 1;
+    for (auto& loop : loops) {
+        if (loop->wakeFd < 0) continue;
+        ssize_t ignored = ::write(loop->wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void CommandServer::accept(Loop& loop) {
+    for (;;) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return; // EAGAIN: taken them all
+        if (unixPath.empty()) {
+            int on = 1; // answers are small, don't let Nagle sit on them
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(loop.epollFd, EPOLL_CTL_ADD, fd, &ev);
+        loop.connections.emplace(fd, Connection());
+        ++openConnections;
+    }
+}
+
+// read what's there, run every complete line, write what we can
+// (also called after a write, when input may be waiting on output room)
+
+void CommandServer::onReadable(Loop& loop, int fd, Connection& c) {
+    bool peerClosed = false;
+    char block[65536];
+    while (c.reading && !c.closing && c.in.size() < MAX_BUFFERED) {
+        ssize_t n = ::read(fd, block, sizeof(block));
+        if (n > 0) { c.in.append(block, static_cast<size_t>(n)); continue; }
+        if (n == 0) { peerClosed = true; break; }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        closeConnection(loop, fd);
+        return;
+    }
+    if (peerClosed) c.closing = true;
+
+    for (;;) {
+        runLines(loop, c, c.closing);
+        // a line that doesn't fit in the input buffer will never finish
+        if (c.in.size() >= MAX_BUFFERED && c.in.find('\n') == string::npos) { closeConnection(loop, fd); return; }
+        if (!flushOutput(fd, c)) { closeConnection(loop, fd); return; }
+        // runLines stopped for output room and the socket took it all: go on
+        if (c.sent == c.out.size() && hasRunnableLine(c)) continue;
+        break;
+    }
+    bool allSent = c.sent == c.out.size();
+    if (c.closing && allSent && (c.quit || c.in.empty())) { closeConnection(loop, fd); return; }
+    updateEvents(loop, fd, c);
+}
+
+bool CommandServer::hasRunnableLine(const Connection& c) {
+    if (c.quit || c.in.empty()) return false;
+    return c.closing || c.in.find('\n') != string::npos;
+}
+
+// runs lines in order until the input runs out, or the output buffer is full
+// at eof the last line counts even without its newline, like the stdin loop
+
+void CommandServer::runLines(Loop& loop, Connection& c, bool atEof) {
+    size_t pos = 0;
+    while (!c.quit && c.out.size() - c.sent < MAX_BUFFERED) {
+        size_t nl = c.in.find('\n', pos);
+        size_t next;
+        if (nl == string::npos) {
+            if (!atEof || pos >= c.in.size()) break;
+            nl = next = c.in.size();
+        } else {
+            next = nl + 1;
+        }
+        string_view line = string_view(c.in).substr(pos, nl - pos);
+        pos = next;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        if (!line.empty() && line[0] == '#') {
+            if (line == "#frame") c.framed = true;
+            else if (line == "#quit") c.quit = true;
+            else loop.scratch.put("unsuccessful\n");
+        } else {
+            if (trace) trace->record(line);
+            runCommand(store, loop.reader, line, loop.scratch);
+        }
+        if (c.framed) loop.scratch.put(".\n");
+        loop.scratch.moveTo(c.out);
+        if (c.quit) { c.closing = true; break; } // the rest is ignored
+    }
+    c.in.erase(0, pos);
+}
+
+bool CommandServer::flushOutput(int fd, Connection& c) {
+    while (c.sent < c.out.size()) {
+        ssize_t n = ::send(fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+        if (n > 0) { c.sent += static_cast<size_t>(n); continue; }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        return false;
+    }
+    if (c.sent == c.out.size()) {
+        c.out.clear();
+        c.sent = 0;
+    } else if (c.sent > (size_t(1) << 20)) {
+        c.out.erase(0, c.sent); // don't let the written part pile up
+        c.sent = 0;
+    }
+    return true;
+}
+
+// EPOLLIN while we have room for more output, EPOLLOUT while output waits
+
+void CommandServer::updateEvents(Loop& loop, int fd, Connection& c) {
+    bool wantRead = !c.closing && c.out.size() - c.sent < MAX_BUFFERED;
+    bool wantWrite = c.sent < c.out.size();
+    if (wantRead == c.reading && wantWrite == c.writing) return;
+    c.reading = wantRead;
+    c.writing = wantWrite;
+    epoll_event ev{};
+    ev.events = (wantRead ? EPOLLIN : 0) | (wantWrite ? EPOLLOUT : 0);
+    ev.data.fd = fd;
+    epoll_ctl(loop.epollFd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void CommandServer::closeConnection(Loop& loop, int fd) {
+    epoll_ctl(loop.epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    loop.connections.erase(fd);
+    --openConnections;
+}
+
+#else
+
+bool CommandServer::listen(const string&, string& error) {
+    error = "server mode needs Linux (epoll)";
+    return false;
+}
+void CommandServer::run() {}
+void CommandServer::stop() { stopping.store(true); }
+
+#endif
@@ -0,0 +1,109 @@
+// Server.h
+// the --serve mode of main.cpp: one GraphStore stays loaded (with its routing
+// cache) and clients send the same command lines over a socket
+//
+// endpoints: "unix:/path/to.sock" or "tcp:PORT" (bound to 127.0.0.1 only,
+// PORT 0 picks a free one)
+//
+// every loop thread runs its own epoll loop over its own connections (they
+// all wait on the listening socket, the kernel wakes one per new client).
+// a client can pipeline as many lines as it likes, each complete line is run
+// in order and its output goes into that connection's output buffer, which
+// is written as the socket allows. a client that stops reading its answers
+// stops being read until it catches up
+//
+// queries read the store's current version and never wait, a mutation
+// publishes a new version (GraphStore.h), so the loops only meet when two
+// clients change the graph at the same time
+//
+// the output of a command is exactly what the stdin loop prints. two
+// server-only lines start with '#':
+//   #frame   from now on every answer ends with a line "." (so a client
+//            knows where a multi-line answer stops), answered with "."
+//   #quit    close the connection once the pending output is written
+//
+// the event loop needs Linux (epoll), elsewhere listen() just fails
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "GraphStore.h"
+#include "Commands.h"
+#include "CommandTrace.h"
+
+using namespace std;
+
+class CommandServer {
+public:
+    // a connection's unread input / unsent output may grow to this much
+    static constexpr size_t MAX_BUFFERED = size_t(16) << 20;
+
+    // loops = 0 means one per hardware thread
+    explicit CommandServer(GraphStore& store, size_t loops = 1);
+    ~CommandServer();
+    CommandServer(const CommandServer&) = delete;
+    CommandServer& operator=(const CommandServer&) = delete;
+
+    // false with a message in error if the endpoint can't be set up
+    bool listen(const string& endpoint, string& error);
+    int boundPort() const { return port; }
+
+    // serves until stop(), then closes every connection
+    // the calling thread runs the first loop, the others get their own
+    void run();
+
+    // safe to call from a signal handler or another thread
+    void stop();
+
+    // every command line from every client goes into trace too (--record)
+    // set it before run()
+    void setTrace(TraceWriter* writer) { trace = writer; }
+
+    size_t connectionCount() const { return openConnections.load(); }
+    size_t loopCount() const { return loops.size(); }
+
+private:
+    struct Connection {
+        string in;          // bytes read but not run yet
+        string out;         // answers not written yet
+        size_t sent = 0;    // how much of out is already written
+        bool framed = false;
+        bool quit = false;     // got #quit, nothing after it runs
+        bool closing = false;  // #quit or the peer closed its side
+        bool reading = true;   // EPOLLIN is on
+        bool writing = false;  // EPOLLOUT is on
+    };
+
+    // everything one loop thread owns, no other thread touches it
+    struct Loop {
+        explicit Loop(GraphStore& store) : reader(store) {}
+        int epollFd = -1;
+        int wakeFd = -1;
+        unordered_map<int, Connection> connections;
+        GraphStore::Reader reader;
+        OutputBuffer scratch{nullptr, 0};
+    };
+
+    void runLoop(Loop& loop);
+    void accept(Loop& loop);
+    void onReadable(Loop& loop, int fd, Connection& c);
+    void runLines(Loop& loop, Connection& c, bool atEof);
+    static bool hasRunnableLine(const Connection& c);
+    bool flushOutput(int fd, Connection& c);
+    void updateEvents(Loop& loop, int fd, Connection& c);
+    void closeConnection(Loop& loop, int fd);
+
+    GraphStore& store;
+    vector<unique_ptr<Loop>> loops;
+    int listenFd = -1;
+    int port = 0;
+    string unixPath;
+    atomic<bool> stopping{false};
+    atomic<size_t> openConnections{0};
+    TraceWriter* trace = nullptr;
+};
@@ -0,0 +1,679 @@
+#include "ShmChannel.h"
+#include "CommandStats.h"
+#include <climits>
+#include <cstring>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define SHM_HAS_FUTEX 1
+#endif
+
+// the region starts with this, then the request ring's bytes, then the reply ring's
+struct ShmChannel::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t ringBytes;
+    alignas(64) atomic<uint32_t> closed{0};
+    ShmRingControl requests;
+    ShmRingControl replies;
+};
+
+static const char SHM_MAGIC[8] = {'C', 'A', 'M', 'P', 'S', 'H', 'M', '1'};
+static const uint32_t SHM_VERSION = 2; // 1 had no messages over one frame
+
+size_t ShmChannel::headerBytes() {
+    return (sizeof(ShmChannel::Header) + 63) / 64 * 64;
+}
+
+// sleeping and waking...
+// a sleeper always wakes up after a while on its own, so a close that
+// slipped in between its last check and the wait can't leave it hanging
+
+static void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static void sleepWhile(atomic<uint32_t>& word, uint32_t value) {
+#ifdef SHM_HAS_FUTEX
+    timespec timeout{0, 50 * 1000 * 1000};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, value, &timeout, nullptr, 0);
+#else
+    (void)word;
+    (void)value;
+#endif
+}
+
+static void wake(atomic<uint32_t>& word) {
+#ifdef SHM_HAS_FUTEX
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+
+// the rings...
+// positions only ever grow, the byte for position p is data[p & (size - 1)]
+// a frame may wrap around the end, copyIn / copyOut split it
+
+void SpscRing::copyIn(uint32_t at, const char* from, uint32_t n) {
+    uint32_t offset = at & (size - 1);
+    uint32_t first = min(n, size - offset);
+    memcpy(data + offset, from, first);
+    memcpy(data, from + first, n - first);
+}
+
+void SpscRing::copyOut(uint32_t at, char* to, uint32_t n) const {
+    uint32_t offset = at & (size - 1);
+    uint32_t first = min(n, size - offset);
+    memcpy(to, data + offset, first);
+    memcpy(to + first, data, n - first);
+}
+
+// the sleeping flag goes up before the last look at the other counter, and
+// the other side moves its counter before it looks at the flag, so one of
+// us always sees the other (both are seq_cst)
+
+bool SpscRing::pushFrame(string_view piece, bool more, uint32_t spins) {
+    uint32_t need = static_cast<uint32_t>(piece.size()) + 4;
+    uint32_t head = control->head.load(memory_order_relaxed); // only we write it
+    for (uint32_t spun = 0;;) {
+        if (closed->load()) return false;
+        uint32_t tail = control->tail.load(memory_order_acquire);
+        if (size - (head - tail) >= need) break;
+        if (spun < spins) { ++spun; cpuRelax(); continue; }
+        control->producerSleeping.store(1);
+        tail = control->tail.load();
+        if (size - (head - tail) < need && !closed->load()) sleepWhile(control->tail, tail);
+        control->producerSleeping.store(0, memory_order_relaxed);
+    }
+    uint32_t length = static_cast<uint32_t>(piece.size()) | (more ? MORE_FRAMES : 0);
+    copyIn(head, reinterpret_cast<const char*>(&length), 4);
+    copyIn(head + 4, piece.data(), static_cast<uint32_t>(piece.size()));
+    control->head.store(head + need);
+    if (control->consumerSleeping.load()) wake(control->head);
+    return true;
+}
+
+bool SpscRing::popFrame(string& body, bool keep, bool& more, uint32_t spins) {
+    uint32_t tail = control->tail.load(memory_order_relaxed); // only we write it
+    uint32_t head;
+    for (uint32_t spun = 0;;) {
+        head = control->head.load(memory_order_acquire);
+        if (head != tail) break;
+        if (closed->load()) return false; // (frames already there still go out)
+        if (spun < spins) { ++spun; cpuRelax(); continue; }
+        control->consumerSleeping.store(1);
+        head = control->head.load();
+        if (head == tail && !closed->load()) sleepWhile(control->head, head);
+        control->consumerSleeping.store(0, memory_order_relaxed);
+    }
+    uint32_t length;
+    copyOut(tail, reinterpret_cast<char*>(&length), 4);
+    more = (length & MORE_FRAMES) != 0;
+    length &= ~MORE_FRAMES;
+    if (length > head - tail - 4) return false; // the other side wrote garbage
+    if (keep) {
+        size_t at = body.size();
+        body.resize(at + length);
+        copyOut(tail + 4, &body[at], length);
+    }
+    control->tail.store(tail + 4 + length);
+    if (control->producerSleeping.load()) wake(control->tail);
+    return true;
+}
+
+// a message longer than a frame goes in maxFrame() pieces, every one but
+// the last with MORE_FRAMES in its length. the consumer takes the pieces
+// as they come, so the message can be bigger than the whole ring
+
+bool SpscRing::push(string_view body, uint32_t spins) {
+    while (body.size() > maxFrame()) {
+        if (!pushFrame(body.substr(0, maxFrame()), true, spins)) return false;
+        body.remove_prefix(maxFrame());
+    }
+    return pushFrame(body, false, spins);
+}
+
+bool SpscRing::pop(string& body, uint32_t spins, size_t maxBytes) {
+    body.clear();
+    bool keep = true, more = true;
+    while (more) {
+        if (!popFrame(body, keep, more, spins)) return false;
+        if (body.size() > maxBytes) { // too long, the rest is read past and dropped
+            body.clear();
+            keep = false;
+        }
+    }
+    return true;
+}
+
+void SpscRing::wakeAll() {
+    wake(control->head);
+    wake(control->tail);
+}
+
+
+// the region...
+
+#ifdef SHM_HAS_FUTEX
+
+static string shmName(const string& name) {
+    return name.empty() || name[0] == '/' ? name : "/" + name;
+}
+
+bool ShmChannel::map(int fd, size_t bytes, string& error) {
+    void* at = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (at == MAP_FAILED) {
+        error = string("mmap failed: ") + strerror(errno);
+        return false;
+    }
+    header = static_cast<Header*>(at);
+    mappedBytes = bytes;
+    return true;
+}
+
+unique_ptr<ShmChannel> ShmChannel::create(const string& name, string& error, uint32_t ringBytes) {
+    uint32_t size = 4096;
+    while (size < ringBytes && size < (uint32_t(1) << 30)) size <<= 1;
+    size_t total = headerBytes() + size_t(size) * 2;
+
+    unique_ptr<ShmChannel> channel(new ShmChannel());
+    if (name.empty()) {
+        channel->fileFd = memfd_create("campus-shm", MFD_CLOEXEC);
+    } else {
+        channel->ownedName = shmName(name);
+        shm_unlink(channel->ownedName.c_str()); // left over from an old run
+        channel->fileFd = shm_open(channel->ownedName.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+    }
+    if (channel->fileFd < 0 || ftruncate(channel->fileFd, static_cast<off_t>(total)) != 0) {
+        error = string("can't make the shared region: ") + strerror(errno);
+        return nullptr;
+    }
+    if (!channel->map(channel->fileFd, total, error)) return nullptr;
+
+    Header* h = new (channel->header) Header();
+    h->version = SHM_VERSION;
+    h->ringBytes = size;
+    memcpy(h->magic, SHM_MAGIC, 8); // last, an attach before this sees no channel
+    return channel;
+}
+
+unique_ptr<ShmChannel> ShmChannel::attach(const string& name, string& error) {
+    unique_ptr<ShmChannel> channel(new ShmChannel());
+    channel->fileFd = shm_open(shmName(name).c_str(), O_RDWR | O_CLOEXEC, 0);
+    struct stat st;
+    if (channel->fileFd < 0 || fstat(channel->fileFd, &st) != 0) {
+        error = string("can't open ") + name + ": " + strerror(errno);
+        return nullptr;
+    }
+    size_t total = static_cast<size_t>(st.st_size);
+    if (total < headerBytes()) {
+        error = "not a channel";
+        return nullptr;
+    }
+    if (!channel->map(channel->fileFd, total, error)) return nullptr;
+    const Header* h = channel->header;
+    if (memcmp(h->magic, SHM_MAGIC, 8) != 0 || h->version != SHM_VERSION ||
+        headerBytes() + size_t(h->ringBytes) * 2 != total) {
+        error = "not a channel (or another version)";
+        return nullptr;
+    }
+    return channel;
+}
+
+ShmChannel::~ShmChannel() {
+    if (header) munmap(header, mappedBytes);
+    if (fileFd >= 0) ::close(fileFd);
+    if (!ownedName.empty()) shm_unlink(ownedName.c_str());
+}
+
+#else
+
+unique_ptr<ShmChannel> ShmChannel::create(const string&, string& error, uint32_t) {
+    error = "shared memory channels need Linux (futex)";
+    return nullptr;
+}
+
+unique_ptr<ShmChannel> ShmChannel::attach(const string&, string& error) {
+    error = "shared memory channels need Linux (futex)";
+    return nullptr;
+}
+
+ShmChannel::~ShmChannel() {}
+
+bool ShmChannel::map(int, size_t, string&) { return false; }
+
+#endif
+
+SpscRing ShmChannel::requests() {
+    char* base = reinterpret_cast<char*>(header) + headerBytes();
+    return SpscRing(&header->requests, base, header->ringBytes, &header->closed);
+}
+
+SpscRing ShmChannel::replies() {
+    char* base = reinterpret_cast<char*>(header) + headerBytes() + header->ringBytes;
+    return SpscRing(&header->replies, base, header->ringBytes, &header->closed);
+}
+
+void ShmChannel::close() {
+    header->closed.store(1);
+    requests().wakeAll();
+    replies().wakeAll();
+}
+
+bool ShmChannel::isClosed() const {
+    return header->closed.load() != 0;
+}
+
+
+// the binary commands...
+// little helpers to put fixed size values and short texts into a body
+// and to take them out again (a Cursor that runs out just stops being ok)
+
+template <class T>
+static void putRaw(string& body, T value) {
+    body.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void putText(string& body, string_view text) {
+    putRaw(body, static_cast<uint16_t>(text.size()));
+    body.append(text.data(), text.size());
+}
+
+namespace {
+struct Cursor {
+    string_view rest;
+    bool ok = true;
+
+    template <class T>
+    T get() {
+        T value{};
+        if (rest.size() < sizeof(T)) { ok = false; return value; }
+        memcpy(&value, rest.data(), sizeof(T));
+        rest.remove_prefix(sizeof(T));
+        return value;
+    }
+    string_view text() {
+        uint16_t n = get<uint16_t>();
+        if (!ok || rest.size() < n) { ok = false; return string_view(); }
+        string_view t = rest.substr(0, n);
+        rest.remove_prefix(n);
+        return t;
+    }
+};
+} // namespace
+
+static UFIDKey unpackUFID(uint32_t value) {
+    UFIDKey key;
+    key.value = value;
+    return key;
+}
+
+// a class code longer than a text can hold is never a valid code, "" says the same
+static string_view codeText(string_view code) {
+    return code.size() > UINT16_MAX ? string_view() : code;
+}
+
+bool encodeCommand(string_view line, string& request, size_t maxFrame) {
+    request.clear();
+    CommandTokenizer tok(line);
+    string_view cmd;
+    tok.word(cmd);
+    CommandKind kind = line.empty() ? CommandKind::Unknown : commandKindOf(cmd);
+    request.push_back(static_cast<char>(kind));
+    auto reject = [&]() {
+        request.assign(1, static_cast<char>(CommandKind::Unknown));
+        return true;
+    };
+
+    switch (kind) {
+    case CommandKind::Insert: {
+        string_view name, ufid;
+        int residence, n;
+        tok.name(name);
+        if (!tok.word(ufid) || !tok.integer(residence) || !tok.integer(n)) return reject();
+        if (n < 1 || n > Student::MAX_CLASSES || name.size() > UINT16_MAX) return reject();
+        string_view classes[Student::MAX_CLASSES];
+        int got = 0;
+        while (got < n && tok.word(classes[got])) ++got;
+        if (got != n) return reject();
+        putText(request, name);
+        putRaw(request, UFIDKey(ufid).value);
+        putRaw(request, static_cast<int32_t>(residence));
+        putRaw(request, static_cast<uint8_t>(n));
+        for (int k = 0; k < n; ++k) putText(request, codeText(classes[k]));
+        break;
+    }
+    case CommandKind::Remove:
+    case CommandKind::PrintShortestEdges:
+    case CommandKind::PrintStudentZone: {
+        string_view ufid;
+        tok.word(ufid);
+        putRaw(request, UFIDKey(ufid).value);
+        break;
+    }
+    case CommandKind::DropClass: {
+        string_view ufid, code;
+        tok.word(ufid);
+        tok.word(code);
+        putRaw(request, UFIDKey(ufid).value);
+        putText(request, codeText(code));
+        break;
+    }
+    case CommandKind::ReplaceClass: {
+        string_view ufid, oldC, newC;
+        tok.word(ufid);
+        tok.word(oldC);
+        tok.word(newC);
+        putRaw(request, UFIDKey(ufid).value);
+        putText(request, codeText(oldC));
+        putText(request, codeText(newC));
+        break;
+    }
+    case CommandKind::RemoveClass: {
+        string_view code;
+        tok.word(code);
+        putText(request, codeText(code));
+        break;
+    }
+    case CommandKind::ToggleEdgesClosure: {
+        int count;
+        tok.integer(count);
+        if (count < 0) count = 0;
+        if (5 + size_t(count) * 8 > maxFrame) return false;
+        putRaw(request, static_cast<uint32_t>(count));
+        for (int k = 0; k < count; ++k) {
+            int a, b;
+            tok.integer(a);
+            tok.integer(b);
+            putRaw(request, static_cast<int32_t>(a));
+            putRaw(request, static_cast<int32_t>(b));
+        }
+        break;
+    }
+    case CommandKind::CheckEdgeStatus:
+    case CommandKind::IsConnected: {
+        int a, b;
+        tok.integer(a);
+        tok.integer(b);
+        putRaw(request, static_cast<int32_t>(a));
+        putRaw(request, static_cast<int32_t>(b));
+        break;
+    }
+    case CommandKind::Explain: {
+        // the wrapped command goes as its text, the server runs it like a text line
+        string_view command = tok.remaining();
+        if (command.size() > UINT16_MAX) return reject();
+        putText(request, command);
+        break;
+    }
+    default:
+        break;
+    }
+    return request.size() <= maxFrame;
+}
+
+string decodeCommand(string_view request) {
+    CommandKind kind = request.empty() ? CommandKind::Unknown : static_cast<CommandKind>(request[0]);
+    Cursor in{request.substr(request.empty() ? 0 : 1)};
+    string line = commandName(kind);
+    auto word = [&](string_view w) {
+        line += ' ';
+        line.append(w.data(), w.size());
+    };
+    auto ufid = [&]() { word(formatUFID(in.get<uint32_t>())); };
+    auto number = [&]() { word(to_string(in.get<int32_t>())); };
+
+    switch (kind) {
+    case CommandKind::Insert: {
+        string_view name = in.text();
+        line += " \"";
+        line.append(name.data(), name.size());
+        line += '"';
+        ufid();
+        number();
+        size_t n = in.get<uint8_t>();
+        word(to_string(n));
+        for (size_t k = 0; k < n && in.ok; ++k) word(in.text());
+        break;
+    }
+    case CommandKind::Remove:
+    case CommandKind::PrintShortestEdges:
+    case CommandKind::PrintStudentZone:
+        ufid();
+        break;
+    case CommandKind::DropClass:
+        ufid();
+        word(in.text());
+        break;
+    case CommandKind::ReplaceClass:
+        ufid();
+        word(in.text());
+        word(in.text());
+        break;
+    case CommandKind::RemoveClass:
+        word(in.text());
+        break;
+    case CommandKind::ToggleEdgesClosure: {
+        uint32_t count = in.get<uint32_t>();
+        word(to_string(count));
+        for (uint32_t k = 0; k < count && in.ok; ++k) {
+            number();
+            number();
+        }
+        break;
+    }
+    case CommandKind::CheckEdgeStatus:
+    case CommandKind::IsConnected:
+        number();
+        number();
+        break;
+    case CommandKind::Explain:
+        word(in.text());
+        break;
+    default:
+        break;
+    }
+    return line;
+}
+
+// the answers: a status byte for the yes/no commands (and 0/1/2 for an
+// edge's open/closed/DNE), the count for removeClass, the text for the prints (and stats)
+
+static CommandKind requestKind(string_view request) {
+    if (request.empty() || static_cast<uint8_t>(request[0]) > static_cast<uint8_t>(CommandKind::Unknown))
+        return CommandKind::Unknown;
+    return static_cast<CommandKind>(request[0]);
+}
+
+void runBinaryCommand(GraphStore& store, GraphStore::Reader& reader, string_view request, string& reply) {
+    CommandTimer timer; // counted in the stats (and the slow log) like a text command
+    SearchCapture searches;
+    reply.clear();
+    CommandKind kind = requestKind(request);
+    Cursor in{request.substr(request.empty() ? 0 : 1)};
+    bool worked = true;
+    auto status = [&](bool ok) {
+        reply.push_back(ok ? 1 : 0);
+        worked = ok;
+    };
+
+    switch (kind) {
+    case CommandKind::Insert: {
+        string_view name = in.text();
+        UFIDKey ufid = unpackUFID(in.get<uint32_t>());
+        int residence = in.get<int32_t>();
+        size_t n = in.get<uint8_t>();
+        string_view classes[Student::MAX_CLASSES];
+        if (n < 1 || n > Student::MAX_CLASSES) in.ok = false;
+        for (size_t k = 0; k < n && in.ok; ++k) classes[k] = in.text();
+        if (!in.ok) { status(false); break; }
+        status(store.update([&](Graph& g) { return g.addStudent(name, ufid, classes, n, residence); }));
+        break;
+    }
+    case CommandKind::Remove: {
+        UFIDKey ufid = unpackUFID(in.get<uint32_t>());
+        status(in.ok && store.update([&](Graph& g) { return g.removeStudent(ufid); }));
+        break;
+    }
+    case CommandKind::DropClass: {
+        UFIDKey ufid = unpackUFID(in.get<uint32_t>());
+        string_view code = in.text();
+        status(in.ok && store.update([&](Graph& g) { return g.dropClass(ufid, code); }));
+        break;
+    }
+    case CommandKind::ReplaceClass: {
+        UFIDKey ufid = unpackUFID(in.get<uint32_t>());
+        string_view oldC = in.text(), newC = in.text();
+        status(in.ok && store.update([&](Graph& g) { return g.replaceClass(ufid, oldC, newC); }));
+        break;
+    }
+    case CommandKind::RemoveClass: {
+        string_view code = in.text();
+        int32_t count = in.ok ? store.update([&](Graph& g) { return g.removeClass(code); }) : 0;
+        putRaw(reply, count);
+        worked = in.ok;
+        break;
+    }
+    case CommandKind::ToggleEdgesClosure: {
+        uint32_t count = in.get<uint32_t>();
+        if (!in.ok || in.rest.size() / 8 < count) { status(false); break; }
+        vector<pair<int,int>> pairs(count);
+        for (auto& p : pairs) {
+            p.first = in.get<int32_t>();
+            p.second = in.get<int32_t>();
+        }
+        status(store.update([&](Graph& g) { return g.toggleEdgesClosure(pairs); }));
+        break;
+    }
+    case CommandKind::CheckEdgeStatus: {
+        int a = in.get<int32_t>(), b = in.get<int32_t>();
+        string s = reader.get().checkEdgeStatus(a, b);
+        reply.push_back(s == "open" ? 0 : s == "closed" ? 1 : 2);
+        break;
+    }
+    case CommandKind::IsConnected: {
+        int a = in.get<int32_t>(), b = in.get<int32_t>();
+        status(reader.get().isConnected(a, b));
+        break;
+    }
+    case CommandKind::PrintShortestEdges:
+    case CommandKind::PrintStudentZone: {
+        UFIDKey ufid = unpackUFID(in.get<uint32_t>());
+        OutputBuffer text(nullptr, 0);
+        if (kind == CommandKind::PrintShortestEdges) putShortestEdges(reader.get(), ufid, text);
+        else putStudentZone(reader.get(), ufid, text);
+        text.moveTo(reply);
+        break;
+    }
+    case CommandKind::Stats: {
+        OutputBuffer text(nullptr, 0);
+        CommandStats::global().print(text);
+        printSearchTotals(SearchTotals::global(), text);
+        text.moveTo(reply);
+        break;
+    }
+    case CommandKind::SlowLog: {
+        OutputBuffer text(nullptr, 0);
+        SlowQueryLog::global().print(text);
+        text.moveTo(reply);
+        break;
+    }
+    case CommandKind::Explain: {
+        string_view command = in.text();
+        OutputBuffer text(nullptr, 0);
+        worked = in.ok && runUntimed(store, reader, "explain " + string(command), text);
+        text.moveTo(reply);
+        break;
+    }
+    default:
+        status(false);
+        break;
+    }
+    uint64_t took = timer.finish(kind, worked);
+    SlowQueryLog& slow = SlowQueryLog::global();
+    if (slow.enabled() && took >= slow.thresholdNanos())
+        slow.note(reader.get(), decodeCommand(request), kind, worked, took, searches);
+}
+
+void formatReply(string_view request, string_view reply, OutputBuffer& out) {
+    CommandKind kind = requestKind(request);
+    Cursor in{reply};
+    switch (kind) {
+    case CommandKind::RemoveClass:
+        out.putInt(in.get<int32_t>());
+        out.put('\n');
+        break;
+    case CommandKind::CheckEdgeStatus: {
+        uint8_t s = in.get<uint8_t>();
+        out.put(s == 0 ? "open\n" : s == 1 ? "closed\n" : "DNE\n");
+        break;
+    }
+    case CommandKind::PrintShortestEdges:
+    case CommandKind::PrintStudentZone:
+    case CommandKind::Stats:
+    case CommandKind::SlowLog:
+    case CommandKind::Explain:
+        out.put(reply);
+        break;
+    default:
+        out.put(in.get<uint8_t>() ? "successful\n" : "unsuccessful\n");
+        break;
+    }
+}
+
+
+// both ends...
+
+ShmServer::ShmServer(GraphStore& store, ShmChannel& channel, uint32_t spins)
+    : store(store), channel(channel), spins(spins) {}
+
+void ShmServer::run() {
+    SpscRing in = channel.requests(), out = channel.replies();
+    GraphStore::Reader reader(store);
+    string request, reply;
+    // a request is one frame at most (encodeCommand makes no bigger ones),
+    // a longer one comes out empty and is answered as unknown. replies can
+    // be any length, a long print goes in several frames
+    while (in.pop(request, spins, in.maxFrame())) {
+        runBinaryCommand(store, reader, request, reply);
+        if (!out.push(reply, spins)) break; // closed
+    }
+}
+
+bool ShmClient::roundTrip(string_view body, string& answer) {
+    return channel.requests().push(body, spins) && channel.replies().pop(answer, spins);
+}
+
+int ShmClient::checkEdgeStatus(int u, int v) {
+    request.assign(1, static_cast<char>(CommandKind::CheckEdgeStatus));
+    putRaw(request, static_cast<int32_t>(u));
+    putRaw(request, static_cast<int32_t>(v));
+    if (!roundTrip(request, reply) || reply.size() != 1) return -1;
+    return static_cast<uint8_t>(reply[0]);
+}
+
+int ShmClient::isConnected(int src, int dst) {
+    request.assign(1, static_cast<char>(CommandKind::IsConnected));
+    putRaw(request, static_cast<int32_t>(src));
+    putRaw(request, static_cast<int32_t>(dst));
+    if (!roundTrip(request, reply) || reply.size() != 1) return -1;
+    return reply[0] ? 1 : 0;
+}
+
+bool ShmClient::call(string_view line, OutputBuffer& out) {
+    if (!encodeCommand(line, request, channel.requests().maxFrame())) return false;
+    if (!roundTrip(request, reply)) return false;
+    formatReply(request, reply, out);
+    return true;
+}
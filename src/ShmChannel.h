@@ -0,0 +1,162 @@
+// ShmChannel.h
+// the --shm mode of main.cpp: a client on the same machine talks to the
+// graph through shared memory instead of a socket
+//
+// the region (shm_open'd by name, or an anonymous memfd) holds two
+// single-producer / single-consumer byte rings, requests one way and
+// replies the other. each side only ever moves its own counter (the
+// producer the head, the consumer the tail), so neither needs a lock.
+// a side with nothing to do spins for a while if asked to (spins), then
+// sleeps on a futex over the other side's counter; the other side only
+// makes the wake call when somebody is actually asleep
+//
+// every message is a frame: u32 length, then the body (a message longer
+// than a frame goes as several, the length's top bit says more follow,
+// so a reply can be longer than the ring). a request body is
+// a CommandKind byte and that command's arguments in binary (ints as i32,
+// ufids packed, text as u16 length + bytes), a reply body is the answer
+// in binary (a status byte, a count, or the text for the two print commands)
+// encodeCommand / formatReply turn a command line into a request and a
+// reply back into exactly what main.cpp would print for that line
+//
+// one client at a time per region (the rings are single producer)
+// Linux only (futex, memfd), elsewhere create/attach just fail
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "Commands.h"
+#include "GraphStore.h"
+
+using namespace std;
+
+// the control words of one ring, they live in the shared region
+// head/tail count bytes since the start and wrap at 2^32
+struct ShmRingControl {
+    alignas(64) atomic<uint32_t> head{0};        // written by the producer
+    atomic<uint32_t> consumerSleeping{0};
+    alignas(64) atomic<uint32_t> tail{0};        // written by the consumer
+    atomic<uint32_t> producerSleeping{0};
+};
+
+static_assert(atomic<uint32_t>::is_always_lock_free, "the rings need lock-free 32 bit atomics");
+
+// one direction of the channel
+class SpscRing {
+public:
+    SpscRing(ShmRingControl* control, char* data, uint32_t size, const atomic<uint32_t>* closed)
+        : control(control), data(data), size(size), closed(closed) {}
+
+    static constexpr uint32_t MORE_FRAMES = uint32_t(1) << 31; // in a frame's length
+
+    // the longest frame body that fits
+    uint32_t maxFrame() const { return size - 4; }
+
+    // blocks until the whole message is in (or the channel is closed, then false)
+    bool push(string_view body, uint32_t spins);
+
+    // blocks until a whole message is there (or the channel is closed, then false)
+    // a message over maxBytes is read past and comes out empty
+    bool pop(string& body, uint32_t spins, size_t maxBytes = SIZE_MAX);
+
+    // wakes whoever sleeps on this ring (used when closing)
+    void wakeAll();
+
+private:
+    bool pushFrame(string_view piece, bool more, uint32_t spins);
+    bool popFrame(string& body, bool keep, bool& more, uint32_t spins); // appends to body if keep
+    void copyIn(uint32_t at, const char* from, uint32_t n);
+    void copyOut(uint32_t at, char* to, uint32_t n) const;
+
+    ShmRingControl* control;
+    char* data;
+    uint32_t size; // a power of two
+    const atomic<uint32_t>* closed;
+};
+
+// the mapped region, the creator owns the name and unlinks it when done
+class ShmChannel {
+public:
+    static constexpr uint32_t DEFAULT_RING_BYTES = uint32_t(1) << 20;
+
+    // name "" makes an anonymous region (memfd), shareable by fd() or fork
+    // ringBytes is rounded up to a power of two
+    static unique_ptr<ShmChannel> create(const string& name, string& error,
+                                         uint32_t ringBytes = DEFAULT_RING_BYTES);
+    static unique_ptr<ShmChannel> attach(const string& name, string& error);
+    ~ShmChannel();
+    ShmChannel(const ShmChannel&) = delete;
+    ShmChannel& operator=(const ShmChannel&) = delete;
+
+    SpscRing requests();
+    SpscRing replies();
+    int fd() const { return fileFd; }
+
+    // marks the channel closed and wakes both sides, every push/pop then fails
+    void close();
+    bool isClosed() const;
+
+private:
+    ShmChannel() = default;
+    bool map(int fd, size_t bytes, string& error);
+
+    struct Header;
+    static size_t headerBytes(); // the header, padded to a cache line
+    Header* header = nullptr;
+    size_t mappedBytes = 0;
+    int fileFd = -1;
+    string ownedName;
+};
+
+// command line -> request body, with the tokenizer rules of runCommand
+// (a line runCommand would reject becomes a request that answers "unsuccessful")
+// false only if the request wouldn't fit in maxFrame bytes
+bool encodeCommand(string_view line, string& request, size_t maxFrame = ShmChannel::DEFAULT_RING_BYTES - 4);
+
+// request body -> a command line that would make the same request
+// (the slow query log keeps binary commands as text)
+string decodeCommand(string_view request);
+
+// reply body (to request) -> the text main.cpp prints for that command
+void formatReply(string_view request, string_view reply, OutputBuffer& out);
+
+// the server side of one request: mutations go through store.update,
+// queries read the reader's version
+void runBinaryCommand(GraphStore& store, GraphStore::Reader& reader, string_view request, string& reply);
+
+// serves one channel until stop()
+class ShmServer {
+public:
+    ShmServer(GraphStore& store, ShmChannel& channel, uint32_t spins = 0);
+    void run();
+    void stop() { channel.close(); }
+
+private:
+    GraphStore& store;
+    ShmChannel& channel;
+    uint32_t spins;
+};
+
+// the client side, the quick probes have their own calls
+// every call blocks for the answer, false/-1 if the channel closed
+class ShmClient {
+public:
+    explicit ShmClient(ShmChannel& channel, uint32_t spins = 0) : channel(channel), spins(spins) {}
+
+    // 0 open, 1 closed, 2 DNE, -1 if the channel is gone
+    int checkEdgeStatus(int u, int v);
+    // 1 connected, 0 not, -1 if the channel is gone
+    int isConnected(int src, int dst);
+
+    // any command line, out gets exactly what main.cpp would print
+    bool call(string_view line, OutputBuffer& out);
+
+private:
+    bool roundTrip(string_view request, string& reply);
+    ShmChannel& channel;
+    uint32_t spins;
+    string request, reply;
+};
@@ -0,0 +1,138 @@
+// Slab.h
+// storage for small records (we use it for Student), in chunks of CHUNK_SIZE
+// a freed slot goes on a free list and is reused by the next allocation,
+// nothing ever moves inside a slab, so a handle stays good until its record is freed
+//
+// a handle is 32 bits: low 24 bits = slot index, high 8 bits = generation
+// every free bumps the slot's generation, so an old handle to a reused slot
+// is caught instead of silently pointing at somebody else
+//
+// copying a slab only copies the chunk pointers, the chunks are shared until
+// one side changes a record in them (then that one chunk is copied), so a
+// Graph copy that adds or removes one student pays for one chunk, not all
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+using SlabHandle = uint32_t;
+constexpr SlabHandle INVALID_HANDLE = 0xFFFFFFFFu;
+
+template <typename T>
+class Slab {
+public:
+    static constexpr uint32_t INDEX_BITS = 24;
+    static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static constexpr uint32_t MAX_SLOTS = INDEX_MASK; // index INDEX_MASK is never handed out
+    static constexpr uint32_t CHUNK_BITS = 10;
+    static constexpr uint32_t CHUNK_SIZE = 1u << CHUNK_BITS;
+
+    static uint32_t indexOf(SlabHandle h) { return h & INDEX_MASK; }
+    static uint32_t generationOf(SlabHandle h) { return h >> INDEX_BITS; }
+
+    // returns INVALID_HANDLE once all 2^24 - 1 slots are taken
+    SlabHandle allocate(const T& value) {
+        uint32_t i;
+        if (!freeSlots.empty()) {
+            i = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            if (slots >= MAX_SLOTS) return INVALID_HANDLE;
+            i = slots++;
+            if ((i >> CHUNK_BITS) == chunks.size()) chunks.push_back(make_shared<Chunk>());
+        }
+        Chunk& chunk = writableChunk(i);
+        chunk.records[i & CHUNK_MASK] = value;
+        chunk.live[i & CHUNK_MASK] = 1;
+        ++liveCount;
+        return makeHandle(i);
+    }
+
+    // O(1): the slot goes on the free list, nothing moves
+    bool free(SlabHandle h) {
+        if (!find(h)) return false;
+        uint32_t i = indexOf(h);
+        Chunk& chunk = writableChunk(i);
+        chunk.live[i & CHUNK_MASK] = 0;
+        ++chunk.generations[i & CHUNK_MASK];
+        freeSlots.push_back(i);
+        --liveCount;
+        return true;
+    }
+
+    // nullptr if the handle is stale or was never valid
+    // the non-const one is for changing the record, it unshares its chunk
+    T* get(SlabHandle h) {
+        if (!find(h)) return nullptr;
+        return &writableChunk(indexOf(h)).records[indexOf(h) & CHUNK_MASK];
+    }
+    const T* get(SlabHandle h) const { return find(h); }
+
+    size_t size() const { return liveCount; }
+    size_t capacity() const { return slots; }
+    size_t memoryBytes() const {
+        return chunks.size() * sizeof(Chunk) + chunks.capacity() * sizeof(chunks[0]) +
+               freeSlots.capacity() * sizeof(uint32_t);
+    }
+
+    // whole population scans walk the chunks and skip the free slots
+    // f(handle, record) may free the record it is given
+    // the non-const one unshares every chunk it passes, scan with the const
+    // one first when only a few records change
+    template <typename F>
+    void forEach(F f) {
+        for (uint32_t i = 0; i < slots; ++i) {
+            if (!chunks[i >> CHUNK_BITS]->live[i & CHUNK_MASK]) continue;
+            f(makeHandle(i), writableChunk(i).records[i & CHUNK_MASK]);
+        }
+    }
+    template <typename F>
+    void forEach(F f) const {
+        for (uint32_t i = 0; i < slots; ++i) {
+            const Chunk& chunk = *chunks[i >> CHUNK_BITS];
+            if (chunk.live[i & CHUNK_MASK]) f(makeHandle(i), chunk.records[i & CHUNK_MASK]);
+        }
+    }
+
+    void clear() {
+        chunks.clear();
+        freeSlots.clear();
+        slots = 0;
+        liveCount = 0;
+    }
+
+private:
+    static constexpr uint32_t CHUNK_MASK = CHUNK_SIZE - 1;
+
+    struct Chunk {
+        T records[CHUNK_SIZE];
+        uint8_t generations[CHUNK_SIZE] = {}; // wraps after 256 reuses of one slot
+        uint8_t live[CHUNK_SIZE] = {};
+    };
+
+    const T* find(SlabHandle h) const {
+        uint32_t i = indexOf(h);
+        if (i >= slots) return nullptr;
+        const Chunk& chunk = *chunks[i >> CHUNK_BITS];
+        if (!chunk.live[i & CHUNK_MASK] || chunk.generations[i & CHUNK_MASK] != generationOf(h)) return nullptr;
+        return &chunk.records[i & CHUNK_MASK];
+    }
+
+    // the chunk of slot i, ours alone (copied first if another slab holds it)
+    Chunk& writableChunk(uint32_t i) {
+        shared_ptr<const Chunk>& chunk = chunks[i >> CHUNK_BITS];
+        if (chunk.use_count() != 1) chunk = make_shared<Chunk>(*chunk);
+        return const_cast<Chunk&>(*chunk);
+    }
+
+    SlabHandle makeHandle(uint32_t i) const {
+        return (static_cast<uint32_t>(chunks[i >> CHUNK_BITS]->generations[i & CHUNK_MASK]) << INDEX_BITS) | i;
+    }
+
+    vector<shared_ptr<const Chunk>> chunks;
+    vector<uint32_t> freeSlots;
+    uint32_t slots = 0; // slots ever handed out, the chunks cover them
+    size_t liveCount = 0;
+};
@@ -0,0 +1,94 @@
+#include "SlowQueryLog.h"
+#include "CommandStats.h"
+#include "Graph.h"
+#include <cstdio>
+
+SlowQueryLog& SlowQueryLog::global() {
+    static SlowQueryLog log;
+    return log;
+}
+
+// a smaller ring keeps the newest entries, in order
+void SlowQueryLog::setCapacity(size_t entries) {
+    lock_guard<mutex> guard(lock);
+    vector<SlowQuery> kept;
+    size_t have = ring.size();
+    for (size_t i = 0; i < have; ++i) kept.push_back(move(ring[(next + i) % have]));
+    if (entries == 0) entries = 1;
+    if (kept.size() > entries) kept.erase(kept.begin(), kept.end() - static_cast<ptrdiff_t>(entries));
+    ring = move(kept);
+    capacity = entries;
+    next = 0;
+}
+
+void SlowQueryLog::note(const Graph& g, string_view command, CommandKind kind, bool ok, uint64_t nanos,
+                        const SearchCapture& searches) {
+    uint64_t limit = thresholdNanos();
+    if (limit == 0 || nanos < limit) return;
+    // everything but the sequence number is filled in outside the lock
+    SlowQuery entry;
+    entry.command.assign(command.data(), command.size());
+    entry.kind = kind;
+    entry.ok = ok;
+    entry.nanos = nanos;
+    entry.closureEpoch = g.getClosureEpoch();
+    entry.locations = g.getLocationCount();
+    entry.edges = g.getEdgeCount();
+    entry.students = g.getStudentCount();
+    for (size_t k = 0; k < SEARCH_KINDS; ++k) entry.kinds[k] = searches.kinds[k];
+    entry.searches = searches.total();
+
+    lock_guard<mutex> guard(lock);
+    entry.sequence = ++logged;
+    if (ring.size() < capacity) {
+        ring.push_back(move(entry));
+    } else {
+        ring[next] = move(entry);
+        next = (next + 1) % capacity;
+    }
+}
+
+vector<SlowQuery> SlowQueryLog::entries(uint64_t* overwritten) const {
+    lock_guard<mutex> guard(lock);
+    vector<SlowQuery> all;
+    size_t have = ring.size();
+    for (size_t i = 0; i < have; ++i) all.push_back(ring[(next + i) % have]);
+    if (overwritten) *overwritten = logged - have;
+    return all;
+}
+
+void SlowQueryLog::clear() {
+    lock_guard<mutex> guard(lock);
+    ring.clear();
+    next = 0;
+    logged = 0;
+}
+
+void SlowQueryLog::print(OutputBuffer& out) const {
+    char row[200];
+    uint64_t overwritten = 0;
+    vector<SlowQuery> all = entries(&overwritten);
+    if (enabled())
+        snprintf(row, sizeof(row), "slow commands (at least %.1f us): %zu", static_cast<double>(thresholdNanos()) / 1000.0,
+                 all.size());
+    else
+        snprintf(row, sizeof(row), "slow commands (off): %zu", all.size());
+    out.put(row);
+    if (overwritten) {
+        snprintf(row, sizeof(row), ", %llu older ones overwritten", static_cast<unsigned long long>(overwritten));
+        out.put(row);
+    }
+    out.put('\n');
+    for (const SlowQuery& q : all) {
+        snprintf(row, sizeof(row), "#%llu ", static_cast<unsigned long long>(q.sequence));
+        out.put(row);
+        out.put(q.command);
+        out.put('\n');
+        snprintf(row, sizeof(row), "  %.1f us, %s, closure epoch %llu, %zu locations, %zu edges, %zu students\n",
+                 static_cast<double>(q.nanos) / 1000.0, q.ok ? "successful" : "unsuccessful",
+                 static_cast<unsigned long long>(q.closureEpoch), q.locations, q.edges, q.students);
+        out.put(row);
+        for (size_t k = 0; k < SEARCH_KINDS; ++k)
+            if (q.kinds[k].searches) putSearchWork(static_cast<SearchKind>(k), q.kinds[k], "  ", out);
+    }
+}
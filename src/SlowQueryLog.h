@@ -0,0 +1,71 @@
+// SlowQueryLog.h
+// the commands that took longer than a threshold, with what it takes to
+// make them happen again: the full command, the closure epoch and sizes of
+// the graph it ran on, what its searches did and how long it took. a
+// pathological printStudentZone (a huge induced subgraph after a pile of
+// closures) is one line here while the histograms just show a bump
+//
+// the log is a ring: once it holds `capacity` entries the oldest goes.
+// off until a threshold is set (Main --slow=MICROSECONDS); while off a
+// command pays one relaxed load. `slowlog` prints it, Main --slow prints
+// it at exit too (on stderr)
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Commands.h"
+#include "SearchStats.h"
+
+using namespace std;
+
+class Graph;
+
+struct SlowQuery {
+    uint64_t sequence = 0;      // 1 for the first slow command since the start
+    string command;             // as it came in (a binary one decoded back to text)
+    CommandKind kind = CommandKind::Unknown;
+    bool ok = true;
+    uint64_t nanos = 0;
+    uint64_t closureEpoch = 0;  // of the graph it ran on (after it, for a mutation)
+    size_t locations = 0, edges = 0, students = 0;
+    SearchStats searches;       // every search the command ran, added up
+    SearchStats kinds[SEARCH_KINDS];
+};
+
+class SlowQueryLog {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 256;
+
+    static SlowQueryLog& global();
+
+    // 0 turns it off (the default)
+    void setThreshold(uint64_t nanos) { threshold.store(nanos, memory_order_relaxed); }
+    uint64_t thresholdNanos() const { return threshold.load(memory_order_relaxed); }
+    bool enabled() const { return thresholdNanos() != 0; }
+
+    // keeps the newest entries that fit
+    void setCapacity(size_t entries);
+
+    // logs the command if it took at least the threshold; the cheap check
+    // is here so a caller can just call it after every command
+    void note(const Graph& g, string_view command, CommandKind kind, bool ok, uint64_t nanos,
+              const SearchCapture& searches);
+
+    // oldest first, and how many older ones didn't fit
+    vector<SlowQuery> entries(uint64_t* overwritten = nullptr) const;
+    void clear();
+
+    // one block per entry: the command, then its time, graph and searches
+    void print(OutputBuffer& out) const;
+
+private:
+    atomic<uint64_t> threshold{0};
+    mutable mutex lock; // guards everything below
+    vector<SlowQuery> ring;
+    size_t capacity = DEFAULT_CAPACITY;
+    size_t next = 0;     // where the next entry goes once the ring is full
+    uint64_t logged = 0; // ever, for the sequence numbers
+};
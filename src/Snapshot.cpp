@@ -0,0 +1,313 @@
+#include "Snapshot.h"
+#include "Graph.h"
+#include "CsvReader.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+// fingerprintBytes...
+// nothing fancy: xor in 8 bytes at a time, multiply, rotate,
+// then mix the tail and the length in at the end
+
+static uint64_t rotateLeft(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+uint64_t fingerprintBytes(string_view bytes) {
+    const uint64_t K1 = 0x9E3779B185EBCA87ull, K2 = 0xC2B2AE3D27D4EB4Full;
+    uint64_t h = 0x27D4EB2F165667C5ull ^ (bytes.size() * K1);
+    const char* p = bytes.data();
+    size_t n = bytes.size();
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h ^= rotateLeft(w * K2, 31) * K1;
+        h = rotateLeft(h, 27) * K1 + K2;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, n);
+    h ^= rotateLeft(tail * K2, 31) * K1;
+    h ^= h >> 33; h *= K2;
+    h ^= h >> 29; h *= K1;
+    return h ^ (h >> 32);
+}
+
+uint64_t fingerprintFile(const string& path) {
+    MappedFile file;
+    if (!file.open(path)) return 0;
+    return fingerprintBytes(file.contents());
+}
+
+// helpers to append to / read from a byte buffer
+
+namespace {
+
+template <typename T>
+void put(string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void padTo8(string& out) {
+    while (out.size() % 8) out.push_back('\0');
+}
+
+// writes the section header now and patches its size when the section is done
+struct SectionWriter {
+    string& out;
+    size_t headerAt;
+    SectionWriter(string& out, uint32_t tag) : out(out), headerAt(out.size()) {
+        put(out, SnapshotSectionHeader{tag, 0, 0});
+    }
+    ~SectionWriter() {
+        uint64_t size = out.size() - headerAt - sizeof(SnapshotSectionHeader);
+        memcpy(&out[headerAt] + offsetof(SnapshotSectionHeader, size), &size, sizeof(size));
+        padTo8(out);
+    }
+};
+
+// every read is bounds checked, a short or corrupt file just fails
+struct Reader {
+    string_view data;
+    bool ok = true;
+
+    template <typename T>
+    bool get(T& value) {
+        if (data.size() < sizeof(T)) return ok = false;
+        memcpy(&value, data.data(), sizeof(T));
+        data.remove_prefix(sizeof(T));
+        return true;
+    }
+    // count records of T, straight from the mapped bytes (T must be POD and
+    // the section 8 byte aligned, which the writer guarantees)
+    template <typename T>
+    const T* array(size_t count) {
+        if (count > data.size() / sizeof(T)) { ok = false; return nullptr; }
+        const T* p = reinterpret_cast<const T*>(data.data());
+        data.remove_prefix(count * sizeof(T));
+        return p;
+    }
+    string_view bytes(size_t count) {
+        if (count > data.size()) { ok = false; return string_view(); }
+        string_view b = data.substr(0, count);
+        data.remove_prefix(count);
+        return b;
+    }
+};
+
+} // namespace
+
+bool readSnapshotInfo(const string& path, SnapshotInfo& info) {
+    ifstream file(path, ios::binary);
+    SnapshotHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, 8) != 0 || header.byteOrder != SNAPSHOT_BYTE_ORDER) return false;
+    info.version = header.version;
+    info.edgesFingerprint = header.edgesFingerprint;
+    info.classesFingerprint = header.classesFingerprint;
+    return true;
+}
+
+// saveSnapshot builds the payload in memory, then writes header + payload
+
+bool Graph::saveSnapshot(const string& path) const {
+    const auto& adjList = topology->adjList;
+    const vector<uint64_t>& closed = closures->closed;
+    const auto& classInfoMap = classes->classInfoMap;
+    const Registry& reg = *registry;
+    string payload;
+    uint32_t sections = 0;
+
+    {
+        SectionWriter section(payload, SNAPSHOT_TOPOLOGY);
+        uint64_t nodeCount = adjList.size(), edgeCount = 0;
+        for (const auto& kv : adjList) edgeCount += kv.second.size();
+        put(payload, nodeCount);
+        put(payload, edgeCount);
+        for (const auto& kv : adjList)
+            put(payload, SnapshotNode{kv.first, static_cast<uint32_t>(kv.second.size())});
+        padTo8(payload);
+        for (const auto& kv : adjList)
+            for (const Edge& e : kv.second)
+                put(payload, SnapshotEdge{e.destination, e.travelTime, e.link});
+        padTo8(payload);
+        put(payload, static_cast<uint64_t>(closed.size()));
+        payload.append(reinterpret_cast<const char*>(closed.data()), closed.size() * sizeof(uint64_t));
+        ++sections;
+    }
+
+    {
+        SectionWriter section(payload, SNAPSHOT_CLASSES);
+        string text;
+        uint64_t count = classInfoMap.size();
+        put(payload, count);
+        for (const auto& kv : classInfoMap) {
+            const ClassInfo& info = kv.second;
+            // the lengths are 16 bits, cutting a time short would load a different class
+            if (info.startTime.size() > UINT16_MAX || info.endTime.size() > UINT16_MAX) return false;
+            SnapshotClass rec{kv.first, info.locationId,
+                              static_cast<uint32_t>(text.size()), 0,
+                              static_cast<uint16_t>(info.startTime.size()),
+                              static_cast<uint16_t>(info.endTime.size())};
+            text += info.startTime;
+            rec.endOffset = static_cast<uint32_t>(text.size());
+            text += info.endTime;
+            put(payload, rec);
+        }
+        // classToLocation always has the same entries, it's rebuilt from these
+        put(payload, static_cast<uint64_t>(text.size()));
+        payload += text;
+        ++sections;
+    }
+
+    {
+        SectionWriter section(payload, SNAPSHOT_STUDENTS);
+        put(payload, static_cast<uint64_t>(reg.students.size()));
+        reg.students.forEach([&](SlabHandle, const Student& s) { put(payload, s); });
+        put(payload, static_cast<uint64_t>(reg.studentNames.size()));
+        put(payload, static_cast<uint64_t>(reg.deadNameBytes));
+        reg.studentNames.appendTo(payload);
+        ++sections;
+    }
+
+    // the routing index only goes in if it was built for exactly these edges
+    if (routingIndexReady()) {
+        SectionWriter section(payload, SNAPSHOT_ROUTING);
+        routing->current()->serialize(payload);
+        ++sections;
+    }
+
+    SnapshotHeader header;
+    memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.payloadSize = payload.size();
+    header.checksum = fingerprintBytes(payload);
+    header.edgesFingerprint = topology->edgesFingerprint;
+    header.classesFingerprint = classes->classesFingerprint;
+    header.sectionCount = sections;
+    header.reserved = 0;
+
+    // write to a temp file first so a crash never leaves half a snapshot
+    string tmp = path + ".tmp";
+    {
+        ofstream out(tmp, ios::binary | ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(payload.data(), static_cast<streamsize>(payload.size()));
+        if (!out) return false;
+    }
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// loadSnapshot maps the file, checks it, and builds a fresh Graph from the
+// records in place; *this is only replaced once everything checked out
+
+bool Graph::loadSnapshot(const string& path) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+    Reader whole{file.contents()};
+
+    SnapshotHeader header;
+    if (!whole.get(header)) return false;
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, 8) != 0) return false;
+    if (header.version != SNAPSHOT_VERSION || header.byteOrder != SNAPSHOT_BYTE_ORDER) return false;
+    if (header.payloadSize != whole.data.size()) return false;
+    if (fingerprintBytes(whole.data) != header.checksum) return false;
+
+    // fresh owns its parts, so writable() hands them out without copying
+    // the registry mode is ours, not the file's: the UFID index is rebuilt
+    // from the records either way, so a snapshot loads into either mode
+    Graph fresh(getRegistryMode());
+    fresh.parallelLoadThreshold = parallelLoadThreshold;
+    Topology& topo = writable(fresh.topology);
+    Closures& shut = writable(fresh.closures);
+    ClassTable& table = writable(fresh.classes);
+    Registry& reg = writable(fresh.registry);
+    topo.edgesFingerprint = header.edgesFingerprint;
+    table.classesFingerprint = header.classesFingerprint;
+    shared_ptr<const LandmarkIndex> routingIndex;
+
+    for (uint32_t n = 0; n < header.sectionCount; ++n) {
+        SnapshotSectionHeader sh;
+        if (!whole.get(sh)) return false;
+        Reader section{whole.bytes(sh.size)};
+        whole.bytes((8 - sh.size % 8) % 8);
+        if (!whole.ok) return false;
+
+        if (sh.tag == SNAPSHOT_TOPOLOGY) {
+            uint64_t nodeCount = 0, edgeCount = 0;
+            section.get(nodeCount);
+            section.get(edgeCount);
+            const SnapshotNode* nodes = section.array<SnapshotNode>(nodeCount);
+            section.bytes((8 - (nodeCount * sizeof(SnapshotNode)) % 8) % 8);
+            const SnapshotEdge* edges = section.array<SnapshotEdge>(edgeCount);
+            section.bytes((8 - (edgeCount * sizeof(SnapshotEdge)) % 8) % 8);
+            uint64_t words = 0;
+            section.get(words);
+            const uint64_t* closed = section.array<uint64_t>(words);
+            if (!section.ok) return false;
+            shut.closed.assign(closed, closed + words);
+            topo.adjList.reserve(nodeCount);
+            uint64_t next = 0;
+            for (uint64_t i = 0; i < nodeCount; ++i) {
+                if (nodes[i].degree > edgeCount - next) return false;
+                vector<Edge>& list = topo.adjList[nodes[i].id];
+                list.reserve(nodes[i].degree);
+                for (uint32_t k = 0; k < nodes[i].degree; ++k, ++next) {
+                    const SnapshotEdge& e = edges[next];
+                    if (e.link >= edgeCount / 2) return false;
+                    list.emplace_back(e.destination, e.travelTime, e.link);
+                }
+            }
+            topo.edgeCount = edgeCount;
+        } else if (sh.tag == SNAPSHOT_CLASSES) {
+            uint64_t count = 0, textSize = 0;
+            section.get(count);
+            const SnapshotClass* recs = section.array<SnapshotClass>(count);
+            section.get(textSize);
+            string_view text = section.bytes(textSize);
+            if (!section.ok) return false;
+            table.classInfoMap.reserve(count);
+            table.classToLocation.reserve(count);
+            for (uint64_t i = 0; i < count; ++i) {
+                const SnapshotClass& r = recs[i];
+                if (size_t(r.startOffset) + r.startLength > text.size() ||
+                    size_t(r.endOffset) + r.endLength > text.size()) return false;
+                ClassInfo info;
+                info.locationId = r.locationId;
+                info.startTime = string(text.substr(r.startOffset, r.startLength));
+                info.endTime = string(text.substr(r.endOffset, r.endLength));
+                table.classInfoMap[r.classId] = std::move(info);
+                table.classToLocation[r.classId] = r.locationId;
+            }
+        } else if (sh.tag == SNAPSHOT_STUDENTS) {
+            uint64_t count = 0, poolSize = 0, dead = 0;
+            section.get(count);
+            const Student* recs = section.array<Student>(count);
+            section.get(poolSize);
+            section.get(dead);
+            string_view pool = section.bytes(poolSize);
+            if (!section.ok) return false;
+            reg.studentNames.assign(pool);
+            reg.deadNameBytes = dead;
+            for (uint64_t i = 0; i < count; ++i) {
+                const Student& s = recs[i];
+                if (!reg.studentNames.holds(s.getNameOffset(), s.getNameLength())) return false;
+                // the classes are inline, a count addStudent wouldn't take reads past them
+                if (s.getNumberOfClasses() < 1 || s.getNumberOfClasses() > Student::MAX_CLASSES) return false;
+                SlabHandle h = reg.students.allocate(s);
+                if (h == INVALID_HANDLE || !reg.studentIndex.insert(s.getUFID().value, h)) return false;
+            }
+        } else if (sh.tag == SNAPSHOT_ROUTING) {
+            // the snapshot file is unmapped when we return, so the index gets its own copy
+            auto bytes = make_shared<string>(section.data);
+            routingIndex = LandmarkIndex::fromBytes(*bytes, bytes);
+        }
+        // anything else is from a newer writer, skip it
+    }
+
+    // the routing settings belong to this object, not the file
+    fresh.routing = routing;
+    *this = std::move(fresh);
+    if (routing && routingIndex) routing->adopt(std::move(routingIndex));
+    return true;
+}
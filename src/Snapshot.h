@@ -0,0 +1,83 @@
+// Snapshot.h
+// binary snapshot of a whole Graph, so startup can skip the CSVs
+//
+// file = SnapshotHeader, then tagged sections (8 byte aligned):
+//   TOPOLOGY  nodes + edges (each with its link), then the closed links' bits
+//   CLASSES   class table (packed id, location, start/end time)
+//   STUDENTS  raw Student records + the name pool (its 64KB blocks back to back)
+//   ROUTING   precomputed routing data, if the Graph has any
+// unknown section tags are skipped, so newer writers stay readable
+// numbers are written in host byte order, the header says which one
+// the checksum covers everything after the header
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+constexpr char SNAPSHOT_MAGIC[8] = {'C','A','M','P','S','N','A','P'};
+constexpr uint32_t SNAPSHOT_VERSION = 3; // 1 kept an open flag in every edge, 2 let a name cross a 64KB block
+constexpr uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304u;
+
+enum SnapshotSection : uint32_t {
+    SNAPSHOT_TOPOLOGY = 1,
+    SNAPSHOT_CLASSES = 2,
+    SNAPSHOT_STUDENTS = 3,
+    SNAPSHOT_ROUTING = 4,
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t payloadSize;        // bytes after the header
+    uint64_t checksum;           // fingerprintBytes of the payload
+    uint64_t edgesFingerprint;   // fingerprintBytes of edges.csv it was built from
+    uint64_t classesFingerprint; // same for classes.csv
+    uint32_t sectionCount;
+    uint32_t reserved;           // 0 (the registry mode is the loader's choice, see loadSnapshot)
+};
+
+struct SnapshotSectionHeader {
+    uint32_t tag;
+    uint32_t reserved;
+    uint64_t size; // not counting padding up to 8 bytes
+};
+
+// the fixed size records inside the sections
+// they are read straight out of the mapped file
+struct SnapshotNode {
+    int32_t id;
+    uint32_t degree; // this node's edges follow the previous node's in the edge array
+};
+
+struct SnapshotEdge {
+    int32_t destination;
+    int32_t travelTime;
+    uint32_t link; // shared by both directions, below edgeCount / 2
+};
+
+struct SnapshotClass {
+    uint32_t classId;
+    int32_t locationId;
+    uint32_t startOffset; // start/end time strings live in the section's text blob
+    uint32_t endOffset;
+    uint16_t startLength; // a longer time string can't be saved
+    uint16_t endLength;
+};
+
+// 64-bit hash of a byte range, 8 bytes per step
+// used for the CSV fingerprints and the snapshot checksum
+uint64_t fingerprintBytes(string_view bytes);
+
+// fingerprint of a file's contents, 0 if it can't be read
+uint64_t fingerprintFile(const string& path);
+
+// what's in a snapshot's header, without loading the rest
+struct SnapshotInfo {
+    uint32_t version = 0;
+    uint64_t edgesFingerprint = 0;
+    uint64_t classesFingerprint = 0;
+};
+bool readSnapshotInfo(const string& path, SnapshotInfo& info);
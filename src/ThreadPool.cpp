@@ -0,0 +1,165 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+// set while a thread is running pool tasks, so nested calls don't deadlock
+// (a call into the same pool runs on the worker index of the task it was
+// made from; that index means nothing to another pool, which gets 0)
+static thread_local const ThreadPool* runningPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) threads = thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    // the caller is worker 0 of every job, the threads are 1..threads-1
+    for (size_t i = 1; i < threads; ++i) workers.emplace_back([this, i] { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+static size_t sharedPoolSize = 0;
+
+void ThreadPool::configureShared(size_t threads) {
+    sharedPoolSize = threads;
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(sharedPoolSize);
+    return pool;
+}
+
+// a slice is [begin, end) packed into one word, so the owner and a thief
+// can't both get the same task: whoever's CAS lands first wins it
+
+static uint64_t packSlice(uint32_t begin, uint32_t end) {
+    return (uint64_t(begin) << 32) | end;
+}
+
+bool ThreadPool::takeFront(atomic<uint64_t>& slice, uint32_t& task) {
+    uint64_t s = slice.load(memory_order_acquire);
+    for (;;) {
+        uint32_t begin = static_cast<uint32_t>(s >> 32), end = static_cast<uint32_t>(s);
+        if (begin >= end) return false;
+        if (slice.compare_exchange_weak(s, packSlice(begin + 1, end), memory_order_acq_rel)) {
+            task = begin;
+            return true;
+        }
+    }
+}
+
+// cuts off the back half (all of it if only one task is left)
+bool ThreadPool::stealBack(atomic<uint64_t>& slice, uint64_t& stolen) {
+    uint64_t s = slice.load(memory_order_acquire);
+    for (;;) {
+        uint32_t begin = static_cast<uint32_t>(s >> 32), end = static_cast<uint32_t>(s);
+        if (begin >= end) return false;
+        uint32_t mid = begin + (end - begin) / 2;
+        if (slice.compare_exchange_weak(s, packSlice(begin, mid), memory_order_acq_rel)) {
+            stolen = packSlice(mid, end);
+            return true;
+        }
+    }
+}
+
+// run our own slice from the front, then go round the others stealing
+// until a whole round finds nothing. the last one to finish wakes up the caller
+void ThreadPool::runTasks(const shared_ptr<Job>& job, size_t worker) {
+    const ThreadPool* wasPool = runningPool;
+    size_t wasWorker = currentWorker;
+    runningPool = this;
+    currentWorker = worker;
+    size_t ran = 0;
+    size_t participants = job->slices.size();
+    atomic<uint64_t>& mine = job->slices[worker];
+    for (;;) {
+        uint32_t task;
+        while (takeFront(mine, task)) {
+            (*job->body)(job->base + task, worker);
+            ++ran;
+        }
+        // our slice is empty, so no thief touches it until we refill it
+        uint64_t stolen = 0;
+        bool found = false;
+        for (size_t k = 1; k < participants && !found; ++k)
+            found = stealBack(job->slices[(worker + k) % participants], stolen);
+        if (!found) break;
+        mine.store(stolen, memory_order_release);
+    }
+    runningPool = wasPool;
+    currentWorker = wasWorker;
+    if (ran == 0) return;
+    lock_guard<mutex> guard(lock);
+    job->finished += ran;
+    if (job->finished == job->size) done.notify_all();
+}
+
+void ThreadPool::workerLoop(size_t worker) {
+    size_t seenJob = 0;
+    for (;;) {
+        shared_ptr<Job> job;
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [&] { return stopping || jobId != seenJob; });
+            if (stopping) return;
+            seenJob = jobId;
+            job = current;
+        }
+        if (job) runTasks(job, worker);
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t)>& body) {
+    parallelForWorkers(count, [&body](size_t task, size_t) { body(task); });
+}
+
+void ThreadPool::parallelForWorkers(size_t count, const function<void(size_t, size_t)>& body) {
+    if (count == 0) return;
+    if (runningPool) {
+        // one thread runs them all, so any index below concurrency() is ours
+        size_t worker = runningPool == this ? currentWorker : 0;
+        for (size_t i = 0; i < count; ++i) body(i, worker);
+        return;
+    }
+
+    // callers from different threads just take turns
+    // (even a serial run, it uses worker 0 too)
+    lock_guard<mutex> one(callerLock);
+    if (workers.empty() || count == 1) {
+        runningPool = this;
+        currentWorker = 0;
+        for (size_t i = 0; i < count; ++i) body(i, 0);
+        runningPool = nullptr;
+        return;
+    }
+
+    // slices hold 32 bit indexes, a (very) big count goes in rounds
+    const size_t ROUND = UINT32_MAX;
+    for (size_t base = 0; base < count; base += ROUND) {
+        size_t size = min(ROUND, count - base);
+        auto job = make_shared<Job>(concurrency());
+        job->body = &body;
+        job->base = base;
+        job->size = size;
+        size_t participants = job->slices.size();
+        for (size_t w = 0; w < participants; ++w)
+            job->slices[w].store(packSlice(static_cast<uint32_t>(size * w / participants),
+                                           static_cast<uint32_t>(size * (w + 1) / participants)));
+        {
+            lock_guard<mutex> guard(lock);
+            current = job;
+            ++jobId;
+        }
+        wake.notify_all();
+        runTasks(job, 0);
+
+        unique_lock<mutex> guard(lock);
+        done.wait(guard, [&] { return job->finished == job->size; });
+        current.reset();
+    }
+}
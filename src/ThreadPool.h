@@ -0,0 +1,75 @@
+// ThreadPool.h
+// a fixed set of worker threads for the parallel parts of Graph
+// (chunked CSV parsing, the adjacency fill, batch runs, the bulk reports)
+//
+// a parallelFor hands every thread a slice of the task indexes up front,
+// a thread that runs out steals the back half of somebody else's slice,
+// so uneven tasks (a student with 6 far away classes next to one with 1)
+// still keep every thread busy until the end
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class ThreadPool {
+public:
+    // threads = 0 means one per hardware thread
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // the pool everyone shares, made on first use
+    // configureShared sets its size, it only counts if called before that
+    static ThreadPool& shared();
+    static void configureShared(size_t threads);
+
+    // workers + the calling thread
+    size_t concurrency() const { return workers.size() + 1; }
+
+    // runs body(0) ... body(count - 1) spread over the pool, returns when all are done
+    // the caller helps out; calling it from inside a task just runs serially
+    void parallelFor(size_t count, const function<void(size_t)>& body);
+
+    // same, but body also gets the index (below concurrency()) of the thread
+    // running it, so every thread can keep its own scratch space
+    // no two tasks of one call with the same worker index ever run at the same
+    // time (also when the call is nested inside a task, of this pool or another)
+    void parallelForWorkers(size_t count, const function<void(size_t task, size_t worker)>& body);
+
+private:
+    // one parallelFor call, a worker that wakes up late still holds it
+    // but finds every slice empty and never touches body
+    // slices[w] is worker w's part, packed (begin << 32) | end, the owner
+    // takes from the front and thieves cut off the back, both with a CAS
+    struct Job {
+        explicit Job(size_t workers) : slices(workers) {}
+        const function<void(size_t, size_t)>* body = nullptr;
+        size_t base = 0; // task indexes in the slices are relative to this
+        size_t size = 0;
+        vector<atomic<uint64_t>> slices;
+        size_t finished = 0; // guarded by lock
+    };
+
+    void workerLoop(size_t worker);
+    void runTasks(const shared_ptr<Job>& job, size_t worker);
+    static bool takeFront(atomic<uint64_t>& slice, uint32_t& task);
+    static bool stealBack(atomic<uint64_t>& slice, uint64_t& stolen);
+
+    vector<thread> workers;
+    mutex lock;
+    condition_variable wake;
+    condition_variable done;
+    shared_ptr<Job> current;
+    size_t jobId = 0;
+    bool stopping = false;
+    mutex callerLock;
+};
@@ -0,0 +1,188 @@
+#include "TimedRegions.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+
+atomic<bool> TimedRegions::switchedOn{false};
+atomic<uint32_t> TimedRegions::listeners{0};
+
+namespace {
+
+struct ThreadEvents {
+    vector<RegionEvent> events;
+    size_t dropped = 0;
+    uint32_t depth = 0;
+};
+
+// every thread's list, kept after the thread is gone
+mutex listsLock;
+vector<unique_ptr<ThreadEvents>>& lists() {
+    static vector<unique_ptr<ThreadEvents>> all;
+    return all;
+}
+
+ThreadEvents& local() {
+    thread_local ThreadEvents* mine = nullptr;
+    if (!mine) {
+        lock_guard<mutex> guard(listsLock);
+        lists().push_back(make_unique<ThreadEvents>());
+        mine = lists().back().get();
+    }
+    return *mine;
+}
+
+atomic<int64_t> origin{0};
+
+thread_local RegionListener* listening = nullptr;
+
+} // namespace
+
+uint64_t TimedRegions::now() {
+    int64_t t = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    return static_cast<uint64_t>(max<int64_t>(0, t - origin.load(memory_order_relaxed)));
+}
+
+void TimedRegions::start() {
+    {
+        lock_guard<mutex> guard(listsLock);
+        for (auto& list : lists()) {
+            list->events.clear();
+            list->dropped = 0;
+        }
+    }
+    origin.store(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count(),
+                 memory_order_relaxed);
+    switchedOn.store(true, memory_order_relaxed);
+}
+
+void TimedRegions::stop() {
+    switchedOn.store(false, memory_order_relaxed);
+}
+
+void TimedRegions::add(const char* name, uint64_t start, uint64_t end, uint32_t depth) {
+    ThreadEvents& t = local();
+    if (t.events.size() >= MAX_EVENTS_PER_THREAD) {
+        ++t.dropped;
+        return;
+    }
+    t.events.push_back({name, start, end - start, depth});
+}
+
+void TimedRegion::begin() {
+    depth = local().depth++;
+    startedAt = TimedRegions::now();
+    started = true;
+}
+
+void TimedRegion::end() {
+    uint64_t finished = max(TimedRegions::now(), startedAt);
+    --local().depth;
+    if (TimedRegions::recording()) TimedRegions::add(name, startedAt, finished, depth);
+    if (listening && depth >= listening->baseDepth)
+        listening->events.push_back({name, startedAt, finished - startedAt, depth - listening->baseDepth});
+}
+
+RegionListener::RegionListener() : outer(listening), baseDepth(local().depth) {
+    listening = this;
+    TimedRegions::listeners.fetch_add(1, memory_order_relaxed);
+}
+
+RegionListener::~RegionListener() {
+    TimedRegions::listeners.fetch_sub(1, memory_order_relaxed);
+    listening = outer;
+}
+
+vector<vector<RegionEvent>> TimedRegions::events(size_t* dropped) {
+    lock_guard<mutex> guard(listsLock);
+    vector<vector<RegionEvent>> all;
+    if (dropped) *dropped = 0;
+    for (const auto& list : lists()) {
+        all.push_back(list->events);
+        if (dropped) *dropped += list->dropped;
+    }
+    return all;
+}
+
+
+// the outputs...
+
+static void putJsonString(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        if (static_cast<unsigned char>(*s) >= 0x20) fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+bool TimedRegions::writeChromeTrace(const string& path, string& error) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        error = "can't write " + path;
+        return false;
+    }
+    // times in microseconds with ns precision, what the viewers expect
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", f);
+    bool first = true;
+    vector<vector<RegionEvent>> all = events();
+    for (size_t tid = 0; tid < all.size(); ++tid) {
+        for (const RegionEvent& e : all[tid]) {
+            fputs(first ? "\n" : ",\n", f);
+            first = false;
+            fputs("{\"name\":", f);
+            putJsonString(f, e.name);
+            fprintf(f, ",\"cat\":\"campus\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}", tid,
+                    static_cast<double>(e.start) / 1000.0, static_cast<double>(e.duration) / 1000.0);
+        }
+    }
+    fputs("\n]}\n", f);
+    bool ok = fclose(f) == 0;
+    if (!ok) error = "can't write " + path;
+    return ok;
+}
+
+// a thread's events sorted by start (outer first when two start together)
+// are its regions in the order they were entered, so the open region one
+// level up is always the last one seen at that depth
+bool TimedRegions::writeFolded(const string& path, string& error) {
+    map<string, uint64_t> stacks;
+    for (vector<RegionEvent>& list : events()) {
+        sort(list.begin(), list.end(), [](const RegionEvent& a, const RegionEvent& b) {
+            return a.start != b.start ? a.start < b.start : a.depth < b.depth;
+        });
+        vector<uint64_t> childTime(list.size(), 0);
+        vector<size_t> lastAt;            // index of the last event seen at each depth
+        vector<const char*> names;        // the stack down to the current event
+        vector<string> keys(list.size());
+        for (size_t i = 0; i < list.size(); ++i) {
+            const RegionEvent& e = list[i];
+            if (lastAt.size() <= e.depth) {
+                lastAt.resize(e.depth + 1, SIZE_MAX);
+                names.resize(e.depth + 1, "?");
+            }
+            lastAt[e.depth] = i;
+            names[e.depth] = e.name;
+            if (e.depth > 0 && lastAt[e.depth - 1] != SIZE_MAX) childTime[lastAt[e.depth - 1]] += e.duration;
+            string& key = keys[i];
+            for (uint32_t d = 0; d <= e.depth; ++d) {
+                if (d) key += ';';
+                key += names[d];
+            }
+        }
+        for (size_t i = 0; i < list.size(); ++i)
+            stacks[keys[i]] += list[i].duration - min(list[i].duration, childTime[i]);
+    }
+
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        error = "can't write " + path;
+        return false;
+    }
+    for (const auto& [stack, self] : stacks)
+        if (self) fprintf(f, "%s %llu\n", stack.c_str(), static_cast<unsigned long long>(self));
+    bool ok = fclose(f) == 0;
+    if (!ok) error = "can't write " + path;
+    return ok;
+}
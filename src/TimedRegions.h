@@ -0,0 +1,107 @@
+// TimedRegions.h
+// scoped timers for a look inside one run: TIMED_REGION("dijkstra") at the
+// top of a block times the block, and Main writes everything it saw as a
+// Chrome trace (--trace=FILE, open in chrome://tracing or ui.perfetto.dev)
+// and/or folded stacks (--folded=FILE, for flamegraph.pl / speedscope)
+//
+// built without CAMPUS_TIMED_REGIONS (cmake -DCAMPUS_TIMED_REGIONS=OFF) the
+// macro is nothing at all; built with it but with nobody listening, a region
+// is two relaxed loads. while recording, a region is two clock reads and a
+// push into its thread's own list (no locks), regions nest per thread
+//
+// a RegionListener sees the regions that finish on its own thread while it
+// lives, recording or not (explain uses one for the phases of its command)
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// one finished region (name must outlive the recording, a literal does)
+struct RegionEvent {
+    const char* name;
+    uint64_t start;    // ns since the recording started
+    uint64_t duration; // ns
+    uint32_t depth;    // 0 outside every other region of its thread
+};
+
+class TimedRegions {
+public:
+    // how many events a thread keeps, the rest are counted as dropped
+    static constexpr size_t MAX_EVENTS_PER_THREAD = size_t(1) << 20;
+
+    static void start();
+    static void stop();
+    static bool recording() { return switchedOn.load(memory_order_relaxed); }
+    // recording, or a RegionListener alive somewhere
+    static bool wanted() { return recording() || listeners.load(memory_order_relaxed) != 0; }
+
+    // every thread's events so far (thread i's are events[i]), and how many
+    // didn't fit; only while no region is running (Main calls it at exit)
+    static vector<vector<RegionEvent>> events(size_t* dropped = nullptr);
+
+    // the two outputs (false and error if the file can't be written)
+    // Chrome: one complete ("X") event per region, tid = thread number
+    // folded: "outer;inner;name self-ns" per distinct stack, added up over threads
+    static bool writeChromeTrace(const string& path, string& error);
+    static bool writeFolded(const string& path, string& error);
+
+    static uint64_t now();
+
+private:
+    friend class TimedRegion;
+    friend class RegionListener;
+    static void add(const char* name, uint64_t start, uint64_t end, uint32_t depth);
+    static atomic<bool> switchedOn;
+    static atomic<uint32_t> listeners;
+};
+
+// the regions finished on this thread from construction to destruction,
+// depth counted from where the listener was made (0 for the outermost);
+// listeners nest, only the innermost hears a region
+class RegionListener {
+public:
+    RegionListener();
+    ~RegionListener();
+    RegionListener(const RegionListener&) = delete;
+    RegionListener& operator=(const RegionListener&) = delete;
+
+    vector<RegionEvent> events;
+
+private:
+    friend class TimedRegion;
+    RegionListener* outer;
+    uint32_t baseDepth;
+};
+
+class TimedRegion {
+public:
+    explicit TimedRegion(const char* name) : name(name) {
+        if (TimedRegions::wanted()) begin();
+    }
+    ~TimedRegion() {
+        if (started) end();
+    }
+    TimedRegion(const TimedRegion&) = delete;
+    TimedRegion& operator=(const TimedRegion&) = delete;
+
+private:
+    void begin();
+    void end();
+    const char* name;
+    uint64_t startedAt = 0;
+    uint32_t depth = 0;
+    bool started = false;
+};
+
+#define TIMED_REGION_CAT2(a, b) a##b
+#define TIMED_REGION_CAT(a, b) TIMED_REGION_CAT2(a, b)
+#ifdef CAMPUS_TIMED_REGIONS
+#define TIMED_REGION(name) TimedRegion TIMED_REGION_CAT(timedRegion, __LINE__)(name)
+#else
+#define TIMED_REGION(name) ((void)0)
+#endif
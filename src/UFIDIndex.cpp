@@ -0,0 +1,94 @@
+#include "UFIDIndex.h"
+
+// DirectUFIDTable...
+// the group pointer array is only made on the first insert, so a Graph in
+// Hashed mode doesn't pay for it
+// a group or page somebody else also holds is copied before we change it
+
+shared_ptr<const DirectUFIDTable::Page>& DirectUFIDTable::pageSlot(uint32_t ufid) {
+    shared_ptr<const Group>& group = groups[ufid >> (PAGE_BITS + GROUP_BITS)];
+    if (!group) {
+        group = make_shared<Group>();
+        ++liveGroups;
+    } else if (group.use_count() != 1) {
+        group = make_shared<Group>(*group);
+    }
+    return const_cast<Group&>(*group).pages[(ufid >> PAGE_BITS) & (GROUP_SIZE - 1)];
+}
+
+DirectUFIDTable::Page& DirectUFIDTable::writablePage(shared_ptr<const Page>& page) {
+    if (page.use_count() != 1) page = make_shared<Page>(*page);
+    return const_cast<Page&>(*page);
+}
+
+bool DirectUFIDTable::insert(uint32_t ufid, SlabHandle handle) {
+    if (ufid >= 100000000u) return false;
+    if (find(ufid) != INVALID_HANDLE) return false;
+    if (groups.empty()) groups.resize(GROUP_COUNT);
+    shared_ptr<const Page>& slot = pageSlot(ufid);
+    if (!slot) {
+        slot = make_shared<Page>();
+        ++livePages;
+    }
+    Page& page = writablePage(slot);
+    uint32_t i = ufid & (PAGE_SIZE - 1);
+    page.present[i >> 6] |= uint64_t(1) << (i & 63);
+    page.handles[i] = handle;
+    ++page.count;
+    ++used;
+    return true;
+}
+
+bool DirectUFIDTable::erase(uint32_t ufid) {
+    if (find(ufid) == INVALID_HANDLE) return false;
+    --used;
+    shared_ptr<const Page>& slot = pageSlot(ufid);
+    // give the page back once it is empty (no need to copy it for that)
+    if (slot->count == 1) {
+        slot.reset();
+        --livePages;
+        return true;
+    }
+    Page& page = writablePage(slot);
+    uint32_t i = ufid & (PAGE_SIZE - 1);
+    page.present[i >> 6] &= ~(uint64_t(1) << (i & 63));
+    --page.count;
+    return true;
+}
+
+// UFIDIndex just forwards to whichever table the mode says
+// (a hashed shard is unshared like a direct page before it changes)
+
+UFIDIndex::UFIDIndex(RegistryMode mode) : mode(mode) {}
+
+bool UFIDIndex::insert(uint32_t ufid, SlabHandle handle) {
+    if (mode == RegistryMode::DirectAddress) return direct.insert(ufid, handle);
+    if (find(ufid) != INVALID_HANDLE) return false;
+    shared_ptr<const HashedShard>& shard = hashed[shardOf(ufid)];
+    if (!shard) shard = make_shared<HashedShard>();
+    else if (shard.use_count() != 1) shard = make_shared<HashedShard>(*shard);
+    const_cast<HashedShard&>(*shard).insert(ufid, handle);
+    ++hashedCount;
+    return true;
+}
+
+bool UFIDIndex::erase(uint32_t ufid) {
+    if (mode == RegistryMode::DirectAddress) return direct.erase(ufid);
+    if (find(ufid) == INVALID_HANDLE) return false;
+    shared_ptr<const HashedShard>& shard = hashed[shardOf(ufid)];
+    if (shard.use_count() != 1) shard = make_shared<HashedShard>(*shard);
+    const_cast<HashedShard&>(*shard).erase(ufid);
+    --hashedCount;
+    return true;
+}
+
+size_t UFIDIndex::size() const {
+    return mode == RegistryMode::DirectAddress ? direct.size() : hashedCount;
+}
+
+size_t UFIDIndex::memoryBytes() const {
+    size_t bytes = direct.memoryBytes();
+    for (const auto& shard : hashed)
+        if (shard) bytes += sizeof(HashedShard) + shard->memoryBytes();
+    return bytes;
+}
@@ -0,0 +1,112 @@
+// UFIDIndex.h
+// maps a packed UFID to the handle of its Student record in Graph (see Slab.h)
+// two ways to do it (picked once, when the Graph is built):
+//   Hashed        -> FlatHashMap, good for small registries
+//   DirectAddress -> the UFID itself is the address, no hashing at all
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Slab.h"
+#include "student.h"
+
+using namespace std;
+
+enum class RegistryMode { Hashed, DirectAddress };
+
+// DirectUFIDTable is a direct-address table over all 10^8 UFIDs
+// UFIDs come in pages of 4096, and page pointers in groups of 256 pages
+// (96 group pointers at the top)
+// a page has a presence bitmap + one handle per UFID and is only allocated
+// when a UFID in its range shows up, and freed when its last UFID leaves
+// so memory follows the number of populated pages, not the key space
+// copies share the groups and pages, changing a UFID copies its page and
+// the group pointing at it, never the whole table
+class DirectUFIDTable {
+public:
+    static constexpr uint32_t PAGE_BITS = 12;
+    static constexpr uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+    static constexpr uint32_t PAGE_COUNT = (100000000u + PAGE_SIZE - 1) / PAGE_SIZE;
+    static constexpr uint32_t GROUP_BITS = 8;
+    static constexpr uint32_t GROUP_SIZE = 1u << GROUP_BITS;
+    static constexpr uint32_t GROUP_COUNT = (PAGE_COUNT + GROUP_SIZE - 1) / GROUP_SIZE;
+
+    // returns INVALID_HANDLE if ufid is not in the table
+    SlabHandle find(uint32_t ufid) const {
+        if (ufid >= 100000000u || groups.empty()) return INVALID_HANDLE;
+        uint32_t p = ufid >> PAGE_BITS;
+        const Group* group = groups[p >> GROUP_BITS].get();
+        if (!group) return INVALID_HANDLE;
+        const Page* page = group->pages[p & (GROUP_SIZE - 1)].get();
+        if (!page) return INVALID_HANDLE;
+        uint32_t i = ufid & (PAGE_SIZE - 1);
+        return (page->present[i >> 6] >> (i & 63)) & 1u ? page->handles[i] : INVALID_HANDLE;
+    }
+
+    bool insert(uint32_t ufid, SlabHandle handle); // false if already there
+    bool erase(uint32_t ufid);
+    size_t size() const { return used; }
+    size_t pagesInUse() const { return livePages; }
+    size_t memoryBytes() const {
+        return groups.capacity() * sizeof(groups[0]) + liveGroups * sizeof(Group) + livePages * sizeof(Page);
+    }
+
+private:
+    struct Page {
+        uint64_t present[PAGE_SIZE / 64] = {};
+        SlabHandle handles[PAGE_SIZE];
+        uint32_t count = 0;
+    };
+    struct Group {
+        shared_ptr<const Page> pages[GROUP_SIZE];
+    };
+
+    // the slot holding ufid's page pointer, in a group that is ours alone
+    shared_ptr<const Page>& pageSlot(uint32_t ufid);
+    // the page itself, copied first if another table holds it too
+    static Page& writablePage(shared_ptr<const Page>& page);
+
+    vector<shared_ptr<const Group>> groups; // sized on the first insert
+    size_t used = 0;
+    size_t liveGroups = 0; // a group stays once made, it's small
+    size_t livePages = 0;
+};
+
+// UFIDIndex hides which of the two tables we are using
+// the hashed one is cut into HASH_SHARDS tables by the top bits of the hash,
+// shared between copies like the direct pages, so a copy that changes one
+// UFID copies one shard
+class UFIDIndex {
+public:
+    explicit UFIDIndex(RegistryMode mode = RegistryMode::Hashed);
+
+    RegistryMode getMode() const { return mode; }
+
+    static constexpr uint32_t HASH_SHARD_BITS = 4;
+    static constexpr uint32_t HASH_SHARDS = 1u << HASH_SHARD_BITS;
+
+    SlabHandle find(uint32_t ufid) const {
+        if (mode == RegistryMode::DirectAddress) return direct.find(ufid);
+        const HashedShard* shard = hashed[shardOf(ufid)].get();
+        if (!shard) return INVALID_HANDLE;
+        auto it = shard->find(ufid);
+        return it != shard->end() ? it->second : INVALID_HANDLE;
+    }
+
+    bool insert(uint32_t ufid, SlabHandle handle);
+    bool erase(uint32_t ufid);
+    size_t size() const;
+    size_t memoryBytes() const;
+
+private:
+    using HashedShard = FlatHashMap<uint32_t, SlabHandle, UFIDKeyTraits>;
+
+    static uint32_t shardOf(uint32_t ufid) {
+        return static_cast<uint32_t>(UFIDKeyTraits::hash(ufid) >> (64 - HASH_SHARD_BITS));
+    }
+
+    RegistryMode mode;
+    shared_ptr<const HashedShard> hashed[HASH_SHARDS]; // made on a shard's first insert
+    size_t hashedCount = 0;
+    DirectUFIDTable direct; // stays empty in Hashed mode
+};
@@ -3,58 +3,86 @@
 #include <algorithm>
 #include <iostream> // Added in case needed for debugging
 
+// turn the packed keys back into strings (only used for output)
+// this is just the reverse of encodeClassCode / encodeUFID in student.h
+
+string formatClassCode(ClassId id) {
+    if (id == INVALID_CLASS_ID) return "";
+    string out(7, '0');
+    uint32_t digits = id % 10000, letters = id / 10000;
+    for (int i = 6; i >= 3; --i) { out[i] = static_cast<char>('0' + digits % 10); digits /= 10; }
+    for (int i = 2; i >= 0; --i) { out[i] = static_cast<char>('A' + letters % 26); letters /= 26; }
+    return out;
+}
+
+string formatUFID(uint32_t ufid) {
+    if (ufid == INVALID_UFID) return "";
+    string out(8, '0');
+    for (int i = 7; i >= 0; --i) { out[i] = static_cast<char>('0' + ufid % 10); ufid /= 10; }
+    return out;
+}
+
 // I removed student age here...
 // but basically this initializes a student object...
 // with name, ufid, classes, and residence ID
-Student::Student(const string& studentName, 
-                 const string& ufid, 
-                 const vector<string>& classes, 
+Student::Student(uint32_t nameOffset,
+                 uint16_t nameLength,
+                 UFIDKey ufid, 
+                 ClassSpan classes, 
                  int res)
-    : name(studentName), ufid(ufid), residence(res), classCodes(classes) {}
+    : ufid(ufid), residence(res), nameOffset(nameOffset), nameLength(nameLength) {
+    for (ClassId id : classes) {
+        if (classCount == MAX_CLASSES) break;
+        classCodes[classCount++] = id;
+    }
+}
 
 // ok here are just the normal getter methods...
 
-string Student::getName() const { return name; }
-string Student::getUFID() const { return ufid; }
+string_view Student::getName(const NamePool& namePool) const { return namePool.view(nameOffset, nameLength); }
+UFIDKey Student::getUFID() const { return ufid; }
 int Student::getResidence() const { return residence; }
-int Student::getNumberOfClasses() const { return static_cast<int>(classCodes.size()); }
-vector<string> Student::getClasses() const { return classCodes; }
+int Student::getNumberOfClasses() const { return classCount; }
+ClassSpan Student::getClasses() const { return ClassSpan(classCodes, classCount); }
 
 // check whether the student is enrolled in the given class...
 // dont skip classes!
-bool Student::hasClass(const string& classCode) const {
-    return find(classCodes.begin(), classCodes.end(), classCode) != classCodes.end();
+bool Student::hasClass(ClassId classCode) const {
+    return find(classCodes, classCodes + classCount, classCode) != classCodes + classCount;
 }
 
 // add the class if not already enrolled...
-// fail if already enrolled lol...
-bool Student::addClass(const string& code) {
-    if (hasClass(code)) return false;
-    classCodes.push_back(code);
+// fail if already enrolled lol... (or if there is no room left)
+bool Student::addClass(ClassId code) {
+    if (hasClass(code) || classCount == MAX_CLASSES) return false;
+    classCodes[classCount++] = code;
     return true;
 }
 
-bool Student::removeClass(const string& classCode) {
-    auto it = find(classCodes.begin(), classCodes.end(), classCode);
-    if (it == classCodes.end()) return false;
-    classCodes.erase(it);
+// keep the remaining classes in order, like vector::erase did
+bool Student::removeClass(ClassId classCode) {
+    ClassId* last = classCodes + classCount;
+    ClassId* it = find(classCodes, last, classCode);
+    if (it == last) return false;
+    copy(it + 1, last, it);
+    classCodes[--classCount] = 0;
     return true;
 }
 
-bool Student::replaceClass(const string& oldClass, const string& newClass) {
-    auto it = find(classCodes.begin(), classCodes.end(), oldClass);
-    if (it == classCodes.end()) return false;
+bool Student::replaceClass(ClassId oldClass, ClassId newClass) {
+    ClassId* last = classCodes + classCount;
+    ClassId* it = find(classCodes, last, oldClass);
+    if (it == last) return false;
     if (hasClass(newClass)) return false;
     *it = newClass;
     return true;
 }
 
-bool Student::isValidUFID(const string& id) {
-    if (id.size() != 8) return false;
-    return all_of(id.begin(), id.end(), ::isdigit);
+bool Student::isValidUFID(string_view id) {
+    return encodeUFID(id) != INVALID_UFID;
 }
 
-bool Student::isValidName(const string& n) {
+bool Student::isValidName(string_view n) {
     if (n.empty()) return false;
 
     // Fix: I failed test cases 1... We should allow alphabetic characters and spaces...
@@ -63,9 +91,6 @@ bool Student::isValidName(const string& n) {
     });
 }
 
-bool Student::isValidClassCode(const string& code) {
-    if (code.size() != 7) return false;
-    for (int i = 0; i < 3; ++i) if (!isupper(static_cast<unsigned char>(code[i]))) return false;
-    for (int i = 3; i < 7; ++i) if (!isdigit(static_cast<unsigned char>(code[i]))) return false;
-    return true;
+bool Student::isValidClassCode(string_view code) {
+    return encodeClassCode(code) != INVALID_CLASS_ID;
 }
@@ -1,46 +1,170 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstdint>
+#include <type_traits>
 #include <algorithm> // Added for validators if implemented in header, but okay here too.
+#include "FlatHashMap.h"
+#include "NamePool.h"
 
 using namespace std;
 
+/*
+ * Packed keys
+ * class codes are exactly 3 uppercase letters + 4 digits, so we can pack them
+ * as (letters in base 26) * 10000 + digits, which is < 26^3 * 10^4 < 2^32
+ * the packing keeps the string order, so sorting ClassIds sorts the codes too
+ * UFIDs are exactly 8 digits, so the number itself (< 10^8 < 2^27) is the key
+ * we only turn them back into strings when printing...
+ */
+using ClassId = uint32_t;
+constexpr ClassId INVALID_CLASS_ID = 0xFFFFFFFFu;
+constexpr uint32_t INVALID_UFID = 0xFFFFFFFFu;
+
+// returns INVALID_CLASS_ID if code is not AAA0000 style
+constexpr ClassId encodeClassCode(string_view code) {
+    if (code.size() != 7) return INVALID_CLASS_ID;
+    uint32_t letters = 0, digits = 0;
+    for (size_t i = 0; i < 3; ++i) {
+        if (code[i] < 'A' || code[i] > 'Z') return INVALID_CLASS_ID;
+        letters = letters * 26 + static_cast<uint32_t>(code[i] - 'A');
+    }
+    for (size_t i = 3; i < 7; ++i) {
+        if (code[i] < '0' || code[i] > '9') return INVALID_CLASS_ID;
+        digits = digits * 10 + static_cast<uint32_t>(code[i] - '0');
+    }
+    return letters * 10000 + digits;
+}
+
+// returns INVALID_UFID unless id is exactly 8 digits (leading zeros are fine)
+constexpr uint32_t encodeUFID(string_view id) {
+    if (id.size() != 8) return INVALID_UFID;
+    uint32_t value = 0;
+    for (char c : id) {
+        if (c < '0' || c > '9') return INVALID_UFID;
+        value = value * 10 + static_cast<uint32_t>(c - '0');
+    }
+    return value;
+}
+
+static_assert(encodeClassCode("AAA0000") == 0, "class code packing");
+static_assert(encodeClassCode("ZZZ9999") == 26u * 26u * 26u * 10000u - 1, "class code packing");
+static_assert(encodeClassCode("COP3530") < encodeClassCode("COP3531"), "packing keeps order");
+static_assert(encodeUFID("00000123") == 123, "ufid packing");
+
+string formatClassCode(ClassId id);
+string formatUFID(uint32_t ufid);
+
+// key traits for the flat registries (see FlatHashMap.h)
+// fromText lets the maps be searched straight from an input token
+
+struct ClassKeyTraits {
+    static constexpr ClassId INVALID = INVALID_CLASS_ID;
+    static uint64_t hash(ClassId id) { return mixHashKey(id); }
+    static ClassId fromText(string_view code) { return encodeClassCode(code); }
+};
+
+struct UFIDKeyTraits {
+    static constexpr uint32_t INVALID = INVALID_UFID;
+    static uint64_t hash(uint32_t ufid) { return mixHashKey(ufid); }
+    static uint32_t fromText(string_view ufid) { return encodeUFID(ufid); }
+};
+
+// UFIDKey is what the Graph API takes for a UFID
+// it can come from the input string (keeps leading zeros)
+// or from an int, the old main.cpp read ufids with >> int, so an int is taken
+// at face value and 123 is still not an 8 digit UFID
+struct UFIDKey {
+    uint32_t value = INVALID_UFID;
+
+    constexpr UFIDKey() = default;
+    constexpr UFIDKey(string_view id) : value(encodeUFID(id)) {}
+    constexpr UFIDKey(const char* id) : UFIDKey(string_view(id)) {}
+    UFIDKey(const string& id) : UFIDKey(string_view(id)) {}
+    constexpr UFIDKey(int id)
+        : value(id >= 10000000 && id <= 99999999 ? static_cast<uint32_t>(id) : INVALID_UFID) {}
+
+    constexpr bool valid() const { return value != INVALID_UFID; }
+    constexpr bool operator==(const UFIDKey& other) const { return value == other.value; }
+    constexpr bool operator!=(const UFIDKey& other) const { return value != other.value; }
+};
+
+// Span is a tiny non-owning view over a run of T (we are on C++17, no std::span)
+template <typename T>
+class Span {
+public:
+    constexpr Span() = default;
+    constexpr Span(const T* data, size_t count) : ptr(data), count(count) {}
+
+    constexpr const T* begin() const { return ptr; }
+    constexpr const T* end() const { return ptr + count; }
+    constexpr const T* data() const { return ptr; }
+    constexpr size_t size() const { return count; }
+    constexpr bool empty() const { return count == 0; }
+    constexpr const T& operator[](size_t i) const { return ptr[i]; }
+
+private:
+    const T* ptr = nullptr;
+    size_t count = 0;
+};
+
+using ClassSpan = Span<ClassId>;
+
 /*
  * Student Class
+ * a student is a small flat record now: packed ufid, residence, and up to
+ * MAX_CLASSES packed class ids stored inline (no heap at all)
+ * the name lives in the Graph's name pool, we only keep where it starts and
+ * how long it is, so Student stays trivially copyable (40 bytes)
  */
 class Student {
+public:
+    static constexpr int MAX_CLASSES = 6;
+
 private:
-    string name;                // Full name of the student
-    string ufid;                   // 8-digit UFID (int)
-    // int age;                 // REMOVED: Not in project requirements
-    int residence = 0;          // Residence location ID
-    vector<string> classCodes;  // Classes
+    UFIDKey ufid;                        // 8-digit UFID (packed)
+    // int age;                          // REMOVED: Not in project requirements
+    int residence = 0;                   // Residence location ID
+    ClassId classCodes[MAX_CLASSES] = {}; // Classes (packed), first classCount are used
+    uint32_t nameOffset = 0;             // Full name of the student, as a slice of the name pool
+    uint16_t nameLength = 0;
+    uint8_t classCount = 0;
+    uint8_t reserved = 0;                // fills the padding, snapshots write records raw
 
 public:
     // Constructors
     Student() = default;
     
     // Updated Constructor: Removed age
-    Student(const string& studentName, const string& ufid, const vector<string>& classes, int res);
+    // the name is given as a slice (offset, length) of the owner's name pool
+    // classes beyond MAX_CLASSES are dropped, Graph checks the count first anyway
+    Student(uint32_t nameOffset, uint16_t nameLength, UFIDKey ufid, ClassSpan classes, int res);
 
     // Getters
-    string getName() const;
-    string getUFID() const;
+    string_view getName(const NamePool& namePool) const;
+    uint32_t getNameOffset() const { return nameOffset; }
+    uint16_t getNameLength() const { return nameLength; }
+    void setNameOffset(uint32_t offset) { nameOffset = offset; }
+    UFIDKey getUFID() const;
     // int getAge() const;      we dont need age....
     int getResidence() const;
     int getNumberOfClasses() const;
-    vector<string> getClasses() const;
+    ClassSpan getClasses() const;
 
     // Query
-    bool hasClass(const string& classCode) const;
+    bool hasClass(ClassId classCode) const;
 
     // Class operations
-    bool addClass(const string& classCode);
-    bool removeClass(const string& classCode);
-    bool replaceClass(const string& oldClass, const string& newClass);
+    bool addClass(ClassId classCode);
+    bool removeClass(ClassId classCode);
+    bool replaceClass(ClassId oldClass, ClassId newClass);
 
     // Validators (static helpers)
-    static bool isValidUFID(const string& ufid);
-    static bool isValidName(const string& name);
-    static bool isValidClassCode(const string& code);
+    static bool isValidUFID(string_view ufid);
+    static bool isValidName(string_view name);
+    static bool isValidClassCode(string_view code);
 };
+
+static_assert(is_trivially_copyable<Student>::value, "Student should be a flat record");
+static_assert(sizeof(Student) <= 64, "Student should fit in one cache line");
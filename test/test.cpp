@@ -6,10 +6,43 @@
 
 #include "../src/student.h"
 #include "../src/Graph.h"
+#include "../src/Commands.h"
+#include "../src/Server.h"
+#include "../src/GraphStore.h"
+#include "../src/ShmChannel.h"
+#include "../src/CampusGenerator.h"
+#include "../src/CommandTrace.h"
+#include "../src/CommandStats.h"
+#include "../src/PerfCounters.h"
+#include "../src/TimedRegions.h"
+#include "../src/SlowQueryLog.h"
+#include "../src/Snapshot.h"
+#include "../bench/AllocationCounter.h"
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <random>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
+// where the shipped data/ is (CMake passes the source tree's), for the benchmarks
+#ifndef PROJECT_DATA_DIR
+#define PROJECT_DATA_DIR "data"
+#endif
+
 /*
 TEST 1: Incorrect commands / invalid insertions
 */
@@ -182,3 +215,1754 @@ TEST_CASE("shortestTimesFromResidence: reachable then unreachable after edges to
     auto shortest2 = g.shortestTimesFromResidence(residence, classes);
     REQUIRE(shortest2["COP3530"] == -1);
 }
+
+/*
+ TEST 8: packed class codes / UFIDs and the inline class list
+*/
+TEST_CASE("Packed keys round trip and Student keeps classes inline") {
+    REQUIRE(formatClassCode(encodeClassCode("COP3530")) == "COP3530");
+    REQUIRE(formatUFID(encodeUFID("01234567")) == "01234567");
+    REQUIRE(encodeClassCode("cop3530") == INVALID_CLASS_ID);
+    REQUIRE(UFIDKey(123).valid() == false);
+
+    Graph g;
+    g.addEdge(1, 2, 4);
+    g.setClassInfo("COP3530", ClassInfo{2, "10:00", "11:00"});
+    g.setClassInfo("MAC2311", ClassInfo{1, "12:00", "13:00"});
+
+    // leading zeros have to survive
+    REQUIRE(g.addStudent("Zoe Zero", "01234567", {"MAC2311", "COP3530"}, 1) == true);
+    REQUIRE(g.getStudentName("01234567") == "Zoe Zero");
+
+    ClassSpan ids = g.getStudentClassIds("01234567");
+    REQUIRE(ids.size() == 2);
+    REQUIRE(formatClassCode(ids[0]) == "MAC2311");
+
+    // dropping every class removes the student (and its name)
+    REQUIRE(g.dropClass("01234567", "MAC2311") == true);
+    REQUIRE(g.dropClass("01234567", "COP3530") == true);
+    REQUIRE(g.getStudentName("01234567") == "");
+}
+
+/*
+ TEST 9: the flat hash table has to agree with unordered_map
+*/
+TEST_CASE("FlatHashMap matches unordered_map under random insert/erase") {
+    FlatHashMap<uint32_t, int, UFIDKeyTraits> flat;
+    unordered_map<uint32_t, int> ref;
+    mt19937 rng(3530);
+
+    for (int step = 0; step < 20000; ++step) {
+        uint32_t key = rng() % 2000;
+        if (rng() % 3 == 0) {
+            REQUIRE(flat.erase(key) == ref.erase(key));
+        } else {
+            flat[key] = step;
+            ref[key] = step;
+        }
+    }
+    REQUIRE(flat.size() == ref.size());
+    for (const auto& kv : ref) {
+        auto it = flat.find(kv.first);
+        REQUIRE(it != flat.end());
+        REQUIRE(it->second == kv.second);
+    }
+
+    // lookup by text goes through the same table
+    flat[12345678] = 7;
+    REQUIRE(flat.find(string_view("12345678"))->second == 7);
+    REQUIRE(flat.find(string_view("1234567x")) == flat.end());
+}
+
+/*
+ TEST 10: direct-address registry behaves like the hashed one
+*/
+TEST_CASE("Direct-address UFID registry: insert, uniqueness, removal") {
+    for (RegistryMode mode : {RegistryMode::Hashed, RegistryMode::DirectAddress}) {
+        Graph g(mode);
+        g.addEdge(1, 2, 3);
+        g.setClassInfo("COP3530", ClassInfo{2, "10:00", "11:00"});
+
+        REQUIRE(g.addStudent("Ann", "00000001", {"COP3530"}, 1) == true);
+        REQUIRE(g.addStudent("Ben", "00004097", {"COP3530"}, 1) == true); // next page over
+        REQUIRE(g.addStudent("Cat", "99999999", {"COP3530"}, 2) == true);
+        REQUIRE(g.addStudent("Dup", "00004097", {"COP3530"}, 1) == false);
+
+        // removing the first student must not disturb the others
+        REQUIRE(g.removeStudent("00000001") == true);
+        REQUIRE(g.getStudentName("99999999") == "Cat");
+        REQUIRE(g.getStudentResidence("99999999") == 2);
+        REQUIRE(g.getStudentName("00000001") == "");
+
+        // removeClass cascades through everyone left
+        REQUIRE(g.removeClass("COP3530") == 2);
+        REQUIRE(g.removeStudent("00004097") == false);
+    }
+}
+
+/*
+ TEST 11: slab handles go stale when their record is freed
+*/
+TEST_CASE("Slab reuses freed slots and rejects stale handles") {
+    Slab<int> slab;
+    SlabHandle a = slab.allocate(1);
+    SlabHandle b = slab.allocate(2);
+    REQUIRE(slab.free(a) == true);
+    REQUIRE(slab.get(a) == nullptr);
+    REQUIRE(slab.free(a) == false);
+
+    // the freed slot comes back with a new generation
+    SlabHandle c = slab.allocate(3);
+    REQUIRE(Slab<int>::indexOf(c) == Slab<int>::indexOf(a));
+    REQUIRE(c != a);
+    REQUIRE(*slab.get(c) == 3);
+    REQUIRE(*slab.get(b) == 2);
+    REQUIRE(slab.size() == 2);
+}
+
+/*
+ TEST 12: CSV loaders skip malformed rows and say which line they were on
+*/
+TEST_CASE("CSV loaders report malformed rows with line numbers") {
+    const string edgesPath = "test_edges_tmp.csv";
+    {
+        ofstream out(edgesPath);
+        out << "LocationID_1,LocationID_2,Name_1,Name_2,Time\r\n"
+            << "1,2,Hume Hall,Graham Hall,3\r\n"
+            << "1,x,Hume Hall,Nowhere,4\n"       // line 3: bad id
+            << "\n"
+            << "2,3,Graham Hall,Broward Hall,5\n"
+            << "3,4,short row\n";               // line 6: too few fields
+    }
+    Graph g;
+    REQUIRE(g.loadEdgesCSV(edgesPath) == true);
+    REQUIRE(g.checkEdgeStatus(1, 2) == "open");
+    REQUIRE(g.checkEdgeStatus(1, 3) == "DNE");
+    REQUIRE(g.getLoadErrors().size() == 2);
+    REQUIRE(g.getLoadErrors()[0].line == 3);
+    REQUIRE(g.getLoadErrors()[1].line == 6);
+    REQUIRE(g.loadEdgesCSV("does/not/exist.csv") == false);
+    remove(edgesPath.c_str());
+}
+
+/*
+ TEST 13: the parallel edge loader builds the same graph as addEdge
+*/
+TEST_CASE("Parallel chunked edge loading matches addEdge order") {
+    const string edgesPath = "test_edges_big_tmp.csv";
+    Graph byHand;
+    {
+        ofstream out(edgesPath);
+        out << "LocationID_1,LocationID_2,Name_1,Name_2,Time\n";
+        mt19937 rng(42);
+        for (int i = 0; i < 30000; ++i) {
+            int u = static_cast<int>(rng() % 6000), v = static_cast<int>(rng() % 6000);
+            int w = 1 + static_cast<int>(rng() % 20);
+            out << u << "," << v << ",A,B," << w << "\n";
+            byHand.addEdge(u, v, w);
+        }
+    }
+    Graph loaded;
+    loaded.setParallelLoadThreshold(0); // force the chunked path
+    REQUIRE(loaded.loadEdgesCSV(edgesPath) == true);
+    REQUIRE(loaded.getLoadErrors().empty());
+
+    mt19937 rng(7);
+    for (int i = 0; i < 50; ++i) {
+        int a = static_cast<int>(rng() % 6000), b = static_cast<int>(rng() % 6000);
+        REQUIRE(loaded.checkEdgeStatus(a, b) == byHand.checkEdgeStatus(a, b));
+        PathResult x = loaded.dijkstra(a, b), y = byHand.dijkstra(a, b);
+        REQUIRE(x.totalCost == y.totalCost);
+        REQUIRE(x.path == y.path);
+    }
+
+    // the same links too: a toggle closes both directions of the same edge
+    for (int i = 0; i < 200; ++i) {
+        int a = static_cast<int>(rng() % 6000), b = static_cast<int>(rng() % 6000);
+        if (byHand.checkEdgeStatus(a, b) == "DNE") continue;
+        REQUIRE(loaded.toggleEdgesClosure({{a, b}}));
+        REQUIRE(byHand.toggleEdgesClosure({{a, b}}));
+        REQUIRE(loaded.checkEdgeStatus(b, a) == byHand.checkEdgeStatus(b, a));
+    }
+    for (int i = 0; i < 50; ++i) {
+        int a = static_cast<int>(rng() % 6000), b = static_cast<int>(rng() % 6000);
+        REQUIRE(loaded.dijkstra(a, b).path == byHand.dijkstra(a, b).path);
+    }
+    remove(edgesPath.c_str());
+}
+
+/*
+ TEST 14: snapshots bring back closures and students, and reject corrupt files
+*/
+TEST_CASE("Binary snapshot round trip and checksum") {
+    const string snapPath = "test_snapshot_tmp.bin";
+    Graph g;
+    g.addEdge(1, 2, 5);
+    g.addEdge(2, 3, 5);
+    g.setClassInfo("COP3530", ClassInfo{3, "10:00", "11:00"});
+    g.addStudent("Sam Snap", "01234567", {"COP3530"}, 1);
+    g.toggleEdgesClosure({{2, 3}});
+    REQUIRE(g.saveSnapshot(snapPath) == true);
+
+    Graph loaded(RegistryMode::DirectAddress);
+    REQUIRE(loaded.loadSnapshot(snapPath) == true);
+    REQUIRE(loaded.checkEdgeStatus(2, 3) == "closed");
+    REQUIRE(loaded.checkEdgeStatus(1, 2) == "open");
+    REQUIRE(loaded.getStudentName("01234567") == "Sam Snap");
+    REQUIRE(loaded.getClassInfo("COP3530").endTime == "11:00");
+    REQUIRE(loaded.dijkstra(1, 3).totalCost == -1);
+    REQUIRE(loaded.getRegistryMode() == RegistryMode::DirectAddress);
+
+    // a time string too long for its 16 bit length isn't cut short, the save fails
+    Graph longTime = g;
+    longTime.setClassInfo("MAC2311", ClassInfo{2, string(70000, '1'), "11:00"});
+    REQUIRE_FALSE(longTime.saveSnapshot(snapPath + ".long"));
+
+    // a name pool over more than one 64KB block comes back name for name
+    Graph crowd = g;
+    REQUIRE(crowd.addStudent(string(40000, 'a'), "07654321", {"COP3530"}, 1));
+    REQUIRE(crowd.addStudent(string(40000, 'b'), "07654322", {"COP3530"}, 2)); // starts the next block
+    REQUIRE(crowd.addStudent("Tim Tail", "07654323", {"COP3530"}, 2));
+    REQUIRE(crowd.saveSnapshot(snapPath + ".crowd"));
+    Graph crowdLoaded;
+    REQUIRE(crowdLoaded.loadSnapshot(snapPath + ".crowd"));
+    REQUIRE(crowdLoaded.getStudentName("07654321") == string(40000, 'a'));
+    REQUIRE(crowdLoaded.getStudentName("07654322") == string(40000, 'b'));
+    REQUIRE(crowdLoaded.getStudentName("07654323") == "Tim Tail");
+    REQUIRE(crowdLoaded.getStudentName("01234567") == "Sam Snap");
+    remove((snapPath + ".crowd").c_str());
+
+    // a record whose class count is out of range is refused even with a good
+    // checksum (a file made by hand, not damaged): its classes are inline
+    {
+        ifstream in(snapPath, ios::binary);
+        string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        ClassId id = encodeClassCode("COP3530"), ids[2] = {id, encodeClassCode("COP3502")};
+        Student one(0, 8, UFIDKey("01234567"), ClassSpan(ids, 1), 1);
+        Student two(0, 8, UFIDKey("01234567"), ClassSpan(ids, 2), 1);
+        const char* a = reinterpret_cast<const char*>(&one);
+        const char* b = reinterpret_cast<const char*>(&two);
+        size_t at = bytes.find(string(a, sizeof(Student)));
+        REQUIRE(at != string::npos);
+        size_t countByte = 0;
+        while (!(a[countByte] == 1 && b[countByte] == 2)) ++countByte;
+        bytes[at + countByte] = Student::MAX_CLASSES + 1;
+        SnapshotHeader header;
+        memcpy(&header, bytes.data(), sizeof(header));
+        header.checksum = fingerprintBytes(string_view(bytes).substr(sizeof(header)));
+        memcpy(&bytes[0], &header, sizeof(header));
+        ofstream(snapPath + ".classes", ios::binary) << bytes;
+        Graph handMade;
+        REQUIRE_FALSE(handMade.loadSnapshot(snapPath + ".classes"));
+        bytes[at + countByte] = 1; // put back, it loads again
+        header.checksum = fingerprintBytes(string_view(bytes).substr(sizeof(header)));
+        memcpy(&bytes[0], &header, sizeof(header));
+        ofstream(snapPath + ".classes", ios::binary | ios::trunc) << bytes;
+        REQUIRE(handMade.loadSnapshot(snapPath + ".classes"));
+        remove((snapPath + ".classes").c_str());
+    }
+
+    // flip one byte in the payload, the checksum has to catch it
+    {
+        fstream f(snapPath, ios::in | ios::out | ios::binary);
+        f.seekg(0, ios::end);
+        streamoff size = f.tellg();
+        f.seekp(size - 3);
+        f.put('\x7f');
+    }
+    Graph other;
+    other.addEdge(7, 8, 1);
+    REQUIRE(other.loadSnapshot(snapPath) == false);
+    REQUIRE(other.checkEdgeStatus(7, 8) == "open"); // untouched
+    remove(snapPath.c_str());
+}
+
+/*
+ TEST 15: the landmark index gives dijkstra's costs, is cached on disk,
+ and stays exact (and in use) whatever edges are closed
+*/
+TEST_CASE("Landmark routing index and its cache") {
+    const string edgesPath = "test_edges_routing_tmp.csv";
+    const string cachePath = "test_routing_cache_tmp.bin";
+    remove(cachePath.c_str());
+    {
+        ofstream out(edgesPath);
+        out << "LocationID_1,LocationID_2,Name_1,Name_2,Time\n";
+        mt19937 rng(11);
+        for (int i = 0; i < 3000; ++i) {
+            int u = static_cast<int>(rng() % 800), v = static_cast<int>(rng() % 800);
+            out << u << "," << v << ",A,B," << 1 + rng() % 30 << "\n";
+        }
+        out << "900,901,Island,Island,4\n"; // a second component
+    }
+
+    Graph g;
+    REQUIRE(g.loadEdgesCSV(edgesPath) == true);
+    g.enableRoutingIndex(cachePath);
+    RoutingEngine engine;
+    g.shortestTime(1, 2, &engine); // first query starts the build
+    REQUIRE(engine == RoutingEngine::Dijkstra);
+    g.waitForRoutingIndex();
+    REQUIRE(g.routingIndexReady());
+
+    mt19937 rng(5);
+    for (int i = 0; i < 200; ++i) {
+        int a = static_cast<int>(rng() % 802), b = static_cast<int>(rng() % 802);
+        if (i % 50 == 0) b = 900;
+        REQUIRE(g.shortestTime(a, b, &engine) == g.dijkstra(a, b).totalCost);
+        REQUIRE(engine == RoutingEngine::Landmarks);
+    }
+
+    // a second graph from the same file maps the cache in, no build
+    Graph again;
+    REQUIRE(again.loadEdgesCSV(edgesPath) == true);
+    again.enableRoutingIndex(cachePath);
+    again.prepareRoutingIndex();
+    REQUIRE(again.routingIndexReady());
+    REQUIRE(again.shortestTime(3, 4, &engine) == again.dijkstra(3, 4).totalCost);
+    REQUIRE(engine == RoutingEngine::Landmarks);
+
+    // closing edges doesn't touch the index, the bounds are still bounds
+    // and A* only walks the open edges, so it's still dijkstra's answer
+    vector<pair<int,int>> closing;
+    for (int from = 0; from < 800 && closing.size() < 300; ++from)
+        if (again.checkEdgeStatus(from, from + 1) == "open") closing.emplace_back(from, from + 1);
+    for (int i = 0; i < 300; ++i) {
+        int u = static_cast<int>(rng() % 800), v = static_cast<int>(rng() % 800);
+        if (again.checkEdgeStatus(u, v) == "open") closing.emplace_back(u, v);
+    }
+    for (const auto& e : closing) REQUIRE(again.toggleEdgesClosure({e}));
+    REQUIRE(again.routingIndexReady());
+    for (int i = 0; i < 200; ++i) {
+        int a = static_cast<int>(rng() % 802), b = static_cast<int>(rng() % 802);
+        REQUIRE(again.shortestTime(a, b, &engine) == again.dijkstra(a, b).totalCost);
+        REQUIRE(engine == RoutingEngine::Landmarks);
+    }
+
+    // opening them all again is where we started
+    for (const auto& e : closing) REQUIRE(again.toggleEdgesClosure({e}));
+    for (int i = 0; i < 50; ++i) {
+        int a = static_cast<int>(rng() % 800), b = static_cast<int>(rng() % 800);
+        REQUIRE(again.shortestTime(a, b) == g.shortestTime(a, b));
+    }
+
+    // a new edge does change the key: dijkstra until the rebuild lands
+    again.addEdge(0, 901, 2);
+    REQUIRE_FALSE(again.routingIndexReady());
+    REQUIRE(again.shortestTime(0, 900, &engine) == again.dijkstra(0, 900).totalCost);
+    REQUIRE(engine == RoutingEngine::Dijkstra);
+    again.waitForRoutingIndex();
+    REQUIRE(again.shortestTime(0, 900, &engine) == again.dijkstra(0, 900).totalCost);
+    REQUIRE(engine == RoutingEngine::Landmarks);
+    remove(edgesPath.c_str());
+    remove(cachePath.c_str());
+}
+
+/*
+ TEST 16: the command tokenizer reads lines the way the old stringstream loop did
+*/
+TEST_CASE("Command tokenizer and dispatch") {
+    REQUIRE(commandKindOf("insert") == CommandKind::Insert);
+    REQUIRE(commandKindOf("printShortestEdges") == CommandKind::PrintShortestEdges);
+    REQUIRE(commandKindOf("toggleEdgesClosure") == CommandKind::ToggleEdgesClosure);
+    REQUIRE(commandKindOf("insertx") == CommandKind::Unknown);
+    REQUIRE(commandKindOf("") == CommandKind::Unknown);
+
+    CommandTokenizer tok("  \"Ann  Lee\" 01234567 +12 3abc x");
+    string_view name, ufid;
+    int a = -1, b = -1;
+    REQUIRE(tok.name(name));
+    REQUIRE(name == "Ann  Lee");
+    REQUIRE(tok.word(ufid));
+    REQUIRE(ufid == "01234567");
+    REQUIRE(tok.integer(a));
+    REQUIRE(a == 12);
+    REQUIRE(tok.integer(b));
+    REQUIRE(b == 3);            // "abc" is left for the next read
+    REQUIRE_FALSE(tok.integer(a));
+    REQUIRE(a == 0);
+    REQUIRE_FALSE(tok.word(name)); // a failed read sticks, like the stream's failbit
+
+    // run a few commands into a temp file and compare the text
+    Graph g;
+    g.addEdge(1, 2, 5);
+    g.setClassInfo("COP3530", ClassInfo{2, "10:00", "11:00"});
+    FILE* f = tmpfile();
+    REQUIRE(f != nullptr);
+    {
+        OutputBuffer out(f, 8); // tiny buffer so it flushes along the way
+        runCommand(g, "insert \"Ann Lee\" 01234567 1 1 COP3530", out);
+        runCommand(g, "insert Bob 01234567 1 1 COP3530", out);
+        runCommand(g, "printShortestEdges 01234567", out);
+        runCommand(g, "printStudentZone 01234567", out);
+        runCommand(g, "checkEdgeStatus 2 1", out);
+        runCommand(g, "", out);
+        runCommand(g, "nonsense 1 2", out);
+    }
+    rewind(f);
+    string text;
+    char buf[256];
+    size_t got;
+    while ((got = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, got);
+    fclose(f);
+    REQUIRE(text == "successful\nunsuccessful\nName: Ann Lee\nCOP3530 | Total Time: 5\n"
+                    "Student Zone Cost For Ann Lee: 5\nopen\nunsuccessful\nunsuccessful\n");
+
+    // a toggle count bigger than the pairs on the line reads what is there
+    // and stops, it doesn't go on (or make room) for the count it was given.
+    // the answer is the stream's: the pairs before the missing one flip, the
+    // missing one (0 0, or 1 0 for a half pair) isn't an edge, so unsuccessful
+    OutputBuffer out(nullptr, 0);
+    AllocationCounter counted;
+    runCommand(g, "toggleEdgesClosure 2000000000 1 2", out);
+    REQUIRE(counted.bytes() < 4096);
+    REQUIRE(out.take() == "unsuccessful\n");
+    REQUIRE(g.checkEdgeStatus(1, 2) == "closed");
+    runCommand(g, "toggleEdgesClosure 2000000000 2 1 1", out);
+    REQUIRE(out.take() == "unsuccessful\n");
+    REQUIRE(g.checkEdgeStatus(1, 2) == "open");
+}
+
+/*
+ TEST 17: batch mode runs the reads in parallel but prints exactly what
+ running the commands one by one prints
+*/
+TEST_CASE("Batch runner output matches sequential execution") {
+    auto build = []() {
+        Graph g;
+        mt19937 rng(99);
+        for (int i = 0; i < 400; ++i) g.addEdge(rng() % 120, rng() % 120, 1 + rng() % 9);
+        g.setClassInfo("COP3530", ClassInfo{5, "10:00", "11:00"});
+        g.setClassInfo("MAC2311", ClassInfo{17, "12:00", "13:00"});
+        g.setClassInfo("PHY2048", ClassInfo{60, "14:00", "15:00"});
+        return g;
+    };
+    vector<string> script;
+    mt19937 rng(1);
+    for (int i = 0; i < 3000; ++i) {
+        int a = static_cast<int>(rng() % 120), b = static_cast<int>(rng() % 120);
+        string ufid = to_string(10000000 + rng() % 20);
+        switch (rng() % 100) { // ~3% mutations, so most read runs go parallel
+        case 0: script.push_back("insert \"Stu Dent\" " + ufid + " " + to_string(a) + " 2 COP3530 PHY2048"); break;
+        case 1: script.push_back("toggleEdgesClosure 1 " + to_string(a) + " " + to_string(b)); break;
+        case 2: script.push_back("replaceClass " + ufid + " COP3530 MAC2311"); break;
+        case 3: script.push_back("printShortestEdges " + ufid); break;
+        case 4: script.push_back("printStudentZone " + ufid); break;
+        case 5: script.push_back("isConnected " + to_string(a) + " " + to_string(b)); break;
+        default: script.push_back("checkEdgeStatus " + to_string(a) + " " + to_string(b)); break;
+        }
+    }
+
+    Graph one = build();
+    OutputBuffer sequential(nullptr, 0);
+    for (const string& line : script) runCommand(one, line, sequential);
+
+    Graph two = build();
+    ThreadPool pool(4);
+    OutputBuffer batched(nullptr, 0);
+    {
+        BatchRunner runner(two, batched, pool);
+        for (const string& line : script) runner.add(line);
+    }
+    REQUIRE(batched.take() == sequential.take());
+    REQUIRE(isMutation(commandKindOfLine("toggleEdgesClosure 0")));
+    REQUIRE_FALSE(isMutation(commandKindOfLine("printStudentZone 12345678")));
+
+    // stats reports on the commands before it, so it can't be batched with them
+    CommandStats& global = CommandStats::global();
+    global.reset();
+    global.enable();
+    {
+        BatchRunner runner(two, batched, pool);
+        for (int i = 0; i < 100; ++i) runner.add("checkEdgeStatus 1 2");
+        runner.add("stats");
+        for (int i = 0; i < 100; ++i) runner.add("checkEdgeStatus 1 2");
+    }
+    global.enable(false);
+    global.reset();
+    string table = batched.take();
+    size_t row = table.find("\ncheckEdgeStatus ");
+    REQUIRE(row != string::npos);
+    REQUIRE(stoull(table.substr(row + 17)) == 100);
+}
+
+/*
+ TEST 18: server mode answers pipelined commands over a unix socket
+ (Linux only, the event loop is epoll)
+*/
+#if defined(__linux__)
+TEST_CASE("Command server over a unix domain socket") {
+    const string path = "test_server_tmp.sock";
+    Graph g;
+    g.addEdge(1, 2, 5);
+    g.setClassInfo("COP3530", ClassInfo{2, "10:00", "11:00"});
+    GraphStore store(g);
+    CommandServer server(store, 2);
+    string error;
+    REQUIRE(server.listen("unix:" + path, error));
+    thread loop([&]() { server.run(); });
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    REQUIRE(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+
+    // everything in one write, the server has to split and order it
+    string request = "#frame\ninsert \"Ann Lee\" 01234567 1 1 COP3530\r\n"
+                     "printShortestEdges 01234567\ncheckEdgeStatus 2 1\n#quit\ncheckEdgeStatus 1 2\n";
+    REQUIRE(write(fd, request.data(), request.size()) == static_cast<ssize_t>(request.size()));
+    string reply;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) reply.append(buf, static_cast<size_t>(n));
+    close(fd);
+    REQUIRE(reply == ".\nsuccessful\n.\nName: Ann Lee\nCOP3530 | Total Time: 5\n.\nopen\n.\n.\n");
+
+    server.stop();
+    loop.join();
+    REQUIRE(store.snapshot()->getStudentName("01234567") == "Ann Lee"); // the graph stays loaded
+    REQUIRE(g.getStudentName("01234567") == ""); // the store changed its own copy
+    REQUIRE(server.listen("bogus:1", error) == false);
+}
+#endif
+
+/*
+ TEST 19: copies of a graph share their parts until one of them changes,
+ and a GraphStore publishes whole versions: a reader on another thread
+ never sees half of a change
+*/
+TEST_CASE("Copy-on-write graphs and GraphStore versions") {
+    Graph base;
+    base.addEdge(1, 2, 5);
+    base.addEdge(2, 3, 4);
+    base.setClassInfo("COP3530", ClassInfo{3, "10:00", "11:00"});
+    REQUIRE(base.addStudent("Ann Lee", UFIDKey("01234567"), {"COP3530"}, 1));
+
+    Graph copy(base);
+    REQUIRE(copy.sharesStateWith(base));
+    REQUIRE(copy.toggleEdgesClosure({{1, 2}}));
+    REQUIRE(copy.removeStudent(UFIDKey("01234567")));
+    REQUIRE_FALSE(copy.sharesStateWith(base));
+    REQUIRE(copy.checkEdgeStatus(1, 2) == "closed");
+    REQUIRE(base.checkEdgeStatus(1, 2) == "open");
+    REQUIRE(base.getStudentName(UFIDKey("01234567")) == "Ann Lee");
+    Graph untouched(base);
+    REQUIRE_FALSE(untouched.toggleEdgesClosure({{1, 3}})); // no such edge, nothing copied
+    REQUIRE(untouched.removeClass("COP3502") == 0);
+    REQUIRE(untouched.sharesStateWith(base));
+
+    // a toggle on a copy copies the closed bits, never the adjacency lists
+    Graph campus;
+    for (int i = 0; i < 20000; ++i) campus.addEdge(i, i + 1, 1);
+    REQUIRE(campus.toggleEdgesClosure({{19000, 19001}}));
+    Graph next(campus);
+    AllocationCounter counted;
+    REQUIRE(next.toggleEdgesClosure({{5, 6}, {19000, 19001}}));
+    REQUIRE(counted.allocations() <= 3); // the argument's vector, the part, its bits
+    REQUIRE(counted.bytes() < 20000 / 8 + 256);
+    REQUIRE(next.checkEdgeStatus(6, 5) == "closed");
+    REQUIRE(next.checkEdgeStatus(19001, 19000) == "open");
+    REQUIRE(campus.checkEdgeStatus(5, 6) == "open");
+    REQUIRE(campus.checkEdgeStatus(19001, 19000) == "closed");
+    REQUIRE(next.getClosureEpoch() == campus.getClosureEpoch() + 1);
+
+    // a student added or removed on a copy copies the slab chunk, the index
+    // page or shard and the name block it is in, never the whole registry
+    for (RegistryMode mode : {RegistryMode::Hashed, RegistryMode::DirectAddress}) {
+        Graph school(mode);
+        school.addEdge(1, 2, 1);
+        school.setClassInfo("COP3530", ClassInfo{2, "10:00", "11:00"});
+        for (int i = 0; i < 20000; ++i)
+            REQUIRE(school.addStudent("Student Name", to_string(10000000 + i), {"COP3530"}, 1));
+        MemoryUsage whole = school.memoryUsage();
+        Graph changed(school);
+        AllocationCounter counted;
+        REQUIRE(changed.addStudent("New Student", "20000000", {"COP3530"}, 2));
+        REQUIRE(changed.removeStudent("10000005"));
+        REQUIRE(counted.bytes() < 300000);
+        REQUIRE(whole.studentRecords + whole.studentIndex + whole.studentNames > 1000000);
+        REQUIRE(changed.getStudentResidence("20000000") == 2);
+        REQUIRE(changed.getStudentName("10000005") == "");
+        REQUIRE(changed.getStudentName("10019999") == "Student Name");
+        REQUIRE(school.getStudentName("20000000") == "");
+        REQUIRE(school.getStudentName("10000005") == "Student Name");
+        REQUIRE(school.getStudentCount() == 20000);
+    }
+
+    // self loops and parallel edges toggle like they always did: a self
+    // loop stays as it is, of two parallel edges only the first one flips
+    Graph odd;
+    odd.addEdge(1, 1, 3);
+    odd.addEdge(1, 2, 5);
+    odd.addEdge(2, 1, 7);
+    REQUIRE(odd.toggleEdgesClosure({{1, 1}, {1, 2}}));
+    REQUIRE(odd.checkEdgeStatus(1, 1) == "open");
+    REQUIRE(odd.checkEdgeStatus(2, 1) == "closed");
+    REQUIRE(odd.shortestTime(1, 2) == 7);
+
+    // the writer flips (1,2) and (2,3) in one change, readers check both agree
+    GraphStore store(base);
+    uint64_t before = store.version();
+    atomic<bool> done{false};
+    atomic<size_t> mixed{0};
+    vector<thread> readers;
+    for (int t = 0; t < 3; ++t) {
+        readers.emplace_back([&]() {
+            GraphStore::Reader reader(store);
+            while (!done.load()) {
+                const Graph& g = reader.get();
+                if (g.checkEdgeStatus(1, 2) != g.checkEdgeStatus(2, 3)) ++mixed;
+                if (g.shortestTime(1, 3) != -1 && g.shortestTime(1, 3) != 9) ++mixed;
+            }
+        });
+    }
+    for (int i = 0; i < 2000; ++i)
+        REQUIRE(store.update([](Graph& g) { return g.toggleEdgesClosure({{1, 2}, {2, 3}}); }));
+    done = true;
+    for (thread& t : readers) t.join();
+    REQUIRE(mixed == 0);
+    REQUIRE(store.version() == before + 2000);
+    REQUIRE(store.snapshot()->checkEdgeStatus(1, 2) == "open"); // an even number of flips
+
+    // a change that fails publishes nothing, one that works is seen right away
+    REQUIRE_FALSE(store.update([](Graph& g) { return g.removeStudent(UFIDKey("99999999")); }));
+    REQUIRE(store.version() == before + 2000);
+    GraphStore::Reader reader(store);
+    REQUIRE(reader.get().getStudentName("01234567") == "Ann Lee");
+    REQUIRE(store.update([](Graph& g) { return g.removeStudent(UFIDKey("01234567")); }));
+    REQUIRE(reader.get().getStudentName("01234567") == "");
+    REQUIRE(base.getStudentName("01234567") == "Ann Lee");
+}
+
+/*
+ TEST 20: the work-stealing pool runs every task exactly once (even very
+ uneven ones), and the bulk reports give the per-student answers
+*/
+TEST_CASE("Work-stealing pool and bulk student reports") {
+    ThreadPool pool(4);
+    vector<atomic<int>> runs(1000);
+    vector<atomic<int>> busy(pool.concurrency());
+    atomic<int> clash{0};
+    pool.parallelForWorkers(runs.size(), [&](size_t task, size_t worker) {
+        if (worker >= busy.size() || busy[worker]++ != 0) ++clash;
+        if (task < 10) this_thread::sleep_for(chrono::milliseconds(2)); // the first slice is slow
+        ++runs[task];
+        --busy[worker];
+    });
+    REQUIRE(clash == 0);
+    for (auto& r : runs) REQUIRE(r == 1);
+
+    // a call nested in another pool's task gets indexes of the inner pool
+    ThreadPool small(2);
+    atomic<int> outside{0};
+    pool.parallelForWorkers(64, [&](size_t, size_t) {
+        small.parallelForWorkers(8, [&](size_t, size_t worker) {
+            if (worker >= small.concurrency()) ++outside;
+        });
+    });
+    REQUIRE(outside == 0);
+
+    Graph g;
+    mt19937 rng(7);
+    for (int i = 0; i < 600; ++i) g.addEdge(rng() % 200, rng() % 200, 1 + rng() % 20);
+    const char* codes[] = {"COP3530", "MAC2311", "PHY2048", "CHM2045", "ENC1101", "STA3032"};
+    const char* starts[] = {"08:00", "09:30", "11:00", "12:30", "14:00", "nope"};
+    for (int c = 0; c < 6; ++c)
+        g.setClassInfo(codes[c], ClassInfo{static_cast<int>(rng() % 200), starts[c], c == 2 ? "11:50" : "09:10"});
+    for (int s = 0; s < 300; ++s) {
+        vector<string> mine;
+        for (int c = 0; c < 6; ++c) if (rng() % 2) mine.push_back(codes[c]);
+        if (mine.empty()) mine.push_back(codes[s % 6]);
+        g.addStudent("Stu Dent", UFIDKey(static_cast<int>(20000000 + rng() % 1000000)), mine, static_cast<int>(rng() % 200));
+    }
+    vector<pair<int,int>> closed;
+    for (int i = 0; i < 40; ++i) closed.emplace_back(rng() % 200, rng() % 200);
+    for (auto& e : closed) g.toggleEdgesClosure({e}); // closures count too (a missing edge does nothing)
+
+    vector<StudentTimes> times = g.shortestTimesForAllStudents(&pool);
+    vector<StudentZoneCost> zones = g.zoneCostForAllStudents(&pool);
+    vector<StudentSchedule> schedules = g.verifyAllSchedules(&pool);
+    REQUIRE(times.size() == zones.size());
+    REQUIRE(times.size() == schedules.size());
+    REQUIRE(times.size() > 250);
+
+    // a report from inside the big pool's tasks, over the small pool
+    vector<vector<StudentZoneCost>> nested(8);
+    pool.parallelFor(nested.size(), [&](size_t t) { nested[t] = g.zoneCostForAllStudents(&small); });
+    for (const auto& again : nested) {
+        REQUIRE(again.size() == zones.size());
+        for (size_t i = 0; i < zones.size(); ++i) REQUIRE(again[i].cost == zones[i].cost);
+    }
+    for (size_t i = 0; i < times.size(); ++i) {
+        UFIDKey ufid = times[i].ufid;
+        if (i > 0) REQUIRE(times[i - 1].ufid.value < ufid.value);
+        int residence = g.getStudentResidence(ufid);
+        vector<pair<string,int>> classes = g.getStudentClasses(ufid);
+        sort(classes.begin(), classes.end());
+        REQUIRE(times[i].times.size() == classes.size());
+        for (size_t k = 0; k < classes.size(); ++k) {
+            REQUIRE(times[i].times[k].first == classes[k].first);
+            REQUIRE(times[i].times[k].second == g.shortestTime(residence, classes[k].second));
+        }
+        vector<int> locs;
+        for (ClassId id : g.getStudentClassIds(ufid)) locs.push_back(g.getClassLocationById(id));
+        REQUIRE(zones[i].ufid == ufid);
+        REQUIRE(zones[i].cost == g.computeStudentZoneCost(residence, locs));
+
+        // the verdicts, the slow way (a bad time can't be made)
+        vector<ClassInfo> day;
+        for (const auto& c : classes) day.push_back(g.getClassInfo(c.first));
+        sort(day.begin(), day.end(), [](const ClassInfo& a, const ClassInfo& b) { return a.startTime < b.startTime; });
+        REQUIRE(schedules[i].verdicts.size() == (day.empty() ? 0 : day.size() - 1));
+        for (size_t k = 0; k + 1 < day.size(); ++k) {
+            bool bad = day[k].endTime == "nope" || day[k + 1].startTime == "nope";
+            string expected = bad ? "Cannot make it!" : g.verifySchedule({day[k], day[k + 1]})[0];
+            REQUIRE(schedules[i].verdicts[k] == expected);
+        }
+    }
+}
+
+/*
+ TEST 21: the shared memory channel gives exactly the text answers of the
+ command loop (a small ring, so frames wrap around its end many times),
+ and the typed probes agree with the graph (Linux only, futex + memfd)
+*/
+#if defined(__linux__)
+TEST_CASE("Shared memory channel answers like the command loop") {
+    Graph g;
+    mt19937 rng(21);
+    for (int i = 0; i < 60; ++i) g.addEdge(i, (i + 1) % 60, 1 + static_cast<int>(rng() % 9));
+    for (int i = 0; i < 30; ++i) g.addEdge(static_cast<int>(rng() % 60), static_cast<int>(rng() % 60), 5);
+    const vector<string> codes = {"COP3530", "COP3502", "MAC2311", "PHY2048", "ENC1101"};
+    for (size_t i = 0; i < codes.size(); ++i)
+        g.setClassInfo(codes[i], ClassInfo{static_cast<int>(i * 11), "10:00", "11:00"});
+
+    vector<string> script = {"", "bogus 1 2", "insert \"Ann Lee\" 01234567 3 2 COP3530", "insert Bob",
+                             "removeClass NOPE", "toggleEdgesClosure 0", "toggleEdgesClosure -2 1 2"};
+    for (int i = 0; i < 1500; ++i) {
+        string ufid = to_string(10000000 + rng() % 300);
+        string code = codes[rng() % codes.size()];
+        switch (rng() % 9) {
+        case 0: script.push_back("insert \"Stu " + to_string(i) + "\" " + ufid + " " + to_string(rng() % 60) +
+                                 " 2 " + code + " " + codes[rng() % codes.size()]); break;
+        case 1: script.push_back("remove " + ufid); break;
+        case 2: script.push_back("dropClass " + ufid + " " + code); break;
+        case 3: script.push_back("replaceClass " + ufid + " " + code + " " + codes[rng() % codes.size()]); break;
+        case 4: script.push_back("toggleEdgesClosure 2 " + to_string(i % 60) + " " + to_string((i + 1) % 60) +
+                                 " 5 6"); break;
+        case 5: script.push_back("checkEdgeStatus " + to_string(rng() % 61) + " " + to_string(rng() % 61)); break;
+        case 6: script.push_back("isConnected " + to_string(rng() % 61) + " " + to_string(rng() % 61)); break;
+        case 7: script.push_back((rng() % 2 ? "printShortestEdges " : "printStudentZone ") + ufid); break;
+        default: script.push_back(rng() % 20 ? "removeClass " + code + "X" : "removeClass " + code); break;
+        }
+    }
+
+    string error;
+    unique_ptr<ShmChannel> channel = ShmChannel::create("", error, 4096);
+    REQUIRE(channel != nullptr);
+    GraphStore store(g);
+    ShmServer server(store, *channel, 100);
+    thread serving([&]() { server.run(); });
+    ShmClient client(*channel, 100);
+
+    Graph mirror(g);
+    OutputBuffer expected(nullptr, 0), got(nullptr, 0);
+    for (const string& line : script) {
+        runCommand(mirror, line, expected);
+        REQUIRE(client.call(line, got));
+    }
+    REQUIRE(got.take() == expected.take());
+
+    for (int k = 0; k < 200; ++k) {
+        int a = static_cast<int>(rng() % 61), b = static_cast<int>(rng() % 61);
+        string status = mirror.checkEdgeStatus(a, b);
+        REQUIRE(client.checkEdgeStatus(a, b) == (status == "open" ? 0 : status == "closed" ? 1 : 2));
+        REQUIRE(client.isConnected(a, b) == (mirror.isConnected(a, b) ? 1 : 0));
+    }
+
+    // a toggle too big for one frame is refused on our side, nothing is sent
+    string huge = "toggleEdgesClosure 1000";
+    for (int k = 0; k < 1000; ++k) huge += " 1 2";
+    REQUIRE_FALSE(client.call(huge, got));
+    REQUIRE(client.isConnected(0, 1) == (mirror.isConnected(0, 1) ? 1 : 0));
+
+    // a reply longer than a frame comes in several, and the server goes on
+    string code(3980, 'X');
+    REQUIRE(client.call("explain removeClass " + code, got));
+    string text = got.take();
+    REQUIRE(text.size() > channel->replies().maxFrame());
+    REQUIRE(text.rfind("0\nexplain removeClass " + code + "\n  removeClass: successful", 0) == 0);
+    REQUIRE(text.find("  engine: none\n") != string::npos);
+    REQUIRE(client.isConnected(0, 1) == (mirror.isConnected(0, 1) ? 1 : 0));
+
+    // a request over one frame (encodeCommand never makes one) is read past
+    // and answered as unknown, the server doesn't keep it or stop
+    string reply;
+    REQUIRE(channel->requests().push(string(3 * 4096, char(CommandKind::IsConnected)), 0));
+    REQUIRE(channel->replies().pop(reply, 0));
+    REQUIRE(reply == string(1, '\0'));
+    REQUIRE(client.isConnected(0, 1) == (mirror.isConnected(0, 1) ? 1 : 0));
+
+    server.stop();
+    serving.join();
+    REQUIRE(channel->isClosed());
+    REQUIRE(client.checkEdgeStatus(0, 1) == -1);
+    REQUIRE(store.snapshot()->checkEdgeStatus(0, 1) == mirror.checkEdgeStatus(0, 1));
+}
+#endif
+
+/*
+ TEST 22: the benchmark campuses are the same for the same seed, connected,
+ shaped like data/ (dead ends, a few crossings, short walkways), and the
+ CSVs they write load into the same graph as loadInto
+*/
+TEST_CASE("Generated campuses are deterministic and well formed") {
+    CampusSpec spec;
+    spec.locations = 2000;
+    spec.students = 300;
+    spec.seed = 7;
+    Campus a = generateCampus(spec), b = generateCampus(spec);
+    REQUIRE(a.edges.size() == b.edges.size());
+    for (size_t i = 0; i < a.edges.size(); ++i) {
+        REQUIRE(a.edges[i].u == b.edges[i].u);
+        REQUIRE(a.edges[i].v == b.edges[i].v);
+        REQUIRE(a.edges[i].minutes == b.edges[i].minutes);
+    }
+    REQUIRE(generateCommands(a, 500, 3) == generateCommands(b, 500, 3));
+    spec.seed = 8;
+    Campus other = generateCampus(spec);
+    bool differs = other.edges.size() != a.edges.size();
+    for (size_t i = 0; !differs && i < a.edges.size(); ++i) differs = other.edges[i].minutes != a.edges[i].minutes;
+    REQUIRE(differs);
+
+    REQUIRE(a.locations.size() == 2000);
+    vector<int> degree(a.locations.size() + 1, 0);
+    for (const CampusEdge& e : a.edges) {
+        REQUIRE(e.u != e.v);
+        REQUIRE(e.minutes >= 1);
+        REQUIRE(e.minutes <= 20);
+        ++degree[e.u];
+        ++degree[e.v];
+    }
+    double meanDegree = 2.0 * a.edges.size() / a.locations.size();
+    REQUIRE(meanDegree > 2.2);
+    REQUIRE(meanDegree < 3.2);
+    REQUIRE(count(degree.begin() + 1, degree.end(), 1) > 100); // dead ends
+    REQUIRE(*max_element(degree.begin(), degree.end()) >= 5);  // crossings
+
+    Graph g;
+    a.loadInto(g);
+    for (int id = 1; id <= 2000; id += 97) REQUIRE(g.isConnected(1, id));
+    for (const CampusClass& c : a.classes) REQUIRE(Student::isValidClassCode(c.code));
+    for (const CampusStudent& s : a.students) {
+        REQUIRE(g.getStudentName(UFIDKey(s.ufid)) == s.name);
+        REQUIRE(g.getStudentResidence(UFIDKey(s.ufid)) == s.residence);
+    }
+
+    const string dir = "test_campus_tmp";
+    filesystem::create_directories(dir);
+    REQUIRE(a.writeCSVs(dir));
+    Graph fromFiles;
+    REQUIRE(fromFiles.loadEdgesCSV(dir + "/edges.csv"));
+    REQUIRE(fromFiles.loadClassesCSV(dir + "/classes.csv"));
+    REQUIRE(fromFiles.getLoadErrors().empty());
+    for (size_t i = 0; i < a.edges.size(); i += 37)
+        REQUIRE(fromFiles.shortestTime(a.edges[i].u, 1000) == g.shortestTime(a.edges[i].u, 1000));
+    for (const CampusClass& c : a.classes) REQUIRE(fromFiles.getClassLocation(c.code) == c.info.locationId);
+    filesystem::remove_all(dir);
+
+    // the scripts run like the real thing: some changes succeed
+    OutputBuffer out(nullptr, 0);
+    for (const string& line : generateCommands(a, 2000, 5)) runCommand(g, line, out);
+    string text = out.take();
+    REQUIRE(text.find("successful\n") != string::npos);
+    REQUIRE(text.find("Name: Student") != string::npos);
+}
+
+/*
+ TEST 23: benchmarks, hidden unless asked for ([!benchmark]):
+   Tests "[!benchmark]" --reporter XML::out=bench.xml
+   Tests "[!benchmark]" --reporter benchjson::out=bench.json
+ first on the shipped data/, then on generated campuses of 10^4 and 10^5
+ locations (Bench goes up to 10^6). every benchmark walks through queries
+ picked up front, so the numbers don't come from one lucky pair
+*/
+
+// Catch2's own JSON reporter leaves the benchmark results out (3.5), so
+// benchjson writes just those: one object per benchmark, times in ns
+class BenchmarkJsonReporter : public Catch::StreamingReporterBase {
+public:
+    using StreamingReporterBase::StreamingReporterBase;
+    static string getDescription() { return "benchmark results as JSON (times in ns)"; }
+
+    void testCaseStarting(const Catch::TestCaseInfo& info) override {
+        StreamingReporterBase::testCaseStarting(info);
+        testCase = info.name;
+    }
+    void benchmarkEnded(const Catch::BenchmarkStats<>& stats) override {
+        m_stream << (first ? "{\"benchmarks\": [\n" : ",\n");
+        first = false;
+        m_stream << "  {\"test-case\": \"" << escaped(testCase) << "\", \"name\": \"" << escaped(stats.info.name)
+                 << "\", \"samples\": " << stats.info.samples << ", \"iterations\": " << stats.info.iterations
+                 << ", \"mean\": " << stats.mean.point.count() << ", \"mean-low\": " << stats.mean.lower_bound.count()
+                 << ", \"mean-high\": " << stats.mean.upper_bound.count()
+                 << ", \"std-dev\": " << stats.standardDeviation.point.count() << "}";
+    }
+    void testRunEnded(const Catch::TestRunStats& stats) override {
+        m_stream << (first ? "{\"benchmarks\": [" : "\n") << "]}\n";
+        StreamingReporterBase::testRunEnded(stats);
+    }
+
+private:
+    static string escaped(const string& text) {
+        string out;
+        for (char c : text) {
+            if (c == '"' || c == '\\') out.push_back('\\');
+            out.push_back(c);
+        }
+        return out;
+    }
+    string testCase;
+    bool first = true;
+};
+CATCH_REGISTER_REPORTER("benchjson", BenchmarkJsonReporter)
+TEST_CASE("Benchmarks on the shipped campus", "[!benchmark][data]") {
+    const string dir = PROJECT_DATA_DIR;
+    Graph g;
+    REQUIRE(g.loadEdgesCSV(dir + "/edges.csv"));
+    REQUIRE(g.loadClassesCSV(dir + "/classes.csv"));
+
+    // the class codes and locations, straight from the file
+    vector<string> codes;
+    vector<int> locations;
+    ifstream file(dir + "/classes.csv");
+    string row;
+    getline(file, row);
+    while (getline(file, row)) {
+        string code = row.substr(0, row.find(','));
+        if (g.getClassLocation(code) == -1) continue;
+        codes.push_back(code);
+        locations.push_back(g.getClassLocation(code));
+    }
+    REQUIRE(codes.size() > 5);
+
+    mt19937 rng(23);
+    vector<pair<int,int>> pairs;
+    vector<vector<int>> zones;
+    vector<vector<ClassInfo>> days;
+    for (int q = 0; q < 256; ++q) {
+        pairs.emplace_back(1 + static_cast<int>(rng() % 60), 1 + static_cast<int>(rng() % 60));
+        vector<int> zone;
+        vector<ClassInfo> day;
+        for (int k = 0; k < 4; ++k) {
+            size_t c = rng() % codes.size();
+            zone.push_back(locations[c]);
+            day.push_back(g.getClassInfo(codes[c]));
+        }
+        sort(day.begin(), day.end(), [](const ClassInfo& a, const ClassInfo& b) { return a.startTime < b.startTime; });
+        zones.push_back(zone);
+        days.push_back(day);
+    }
+    size_t next = 0;
+
+    BENCHMARK("loadEdgesCSV + loadClassesCSV") {
+        Graph fresh;
+        return fresh.loadEdgesCSV(dir + "/edges.csv") && fresh.loadClassesCSV(dir + "/classes.csv");
+    };
+    BENCHMARK("dijkstra") {
+        const auto& p = pairs[next++ % pairs.size()];
+        return g.dijkstra(p.first, p.second).totalCost;
+    };
+    BENCHMARK("isConnected") {
+        const auto& p = pairs[next++ % pairs.size()];
+        return g.isConnected(p.first, p.second);
+    };
+    BENCHMARK("computeStudentZoneCost") {
+        size_t q = next++ % zones.size();
+        return g.computeStudentZoneCost(pairs[q].first, zones[q]);
+    };
+    BENCHMARK("verifySchedule") {
+        return g.verifySchedule(days[next++ % days.size()]).size();
+    };
+    BENCHMARK("toggleEdgesClosure") {
+        return g.toggleEdgesClosure({pairs[next++ % pairs.size()]});
+    };
+    BENCHMARK("command loop, 1000 lines") {
+        OutputBuffer out(nullptr, 0);
+        for (int k = 0; k < 1000; ++k) {
+            const auto& p = pairs[(next + k) % pairs.size()];
+            runCommand(g, (k % 2 ? "isConnected " : "checkEdgeStatus ") + to_string(p.first) + " " + to_string(p.second), out);
+        }
+        ++next;
+        return out.take().size();
+    };
+}
+
+TEST_CASE("Benchmarks on generated campuses", "[!benchmark][generated]") {
+    for (size_t n : {size_t(10000), size_t(100000)}) {
+        CampusSpec spec;
+        spec.locations = n;
+        spec.students = n / 20;
+        Campus campus = generateCampus(spec);
+        Graph g;
+        campus.loadInto(g);
+        mt19937 rng(static_cast<unsigned>(n));
+        vector<pair<int,int>> pairs, edges;
+        vector<vector<int>> zones;
+        for (int q = 0; q < 256; ++q) {
+            pairs.emplace_back(1 + static_cast<int>(rng() % n), 1 + static_cast<int>(rng() % n));
+            const CampusEdge& e = campus.edges[rng() % campus.edges.size()];
+            edges.emplace_back(e.u, e.v);
+            vector<int> zone;
+            for (int k = 0; k < 4; ++k) zone.push_back(campus.classes[rng() % campus.classes.size()].info.locationId);
+            zones.push_back(zone);
+        }
+        vector<string> script = generateCommands(campus, 200, 23);
+        size_t next = 0;
+        const string size = " (" + to_string(n) + " locations)";
+
+        BENCHMARK("dijkstra" + size) {
+            const auto& p = pairs[next++ % pairs.size()];
+            return g.dijkstra(p.first, p.second).totalCost;
+        };
+        BENCHMARK("isConnected" + size) {
+            const auto& p = pairs[next++ % pairs.size()];
+            return g.isConnected(p.first, p.second);
+        };
+        BENCHMARK("computeStudentZoneCost" + size) {
+            size_t q = next++ % zones.size();
+            return g.computeStudentZoneCost(pairs[q].first, zones[q]);
+        };
+        BENCHMARK("toggleEdgesClosure" + size) {
+            return g.toggleEdgesClosure({edges[next++ % edges.size()]});
+        };
+        BENCHMARK_ADVANCED("command loop, 200 lines" + size)(Catch::Benchmark::Chronometer meter) {
+            // every run gets its own copy, the script changes the graph
+            vector<Graph> copies(static_cast<size_t>(meter.runs()), g);
+            meter.measure([&](int run) {
+                OutputBuffer out(nullptr, 0);
+                for (const string& line : script) runCommand(copies[static_cast<size_t>(run)], line, out);
+                return out.take().size();
+            });
+        };
+    }
+}
+
+/*
+ TEST 24: command traces give back every line in order with growing
+ times, even when several threads record at once, and a cut off trace
+ stops at the last whole record
+*/
+TEST_CASE("Command trace round trip") {
+    const string path = "test_trace_tmp.trace";
+    vector<string> lines = {"insert \"Ann Lee\" 01234567 3 1 COP3530", "", "checkEdgeStatus 1 2",
+                            string(300, 'x'), "printStudentZone 01234567"};
+    {
+        TraceWriter writer;
+        string error;
+        REQUIRE(writer.open(path, error, 11, 22));
+        for (const string& line : lines) writer.record(line);
+        REQUIRE(writer.recordCount() == lines.size());
+    }
+    TraceReader reader;
+    string error;
+    REQUIRE(reader.open(path, error));
+    REQUIRE(reader.header().edgesFingerprint == 11);
+    REQUIRE(reader.header().classesFingerprint == 22);
+    TraceRecord record;
+    uint64_t last = 0;
+    for (const string& line : lines) {
+        REQUIRE(reader.next(record));
+        REQUIRE(record.line == line);
+        REQUIRE(record.at >= last);
+        last = record.at;
+    }
+    REQUIRE_FALSE(reader.next(record));
+    REQUIRE_FALSE(reader.corrupt());
+
+    // four threads at once: every line once, times never go backwards
+    {
+        TraceWriter writer;
+        REQUIRE(writer.open(path, error));
+        vector<thread> threads;
+        for (int t = 0; t < 4; ++t)
+            threads.emplace_back([&writer, t]() {
+                for (int i = 0; i < 500; ++i) writer.record("isConnected " + to_string(t) + " " + to_string(i));
+            });
+        for (auto& th : threads) th.join();
+    }
+    TraceReader shared;
+    REQUIRE(shared.open(path, error));
+    vector<int> next(4, 0);
+    last = 0;
+    size_t count = 0;
+    while (shared.next(record)) {
+        CommandTokenizer tok(record.line);
+        string_view word;
+        int t, i;
+        tok.word(word);
+        REQUIRE(tok.integer(t));
+        REQUIRE(tok.integer(i));
+        REQUIRE(i == next[t]++); // each thread's lines stay in its order
+        REQUIRE(record.at >= last);
+        last = record.at;
+        ++count;
+    }
+    REQUIRE(count == 2000);
+
+    // cut the file in the middle of the last record
+    {
+        ifstream in(path, ios::binary);
+        string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write(bytes.data(), static_cast<streamsize>(bytes.size() - 3));
+    }
+    TraceReader cut;
+    REQUIRE(cut.open(path, error));
+    count = 0;
+    while (cut.next(record)) ++count;
+    REQUIRE(count == 1999);
+    REQUIRE(cut.corrupt());
+    remove(path.c_str());
+    REQUIRE_FALSE(cut.open("no_such_trace_tmp.trace", error));
+}
+
+/*
+ TEST 25: command stats, the histogram keeps every value within ~3% of
+ where it was put, counts from several threads add up, and runCommand
+ counts calls and "unsuccessful"s per kind (and `stats` prints them)
+*/
+TEST_CASE("Command stats histograms and counters") {
+    // every bucket starts where the one before it ends, values land in their bucket
+    for (size_t b = 1; b < LatencyHistogram::BUCKETS; ++b)
+        REQUIRE(LatencyHistogram::lowestOf(b) > LatencyHistogram::lowestOf(b - 1));
+    mt19937_64 rng(44);
+    for (int i = 0; i < 20000; ++i) {
+        uint64_t v = rng() >> (rng() % 64);
+        if (v >= (uint64_t(1) << (LatencyHistogram::TOP_BIT + 1))) continue;
+        size_t b = LatencyHistogram::bucketOf(v);
+        REQUIRE(LatencyHistogram::lowestOf(b) <= v);
+        if (b + 1 < LatencyHistogram::BUCKETS) REQUIRE(v < LatencyHistogram::lowestOf(b + 1));
+        double middle = static_cast<double>(LatencyHistogram::middleOf(b));
+        REQUIRE(abs(middle - static_cast<double>(v)) <= 0.02 * static_cast<double>(v) + 1);
+    }
+    REQUIRE(LatencyHistogram::bucketOf(~uint64_t(0)) == LatencyHistogram::BUCKETS - 1);
+
+    // 1..100000 ns once each: the percentiles are the values themselves
+    LatencyHistogram h;
+    REQUIRE(h.percentile(0.5) == 0);
+    for (uint64_t v = 1; v <= 100000; ++v) h.add(LatencyHistogram::bucketOf(v), 1);
+    REQUIRE(h.count() == 100000);
+    for (double q : {0.5, 0.99, 0.999}) {
+        double want = q * 100000;
+        REQUIRE(abs(static_cast<double>(h.percentile(q)) - want) <= 0.03 * want);
+    }
+    REQUIRE(abs(static_cast<double>(h.maximum()) - 100000.0) <= 3000);
+
+    // four threads record into one CommandStats, merged() sees all of it
+    CommandStats stats;
+    stats.record(CommandKind::Insert, 10, false); // off: nothing counted
+    stats.enable();
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([&stats, t]() {
+            for (int i = 0; i < 1000; ++i)
+                stats.record(t % 2 ? CommandKind::IsConnected : CommandKind::Remove, 1000 + i, i % 10 == 0);
+        });
+    for (auto& th : threads) th.join();
+    vector<CommandSummary> all = stats.merged();
+    REQUIRE(all[static_cast<size_t>(CommandKind::Insert)].calls == 0);
+    for (CommandKind kind : {CommandKind::IsConnected, CommandKind::Remove}) {
+        const CommandSummary& s = all[static_cast<size_t>(kind)];
+        REQUIRE(s.calls == 2000);
+        REQUIRE(s.errors == 200);
+        REQUIRE(s.latency.count() == 2000);
+        REQUIRE(abs(static_cast<double>(s.latency.percentile(0.5)) - 1500.0) <= 45);
+    }
+    stats.reset();
+    REQUIRE(stats.merged()[static_cast<size_t>(CommandKind::Remove)].calls == 0);
+
+    // one thread going back and forth between two instances keeps its block
+    // in each (no new block, so nothing allocated, after the first record)
+    CommandStats other;
+    other.enable();
+    stats.record(CommandKind::Insert, 10, false);
+    other.record(CommandKind::Insert, 10, false);
+    AllocationCounter counted;
+    for (int i = 0; i < 100; ++i) {
+        stats.record(CommandKind::Insert, 10, false);
+        other.record(CommandKind::Insert, 10, false);
+    }
+    REQUIRE(counted.allocations() == 0);
+    REQUIRE(stats.merged()[static_cast<size_t>(CommandKind::Insert)].calls == 101);
+    REQUIRE(other.merged()[static_cast<size_t>(CommandKind::Insert)].calls == 101);
+    stats.reset();
+
+    // through runCommand, with the global stats on
+    Graph g;
+    g.addEdge(1, 2, 5);
+    CommandStats& global = CommandStats::global();
+    global.reset();
+    global.enable();
+    OutputBuffer out(nullptr, 0);
+    for (string line : {"isConnected 1 2", "isConnected 1 9", "remove 00000000", "bogus", ""})
+        runCommand(g, line, out);
+    GraphStore store(g);
+    GraphStore::Reader reader(store);
+    runCommand(store, reader, "remove 00000001", out);
+    out.take();
+    runCommand(g, "stats", out);
+    string table = out.take();
+    global.enable(false);
+    all = global.merged();
+    REQUIRE(all[static_cast<size_t>(CommandKind::IsConnected)].calls == 2);
+    REQUIRE(all[static_cast<size_t>(CommandKind::IsConnected)].errors == 1);
+    REQUIRE(all[static_cast<size_t>(CommandKind::Remove)].calls == 2);
+    REQUIRE(all[static_cast<size_t>(CommandKind::Remove)].errors == 2);
+    REQUIRE(all[static_cast<size_t>(CommandKind::Unknown)].errors == 2);
+    REQUIRE(all[static_cast<size_t>(CommandKind::Stats)].calls == 1);
+    REQUIRE(table.rfind("command", 0) == 0);
+    REQUIRE(table.find("\nisConnected ") != string::npos);
+    REQUIRE(table.find("\nunknown ") != string::npos);
+    REQUIRE(table.find("\ninsert ") == string::npos);
+    global.reset();
+}
+
+/*
+ TEST 26: search stats, the counts of one search add up (every pop is
+ settled or stale), a zone's stats are its dijkstras', the landmark engine
+ settles fewer nodes than dijkstra on the same query, and the global
+ totals see every search while they're on
+*/
+TEST_CASE("Routing queries report their search effort") {
+    CampusSpec spec;
+    spec.locations = 1500;
+    spec.seed = 45;
+    Campus campus = generateCampus(spec);
+    Graph g;
+    campus.loadInto(g);
+    int a = campus.locations.front().id, b = campus.locations.back().id;
+
+    SearchStats d;
+    PathResult path = g.dijkstra(a, b, &d);
+    REQUIRE(path.totalCost > 0);
+    REQUIRE(d.searches == 1);
+    REQUIRE(d.heapPops == d.nodesSettled + d.stalePops);
+    REQUIRE(d.heapPushes >= d.heapPops);
+    REQUIRE(d.nodesSettled >= path.path.size());
+    REQUIRE(d.edgesRelaxed >= d.nodesSettled - 1);
+    REQUIRE(g.dijkstra(a, b).totalCost == path.totalCost); // no stats asked for, same answer
+
+    SearchStats bfs;
+    REQUIRE(g.isConnected(a, b, &bfs));
+    REQUIRE(bfs.stalePops == 0);
+    REQUIRE(bfs.heapPops == bfs.nodesSettled);
+    REQUIRE(bfs.heapPushes <= campus.locations.size());
+
+    // a zone runs one dijkstra per class location
+    vector<int> locs = {campus.locations[10].id, campus.locations[700].id, b};
+    SearchStats zone, sum;
+    g.computeStudentZoneCost(a, locs, &zone);
+    for (int loc : locs) {
+        SearchStats one;
+        g.dijkstra(a, loc, &one);
+        sum += one;
+    }
+    REQUIRE(zone.searches == 1);
+    REQUIRE(zone.nodesSettled == sum.nodesSettled);
+    REQUIRE(zone.heapPushes == sum.heapPushes);
+
+    // the same query on both engines
+    g.enableRoutingIndex();
+    g.prepareRoutingIndex();
+    g.waitForRoutingIndex();
+    RoutingEngine engine;
+    SearchStats alt, plain;
+    REQUIRE(g.shortestTime(a, b, &engine, &alt) == path.totalCost);
+    REQUIRE(engine == RoutingEngine::Landmarks);
+    g.dijkstra(a, b, &plain);
+    REQUIRE(alt.nodesSettled < plain.nodesSettled);
+
+    // the totals only count while they're on
+    SearchTotals& totals = SearchTotals::global();
+    totals.reset();
+    g.dijkstra(a, b);
+    REQUIRE(totals.total(SearchKind::Dijkstra).searches == 0);
+    totals.enable();
+    g.dijkstra(a, b);
+    g.dijkstra(b, a);
+    g.isConnected(a, b);
+    g.shortestTime(a, b);
+    totals.enable(false);
+    SearchStats all = totals.total(SearchKind::Dijkstra);
+    REQUIRE(all.searches == 2);
+    REQUIRE(all.nodesSettled >= 2);
+    REQUIRE(totals.total(SearchKind::Connectivity).searches == 1);
+    REQUIRE(totals.total(SearchKind::Landmarks).searches == 1);
+    REQUIRE(totals.total(SearchKind::Zone).searches == 0);
+    OutputBuffer out(nullptr, 0);
+    printSearchTotals(totals, out);
+    string table = out.take();
+    REQUIRE(table.rfind("search", 0) == 0);
+    REQUIRE(table.find("\nlandmarks ") != string::npos);
+    REQUIRE(table.find("\nzone ") == string::npos);
+    totals.reset();
+}
+
+/*
+ TEST 27: hardware counters, the totals add up per row and show up in
+ `stats` under the latencies; where the kernel gives us the counters
+ (not in every container or VM) a command really gets cycles and
+ instructions, elsewhere enabling says why and nothing is measured
+*/
+TEST_CASE("Hardware counters per command") {
+    PerfTotals totals(3);
+    REQUIRE(totals.empty());
+    PerfSample one;
+    one.count = 1;
+    one.cycles = 1000;
+    one.instructions = 2500;
+    one.cacheMisses = 4;
+    one.branchMisses = 7;
+    totals.add(1, one);
+    totals.add(1, one);
+    totals.add(7, one); // no such row, dropped
+    REQUIRE_FALSE(totals.empty());
+    PerfSample sum = totals.total(1);
+    REQUIRE(sum.count == 2);
+    REQUIRE(sum.instructions == 5000);
+    REQUIRE(sum.branchMisses == 14);
+    REQUIRE(totals.total(0).count == 0);
+    PerfSample more = sum;
+    more += one;
+    REQUIRE(more.cycles == 3000);
+
+    // two readings: counted the whole time, half of it (multiplexed, so
+    // scaled up and flagged), not at all (no measurement)
+    PerfSample before, after, delta;
+    before.timeEnabled = before.timeRunning = 100;
+    after = one;
+    after.timeEnabled = after.timeRunning = 300;
+    REQUIRE(after.since(before, delta));
+    REQUIRE(delta.count == 1);
+    REQUIRE(delta.cycles == 1000);
+    REQUIRE(delta.scaled == 0);
+    after.timeRunning = 200;
+    REQUIRE(after.since(before, delta));
+    REQUIRE(delta.cycles == 2000);
+    REQUIRE(delta.branchMisses == 14);
+    REQUIRE(delta.scaled == 1);
+    totals.add(2, delta);
+    REQUIRE(totals.total(2).scaled == 1);
+    after.timeRunning = 100;
+    REQUIRE_FALSE(after.since(before, delta));
+
+    // what `stats` prints once a command kind has counters
+    CommandStats stats;
+    stats.enable();
+    stats.record(CommandKind::IsConnected, 500, false);
+    stats.perf().add(static_cast<size_t>(CommandKind::IsConnected), one);
+    OutputBuffer out(nullptr, 0);
+    stats.print(out);
+    string table = out.take();
+    REQUIRE(table.find("\ncounters ") != string::npos);
+    REQUIRE(table.find("2.50") != string::npos); // instructions per cycle
+    stats.reset();
+    REQUIRE(stats.perf().empty());
+
+    string error;
+    if (!PerfCounters::enable(error)) {
+        REQUIRE_FALSE(error.empty());
+        REQUIRE_FALSE(PerfCounters::enabled());
+        PerfScope scope(totals);
+        scope.finish(0);
+        REQUIRE(totals.total(0).count == 0);
+        return;
+    }
+    Graph g;
+    for (int i = 0; i < 200; ++i) g.addEdge(i, i + 1, 1);
+    CommandStats& global = CommandStats::global();
+    global.reset();
+    OutputBuffer sink(nullptr, 0);
+    runCommand(g, "isConnected 0 200", sink);
+    PerfCounters::disable();
+    runCommand(g, "isConnected 0 200", sink);
+    PerfSample measured = global.perf().total(static_cast<size_t>(CommandKind::IsConnected));
+    REQUIRE(measured.count == 1);
+    REQUIRE(measured.instructions > 1000);
+    REQUIRE(measured.cycles > 0);
+    REQUIRE(SearchTotals::global().perf().total(static_cast<size_t>(SearchKind::Connectivity)).count == 1);
+    global.reset();
+    SearchTotals::global().reset();
+}
+
+/*
+ TEST 28: timed regions, nested regions keep their depth per thread, the
+ folded output gives every stack its self time, the Chrome trace has one
+ event per region, and nothing is kept while not recording
+*/
+TEST_CASE("Timed regions export Chrome traces and folded stacks") {
+    auto spin = [](uint64_t nanos) {
+        uint64_t until = TimedRegions::now() + nanos;
+        while (TimedRegions::now() < until) {}
+    };
+    TimedRegions::start();
+    {
+        TimedRegion outer("outer");
+        spin(200000);
+        {
+            TimedRegion inner("inner");
+            spin(300000);
+        }
+        TimedRegion second("second");
+        spin(100000);
+    }
+    thread([]() { TimedRegion other("elsewhere"); }).join();
+    TimedRegions::stop();
+    { TimedRegion ignored("ignored"); }
+
+    size_t dropped = 1;
+    vector<RegionEvent> seen;
+    for (const auto& list : TimedRegions::events(&dropped)) seen.insert(seen.end(), list.begin(), list.end());
+    REQUIRE(dropped == 0);
+    REQUIRE(seen.size() == 4);
+    auto find = [&](const string& name) {
+        return *find_if(seen.begin(), seen.end(), [&](const RegionEvent& e) { return name == e.name; });
+    };
+    RegionEvent outer = find("outer"), inner = find("inner");
+    REQUIRE(outer.depth == 0);
+    REQUIRE(inner.depth == 1);
+    REQUIRE(find("second").depth == 1);
+    REQUIRE(find("elsewhere").depth == 0);
+    REQUIRE(inner.start >= outer.start);
+    REQUIRE(inner.start + inner.duration <= outer.start + outer.duration);
+    REQUIRE(inner.duration >= 300000);
+
+    const string folded = "test_regions_tmp.folded", chrome = "test_regions_tmp.json";
+    string error;
+    REQUIRE(TimedRegions::writeFolded(folded, error));
+    map<string, uint64_t> stacks;
+    {
+        ifstream in(folded);
+        string stack;
+        uint64_t self;
+        while (in >> stack >> self) stacks[stack] = self;
+    }
+    REQUIRE(stacks.count("outer;inner") == 1);
+    REQUIRE(stacks.count("outer;second") == 1);
+    REQUIRE(stacks["outer;inner"] == inner.duration);
+    // outer's self time is what its children didn't take
+    REQUIRE(stacks["outer"] + stacks["outer;inner"] + stacks["outer;second"] == outer.duration);
+    REQUIRE(stacks["outer"] >= 200000);
+
+    REQUIRE(TimedRegions::writeChromeTrace(chrome, error));
+    ifstream in(chrome);
+    string json((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    REQUIRE(json.rfind("{\"displayTimeUnit\"", 0) == 0);
+    size_t events = 0;
+    for (size_t at = json.find("\"ph\":\"X\""); at != string::npos; at = json.find("\"ph\":\"X\"", at + 1)) ++events;
+    REQUIRE(events == 4);
+    REQUIRE(json.find("\"name\":\"elsewhere\"") != string::npos);
+    REQUIRE(json.find("\n]}") != string::npos);
+    remove(folded.c_str());
+    remove(chrome.c_str());
+    REQUIRE_FALSE(TimedRegions::writeFolded("no/such/dir/x.folded", error));
+
+#ifdef CAMPUS_TIMED_REGIONS
+    // the command is the outer region, its searches nest inside
+    Graph g;
+    g.addEdge(1, 2, 5);
+    g.addEdge(2, 3, 5);
+    ClassInfo info;
+    info.locationId = 3;
+    g.setClassInfo("COP3530", info);
+    REQUIRE(g.addStudent("Ann", 12345678, {"COP3530"}, 1));
+    TimedRegions::start();
+    OutputBuffer out(nullptr, 0);
+    runCommand(g, "printStudentZone 12345678", out);
+    TimedRegions::stop();
+    REQUIRE(TimedRegions::writeFolded(folded, error));
+    ifstream zone(folded);
+    string text((istreambuf_iterator<char>(zone)), istreambuf_iterator<char>());
+    REQUIRE(text.find("printStudentZone;dijkstra") != string::npos);
+    REQUIRE(text.find("printStudentZone;computeMSTCost") != string::npos);
+    remove(folded.c_str());
+#endif
+}
+
+/*
+ TEST 29: memory accounting, every part grows with what's put in it, and the
+ allocation counter: landmark and dijkstra queries, connectivity, zones and
+ edge lookups allocate nothing once warm
+*/
+TEST_CASE("Graph reports its memory and warm routing queries don't allocate") {
+    CampusSpec spec;
+    spec.locations = 1200;
+    spec.students = 0;
+    spec.seed = 48;
+    Campus campus = generateCampus(spec);
+    Graph g;
+    campus.loadInto(g);
+
+    MemoryUsage before = g.memoryUsage();
+    REQUIRE(before.nodes == campus.locations.size());
+    REQUIRE(before.edges == campus.edges.size());
+    REQUIRE(before.classes == campus.classes.size());
+    REQUIRE(before.adjacency > 0);
+    REQUIRE(before.classMaps > 0);
+    REQUIRE(before.routingIndex == 0);
+    REQUIRE(before.total() == before.adjacency + before.classMaps + before.studentRecords + before.studentIndex +
+                                  before.studentNames + before.routingIndex);
+
+    const string& code = campus.classes.front().code;
+    for (int i = 0; i < 500; ++i) {
+        string name = "Student " + string(1, char('a' + i % 26)) + string(1, char('a' + i / 26));
+        REQUIRE(g.addStudent(name, 20000000 + i, {code}, campus.locations.front().id));
+    }
+    MemoryUsage after = g.memoryUsage();
+    REQUIRE(after.students == 500);
+    REQUIRE(after.studentRecords > before.studentRecords);
+    REQUIRE(after.studentIndex > before.studentIndex);
+    REQUIRE(after.studentNames >= before.studentNames + 500 * strlen("Student ab"));
+    REQUIRE(after.adjacency == before.adjacency);
+
+    g.enableRoutingIndex();
+    g.prepareRoutingIndex();
+    g.waitForRoutingIndex();
+    REQUIRE(g.routingIndexReady());
+    REQUIRE(g.memoryUsage().routingIndex > 0);
+
+    // the counter sees this thread's news
+    AllocationCounter counted;
+    auto held = make_unique<vector<int>>(1000);
+    REQUIRE(counted.allocations() == 2);
+    REQUIRE(counted.bytes() >= sizeof(vector<int>) + 1000 * sizeof(int));
+
+    mt19937 rng(48);
+    vector<pair<int,int>> pairs;
+    for (int i = 0; i < 200; ++i)
+        pairs.push_back({campus.locations[rng() % campus.locations.size()].id,
+                         campus.locations[rng() % campus.locations.size()].id});
+    vector<int> costs;
+    for (auto [a, b] : pairs) costs.push_back(g.shortestTime(a, b)); // warms the scratch
+    counted.restart();
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        RoutingEngine engine;
+        REQUIRE(g.shortestTime(pairs[i].first, pairs[i].second, &engine) == costs[i]);
+        REQUIRE(engine == RoutingEngine::Landmarks);
+    }
+    REQUIRE(counted.allocations() == 0);
+    for (size_t i = 0; i < pairs.size(); ++i)
+        REQUIRE(costs[i] == g.dijkstra(pairs[i].first, pairs[i].second).totalCost);
+
+    const CampusEdge& e = campus.edges.front();
+    counted.restart();
+    REQUIRE(g.checkEdgeStatus(e.u, e.v) == "open");
+    REQUIRE(counted.allocations() == 0);
+
+    // dijkstra, connectivity and zones too, once a first round warmed them
+    // (dijkstra into a PathResult we keep, the returning one must allocate its path)
+    vector<int> zone;
+    for (int k = 0; k < 4; ++k) zone.push_back(campus.classes[rng() % campus.classes.size()].info.locationId);
+    PathResult path;
+    vector<PathResult> expected;
+    vector<int> zoneCosts;
+    for (auto [a, b] : pairs) {
+        expected.push_back(g.dijkstra(a, b));
+        g.dijkstra(a, b, path);
+        g.isConnected(a, b);
+        zoneCosts.push_back(g.computeStudentZoneCost(a, zone));
+    }
+    counted.restart();
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        g.dijkstra(pairs[i].first, pairs[i].second, path);
+        REQUIRE(path.totalCost == expected[i].totalCost);
+        REQUIRE(path.path == expected[i].path);
+        REQUIRE(g.isConnected(pairs[i].first, pairs[i].second) == (costs[i] != -1));
+        REQUIRE(g.computeStudentZoneCost(pairs[i].first, zone.data(), zone.size()) == zoneCosts[i]);
+    }
+    REQUIRE(counted.allocations() == 0);
+}
+
+/*
+ TEST 30: the slow query log, nothing while off, every command at or over
+ the threshold with its graph's sizes, closure epoch and searches, only the
+ newest `capacity` kept, binary commands decoded back to their text
+*/
+TEST_CASE("Slow query log keeps the slow commands with their context") {
+    CampusSpec spec;
+    spec.locations = 800;
+    spec.students = 20;
+    spec.seed = 49;
+    Campus campus = generateCampus(spec);
+    Graph g;
+    campus.loadInto(g);
+    const CampusEdge& e = campus.edges.front();
+    string ufid = campus.students.front().ufid;
+    string toggle = "toggleEdgesClosure 1 " + to_string(e.u) + " " + to_string(e.v);
+
+    SlowQueryLog& slow = SlowQueryLog::global();
+    slow.clear();
+    OutputBuffer out(nullptr, 0);
+    runCommand(g, "printStudentZone " + ufid, out);
+    REQUIRE(slow.entries().empty());
+    out.take();
+    slow.print(out);
+    REQUIRE(out.take() == "slow commands (off): 0\n"); // 0 (Main --slow=0 too) is off, not 0 us
+
+    slow.setThreshold(1); // everything is slow
+    runCommand(g, "printStudentZone " + ufid, out);
+    runCommand(g, toggle, out);
+    runCommand(g, "isConnected " + to_string(e.u) + " " + to_string(e.v), out);
+    vector<SlowQuery> all = slow.entries();
+    REQUIRE(all.size() == 3);
+    REQUIRE(all[0].sequence == 1);
+    REQUIRE(all[0].command == "printStudentZone " + ufid);
+    REQUIRE(all[0].kind == CommandKind::PrintStudentZone);
+    REQUIRE(all[0].nanos >= 1);
+    REQUIRE(all[0].closureEpoch == 0);
+    REQUIRE(all[0].locations == campus.locations.size());
+    REQUIRE(all[0].edges == campus.edges.size());
+    REQUIRE(all[0].students == campus.students.size());
+    REQUIRE(all[0].kinds[static_cast<size_t>(SearchKind::Zone)].searches == 1);
+    REQUIRE(all[0].searches.nodesSettled > 0);
+    REQUIRE(all[1].kind == CommandKind::ToggleEdgesClosure);
+    REQUIRE(all[1].closureEpoch == 1); // the graph after the toggle
+    REQUIRE(all[1].searches.searches == 0);
+    REQUIRE(all[2].closureEpoch == 1);
+    REQUIRE(all[2].kinds[static_cast<size_t>(SearchKind::Connectivity)].searches == 1);
+
+    // a failed toggle flips nothing and keeps the epoch
+    REQUIRE_FALSE(g.toggleEdgesClosure({{-1, -2}}));
+    REQUIRE(g.getClosureEpoch() == 1);
+
+    // the ring keeps the newest
+    slow.setCapacity(2);
+    all = slow.entries();
+    REQUIRE(all.size() == 2);
+    REQUIRE(all[0].sequence == 2);
+    for (int i = 0; i < 5; ++i) runCommand(g, "checkEdgeStatus 1 2", out);
+    uint64_t overwritten = 0;
+    all = slow.entries(&overwritten);
+    REQUIRE(all.size() == 2);
+    REQUIRE(overwritten == 6);
+    REQUIRE(all[1].sequence == 8);
+
+    out.take();
+    runCommand(g, "slowlog", out);
+    string text = out.take();
+    REQUIRE(text.find("6 older ones overwritten") != string::npos);
+    REQUIRE(text.find("#7 checkEdgeStatus 1 2\n") != string::npos);
+
+    // binary commands go in as text
+    vector<string> lines = {"insert \"Ann Lee\" 01234567 3 2 COP3502 MAC2311", "printStudentZone " + ufid,
+                            "replaceClass 01234567 COP3502 COP3503", toggle, "isConnected 4 9", "removeClass COP3502"};
+    for (const string& line : lines) {
+        string request;
+        REQUIRE(encodeCommand(line, request));
+        REQUIRE(decodeCommand(request) == line);
+    }
+    GraphStore store(g);
+    GraphStore::Reader reader(store);
+    string request, reply;
+    encodeCommand("printStudentZone " + ufid, request);
+    runBinaryCommand(store, reader, request, reply);
+    all = slow.entries();
+    REQUIRE(all.back().command == "printStudentZone " + ufid);
+    REQUIRE(all.back().kinds[static_cast<size_t>(SearchKind::Zone)].searches == 1);
+
+    slow.setThreshold(0);
+    slow.setCapacity(SlowQueryLog::DEFAULT_CAPACITY);
+    slow.clear();
+}
+
+/*
+ TEST 31: explain, the command runs and prints what it always does, then
+ the routing index's state, the engine that answered, a zone's subgraph and
+ the timed phases; an explained mutation changes the graph (also through a
+ store and over the binary channel)
+*/
+TEST_CASE("Explain reports how a command was answered") {
+    CampusSpec spec;
+    spec.locations = 900;
+    spec.students = 10;
+    spec.seed = 50;
+    Campus campus = generateCampus(spec);
+    Graph g;
+    campus.loadInto(g);
+    string ufid = campus.students.front().ufid;
+    const CampusEdge& e = campus.edges.front();
+    string edge = to_string(e.u) + " " + to_string(e.v);
+
+    REQUIRE(commandKindOfLine("explain printStudentZone 1") == CommandKind::Explain);
+    REQUIRE(string(commandName(CommandKind::Explain)) == "explain");
+
+    OutputBuffer out(nullptr, 0);
+    runCommand(g, "printStudentZone " + ufid, out);
+    string plain = out.take();
+    runCommand(g, "explain printStudentZone " + ufid, out);
+    string text = out.take();
+    REQUIRE(text.rfind(plain, 0) == 0); // the usual answer first
+    REQUIRE(text.find("explain printStudentZone " + ufid + "\n") != string::npos);
+    REQUIRE(text.find("  printStudentZone: successful, ") != string::npos);
+    REQUIRE(text.find("  routing index: off") != string::npos);
+    REQUIRE(text.find("  engine: zone\n") != string::npos);
+    REQUIRE(text.find("    subgraph: ") != string::npos);
+#ifdef CAMPUS_TIMED_REGIONS
+    REQUIRE(text.find("\n    printStudentZone ") != string::npos);
+    REQUIRE(text.find("\n      dijkstra") != string::npos);
+    REQUIRE(text.find("\n      computeMSTCost ") != string::npos);
+#endif
+
+    // the cost queries show which engine answered
+    g.enableRoutingIndex();
+    g.prepareRoutingIndex();
+    g.waitForRoutingIndex();
+    runCommand(g, "explain printShortestEdges " + ufid, out);
+    text = out.take();
+    REQUIRE(text.find("  routing index: hit\n") != string::npos);
+    REQUIRE(text.find("  engine: landmarks\n") != string::npos);
+
+    // an explained mutation happens (a closure keeps the index)
+    runCommand(g, "explain toggleEdgesClosure 1 " + edge, out);
+    text = out.take();
+    REQUIRE(text.rfind("successful\n", 0) == 0);
+    REQUIRE(g.checkEdgeStatus(e.u, e.v) == "closed");
+    REQUIRE(text.find("  routing index: hit\n") != string::npos);
+    REQUIRE(text.find("  engine: none\n") != string::npos);
+    runCommand(g, "explain checkEdgeStatus " + edge, out);
+    REQUIRE(out.take().rfind("closed\nexplain checkEdgeStatus", 0) == 0);
+
+    // only one level: explaining an explain fails without running anything,
+    // however many of them a client strings together
+    runCommand(g, "explain explain toggleEdgesClosure 1 " + edge, out);
+    REQUIRE(out.take() == "unsuccessful\n");
+    REQUIRE(g.checkEdgeStatus(e.u, e.v) == "closed");
+    string deep;
+    for (int i = 0; i < 20000; ++i) deep += "explain ";
+    runCommand(g, deep + "checkEdgeStatus " + edge, out);
+    REQUIRE(out.take() == "unsuccessful\n");
+    runQuery(g, deep + "checkEdgeStatus " + edge, out);
+    REQUIRE(out.take() == "unsuccessful\n");
+
+    // queries only, like runQuery always was
+    runQuery(g, "explain toggleEdgesClosure 1 " + edge, out);
+    REQUIRE(out.take().rfind("unsuccessful\n", 0) == 0);
+    REQUIRE(g.checkEdgeStatus(e.u, e.v) == "closed");
+
+    // through a store and over the binary channel the mutation is published
+    GraphStore store(g);
+    GraphStore::Reader reader(store);
+    runCommand(store, reader, "explain toggleEdgesClosure 1 " + edge, out);
+    REQUIRE(out.take().rfind("successful\n", 0) == 0);
+    REQUIRE(reader.get().checkEdgeStatus(e.u, e.v) == "open");
+    string request, reply;
+    REQUIRE(encodeCommand("explain toggleEdgesClosure 1 " + edge, request));
+    REQUIRE(decodeCommand(request) == "explain toggleEdgesClosure 1 " + edge);
+    runBinaryCommand(store, reader, request, reply);
+    formatReply(request, reply, out);
+    text = out.take();
+    REQUIRE(text.rfind("successful\nexplain toggleEdgesClosure", 0) == 0);
+    REQUIRE(reader.get().checkEdgeStatus(e.u, e.v) == "closed");
+}